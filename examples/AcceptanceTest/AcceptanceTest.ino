@@ -0,0 +1,137 @@
+#include <LiteSerialLogger.h>
+
+/*
+ * Incoming inspection of a batch of converters, with MingHeAcceptance.  Runs
+ * the same checks as the MingHeBuckConverter example against every unit, and
+ * prints the pass/fail matrix as CSV and JSON.
+ *
+ * Here the batch is emulated: racks of MingHeEmulators, each with a 1 ohm
+ * load, standing in for serial ports with converters on.  It times one unit
+ * on its own, then one unit on each of four ports, then three units on each of
+ * four ports - where one unit has nothing on its output, and another is
+ * missing altogether.  For real
+ * hardware, make a MingHeBus per serial port, add a converter for each address
+ * on it, and hand the buses to the runner.
+ *
+ * Each emulated unit, its load and its driver take around half a kilobyte of
+ * SRAM - this wants a Mega.
+ */
+
+#define LOGGER LiteSerial
+//#define LOGGER Serial
+
+#include "MingHeAcceptance.h"
+#include "MingHeBuckConverter.h"
+#include "MingHeBus.h"
+#include "MingHeEmulator.h"
+#include "MingHePlant.h"
+#include "MingHeRack.h"
+
+#define PORTS 4
+#define UNITS_PER_PORT 3
+#define LOAD_RESISTANCE_MOHM 1000
+
+// The unit with no load, and the one that isn't there.
+#define UNLOADED_PORT 1
+#define UNLOADED_UNIT 2
+#define MISSING_PORT 2
+#define MISSING_UNIT 1
+
+MingHeRack *racks[PORTS];
+MingHeBus *buses[PORTS];
+MingHeEmulator *emulators[PORTS][UNITS_PER_PORT];
+MingHePlant *plants[PORTS][UNITS_PER_PORT];
+MingHeBuckConverter *converters[PORTS][UNITS_PER_PORT];
+
+// Addresses 1 to units_per_port on each port, with the two faulty units if
+// asked for.
+void build(const uint8_t ports, const uint8_t units_per_port,
+        const bool faults) {
+  for (uint8_t port = 0; port < ports; port++) {
+    racks[port] = new MingHeRack();
+    buses[port] = new MingHeBus();
+    for (uint8_t unit = 0; unit < units_per_port; unit++) {
+      emulators[port][unit] = new MingHeEmulator(unit + 1, 6015);
+      plants[port][unit] = new MingHePlant();
+      if (!faults || (port != UNLOADED_PORT) || (unit != UNLOADED_UNIT)) {
+        plants[port][unit]->setResistiveLoad(LOAD_RESISTANCE_MOHM);
+      }
+      emulators[port][unit]->setPlant(plants[port][unit]);
+      if (!faults || (port != MISSING_PORT) || (unit != MISSING_UNIT)) {
+        racks[port]->addUnit(emulators[port][unit]);
+      }
+      converters[port][unit] = new MingHeBuckConverter(racks[port],
+              unit + 1);
+      buses[port]->addUnit(converters[port][unit]);
+    }
+  }
+}
+
+void tearDown(const uint8_t ports, const uint8_t units_per_port) {
+  for (uint8_t port = 0; port < ports; port++) {
+    for (uint8_t unit = 0; unit < units_per_port; unit++) {
+      delete converters[port][unit];
+      delete plants[port][unit];
+      delete emulators[port][unit];
+    }
+    delete buses[port];
+    delete racks[port];
+  }
+}
+
+// Test a batch, and return how long it took.
+uint32_t runBatch(const uint8_t ports, const uint8_t units_per_port,
+        const bool print) {
+  MingHeAcceptance acceptance;
+  uint8_t passed = 0;
+
+  for (uint8_t port = 0; port < ports; port++) {
+    acceptance.addBus(buses[port]);
+  }
+
+  // Anything else can run in here while the batch is under way.
+  acceptance.begin();
+  while (acceptance.poll()) {
+  }
+
+  for (uint8_t i = 0; i < acceptance.getUnitCount(); i++) {
+    if (acceptance.unitPassed(i)) {
+      passed++;
+    }
+  }
+  LOGGER.print(ports);
+  LOGGER.print(F(" port(s) x "));
+  LOGGER.print(units_per_port);
+  LOGGER.print(F(" unit(s): "));
+  LOGGER.print(passed);
+  LOGGER.print(F(" passed in "));
+  LOGGER.print(acceptance.getElapsedMs());
+  LOGGER.println(F(" ms"));
+
+  if (print) {
+    acceptance.printCsv(LOGGER);
+    acceptance.printJson(LOGGER);
+  }
+  return acceptance.getElapsedMs();
+}
+
+void setup() {
+  LOGGER.begin(115200);
+
+  build(1, 1, false);
+  runBatch(1, 1, false);
+  tearDown(1, 1);
+
+  build(PORTS, 1, false);
+  runBatch(PORTS, 1, false);
+  tearDown(PORTS, 1);
+
+  build(PORTS, UNITS_PER_PORT, true);
+  runBatch(PORTS, UNITS_PER_PORT, true);
+  tearDown(PORTS, UNITS_PER_PORT);
+
+  LOGGER.println(F("Batch test complete."));
+}
+
+void loop() {
+}
@@ -0,0 +1,101 @@
+/*
+ * Tracking a battery's internal resistance while it charges, with
+ * MingHeResistanceMeter.  Every so often the 1A charge current is pulsed up
+ * to 3A: the voltage and current are read just before and just after the
+ * step, and the change in voltage over the change in current is the
+ * resistance.  Each result is printed with how far from the step the
+ * readings were.
+ *
+ * This runs against an emulated converter charging a 3S pack with 150
+ * milliohms of internal resistance, so it needs no hardware.  For a real
+ * unit, use the software serial constructor, and load measured frame gaps
+ * (see the FrameGapCharacterization example) to get the readings as close to
+ * the step as the unit allows.
+ */
+
+#define LOGGER Serial
+
+#include "MingHeBuckConverter.h"
+#include "MingHeEmulator.h"
+#include "MingHePlant.h"
+#include "MingHeResistance.h"
+
+#define CHARGE_VOLTAGE 1260
+#define CHARGE_CURRENT 100
+#define STEP_CURRENT 300
+#define MEASURE_MS 5000UL
+
+// 9.00V empty, 12.60V full, 2Ah, 150 milliohms, 20% full.
+const MingHeBattery battery = {900, 1260, 2000, 150, 200};
+
+MingHePlant plant;
+MingHeEmulator emulator(1, 6015);
+MingHeBuckConverter converter(&emulator, 1);
+MingHeResistanceMeter meter(&converter);
+
+uint32_t last_measure_ms;
+
+void printFrame(const char *name, const int32_t us) {
+  LOGGER.print(name);
+  LOGGER.print(' ');
+  LOGGER.print(us);
+  LOGGER.print(F("us"));
+}
+
+void report(void) {
+  const MingHeResistanceResult &result = meter.getResult();
+
+  LOGGER.print(result.resistance_mohm);
+  LOGGER.print(F(" mohm: "));
+  LOGGER.print(result.delta_voltage);
+  LOGGER.print(F(" V/100 over "));
+  LOGGER.print(result.delta_current);
+  LOGGER.print(F(" A/100, at "));
+  LOGGER.print(result.voltage_before);
+  LOGGER.print(F(" V/100.  "));
+  printFrame("v", result.frame_us[MINGHE_RESISTANCE_VOLTAGE_BEFORE]);
+  printFrame(", i", result.frame_us[MINGHE_RESISTANCE_CURRENT_BEFORE]);
+  printFrame(", v", result.frame_us[MINGHE_RESISTANCE_VOLTAGE_AFTER]);
+  printFrame(", i", result.frame_us[MINGHE_RESISTANCE_CURRENT_AFTER]);
+  LOGGER.println();
+}
+
+void setup() {
+  LOGGER.begin(115200);
+
+  plant.setBatteryLoad(battery);
+  emulator.setPlant(&plant);
+
+  converter.setMaxVoltage(CHARGE_VOLTAGE);
+  converter.setMaxCurrent(CHARGE_CURRENT);
+  converter.setOutputEnabled(true);
+  last_measure_ms = millis();
+}
+
+void loop() {
+  if (meter.isRunning()) {
+    switch (meter.poll()) {
+      case MINGHE_RESISTANCE_RUNNING:
+        break;
+
+      case MINGHE_RESISTANCE_DONE:
+        report();
+        break;
+
+      case MINGHE_RESISTANCE_NO_STEP:
+        // In CV, the battery takes less than the step - it's nearly full.
+        LOGGER.println(F("Current didn't change - done charging?"));
+        break;
+
+      default:
+        LOGGER.print(F("Measurement failed, status "));
+        LOGGER.println(meter.getLastStatus());
+        break;
+    }
+  } else if ((millis() - last_measure_ms) >= MEASURE_MS) {
+    last_measure_ms = millis();
+    meter.start(STEP_CURRENT, true);
+  }
+
+  // The rest of the charge logic goes here.
+}
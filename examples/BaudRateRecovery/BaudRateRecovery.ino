@@ -0,0 +1,94 @@
+/*
+ * Baud rate changes that don't go cleanly, run against the emulator.  After
+ * the device is told to change rate, the driver checks it answers at the new
+ * one.  At a marginal rate that check can get lost even though the device did
+ * switch - and then going back to the old rate would leave the two ends
+ * talking past each other for good.  setBaudRate looks for the device at both
+ * rates instead, and stays on whichever it answers at.
+ *
+ * Each case prints what setBaudRate returned, where the driver ended up, and
+ * whether the device still answers.
+ *
+ * At 1200 baud, the device's CR LF takes over 16ms after the frame has been
+ * decoded.  With no frame gaps configured, every read should still get
+ * through first time, and the change back up should go cleanly.
+ */
+
+#define LOGGER Serial
+
+#include "MingHeBuckConverter.h"
+#include "MingHeEmulator.h"
+
+MingHeEmulator emulator(1, 6015);
+MingHeBuckConverter converter(&emulator, 1);
+
+// The emulated line follows the driver, as a caller-owned port would.
+void changeLineRate(const uint32_t baud_rate) {
+  emulator.setBaudRate(baud_rate);
+}
+
+void tryChange(const __FlashStringHelper *name, const uint8_t baud_index,
+        const uint8_t deaf_frames) {
+  MingHeFaultProfile profile;
+  bool changed;
+
+  memset(&profile, 0, sizeof(profile));
+  profile.deaf_after_baud_frames = deaf_frames;
+  emulator.setFaultProfile(profile);
+
+  changed = converter.setBaudRate(baud_index);
+
+  LOGGER.print(name);
+  LOGGER.print(F(": "));
+  LOGGER.print(changed ? F("changed") : F("not changed"));
+  LOGGER.print(F(", now at "));
+  LOGGER.print(MingHeBuckConverter::baudRateFromIndex(
+          converter.getBaudIndex()));
+  LOGGER.print(F(", model "));
+  LOGGER.println(converter.getMachineModel());
+}
+
+// Back to back reads with no frame gaps, counting requests the device missed.
+void readBackToBack(const uint8_t reads) {
+  MingHeFrameGaps gaps;
+  uint8_t good = 0;
+
+  memset(&gaps, 0, sizeof(gaps));
+  converter.setFrameGaps(gaps);
+  emulator.resetCounters();
+  for (uint8_t i = 0; i < reads; i++) {
+    if (converter.getMachineModel() == 6015) {
+      good++;
+    }
+  }
+
+  LOGGER.print(F("Back to back at "));
+  LOGGER.print(MingHeBuckConverter::baudRateFromIndex(
+          converter.getBaudIndex()));
+  LOGGER.print(F(": "));
+  LOGGER.print(good);
+  LOGGER.print(F("/"));
+  LOGGER.print(reads);
+  LOGGER.print(F(" read, "));
+  LOGGER.print(emulator.getCounters().ignored_requests);
+  LOGGER.println(F(" requests missed"));
+}
+
+void setup() {
+  LOGGER.begin(115200);
+
+  converter.setBaudRateCallback(changeLineRate);
+
+  tryChange(F("Clean change to 19200"), MINGHE_BAUD_19200, 0);
+  // Deaf for longer than the check's attempts: the device switched, but the
+  // driver can't tell until it looks again.
+  tryChange(F("Check lost on the way to 38400"), MINGHE_BAUD_38400,
+          MINGHE_DEFAULT_ATTEMPTS);
+
+  tryChange(F("Down to 1200"), MINGHE_BAUD_1200, 0);
+  readBackToBack(20);
+  tryChange(F("Back up to 57600"), MINGHE_BAUD_57600, 0);
+}
+
+void loop() {
+}
@@ -0,0 +1,103 @@
+/*
+ * A CC/CV battery charger, run against an emulated converter with a battery
+ * on its output.  The charge logic only talks to the converter through the
+ * driver, so it's the same code that would run a real unit - but the battery
+ * is a MingHePlant, running 100 times faster than real time, so a charge of a
+ * couple of hours is over in about a minute.
+ *
+ * Watch the limiting factor move from CC to CV as the battery fills and the
+ * current tapers off, and the heatsink warm up and cool again.
+ */
+
+#define LOGGER Serial
+
+#include "MingHeBuckConverter.h"
+#include "MingHeEmulator.h"
+#include "MingHePlant.h"
+
+// A 3S lithium pack: 9.00V empty, 12.60V full, 2Ah, 150 milliohms, 20% full.
+#define CHARGE_VOLTAGE 1260
+#define CHARGE_CURRENT 100
+// Stop once the current tapers to C/20.
+#define TERMINATION_CURRENT 10
+#define TIME_SCALE 100
+// Report every simulated minute.
+#define REPORT_MS (60000UL / TIME_SCALE)
+
+const MingHeBattery battery = {900, 1260, 2000, 150, 200};
+
+MingHePlant plant;
+MingHeEmulator emulator(1, 6015);
+MingHeBuckConverter converter(&emulator, 1);
+
+uint32_t start_ms, last_report_ms;
+bool charging, seen_cc;
+
+void report(void) {
+  uint32_t minutes = ((millis() - start_ms) * TIME_SCALE) / 60000UL;
+
+  LOGGER.print(minutes);
+  LOGGER.print(F(" min: "));
+  LOGGER.print(converter.getVoltage());
+  LOGGER.print(F(" V/100, "));
+  LOGGER.print(converter.getCurrent());
+  LOGGER.print(F(" A/100, "));
+  LOGGER.print((converter.getLimitingFactor() ==
+          MINGHE_LIMITING_FACTOR_CURRENT) ? F("CC") : F("CV"));
+  LOGGER.print(F(", "));
+  LOGGER.print(converter.getTemperature());
+  LOGGER.print(F("C, "));
+  LOGGER.print(converter.getmAmpHours());
+  LOGGER.println(F(" mAh in"));
+}
+
+void setup() {
+  LOGGER.begin(115200);
+
+  plant.setBatteryLoad(battery);
+  // Soft start: 5V/s and 1A/s.
+  plant.setSlew(500, 100);
+  plant.setTimeScale(TIME_SCALE);
+  emulator.setPlant(&plant);
+
+  converter.setmAmpHours(0);
+  converter.setMaxVoltage(CHARGE_VOLTAGE);
+  converter.setMaxCurrent(CHARGE_CURRENT);
+  converter.setOutputEnabled(true);
+  start_ms = last_report_ms = millis();
+  charging = true;
+  seen_cc = false;
+}
+
+void loop() {
+  uint16_t current;
+  uint8_t limiting_factor;
+
+  if (!charging) {
+    return;
+  }
+
+  // While the soft start ramps up past the battery voltage, nothing flows and
+  // it's in CV - so only stop on a low current once it has been through CC.
+  current = converter.getCurrent();
+  if (converter.getLastStatus() != MINGHE_STATUS_OK) {
+    return;
+  }
+  limiting_factor = converter.getLimitingFactor();
+  if (limiting_factor == MINGHE_LIMITING_FACTOR_CURRENT) {
+    seen_cc = true;
+  } else if (seen_cc &&
+          (limiting_factor == MINGHE_LIMITING_FACTOR_VOLTAGE) &&
+          (current < TERMINATION_CURRENT)) {
+    report();
+    converter.setOutputEnabled(false);
+    LOGGER.println(F("Charge complete."));
+    charging = false;
+    return;
+  }
+
+  if ((millis() - last_report_ms) >= REPORT_MS) {
+    last_report_ms = millis();
+    report();
+  }
+}
@@ -0,0 +1,144 @@
+#include <LiteSerialLogger.h>
+
+/*
+ * Driver resilience benchmark.  Runs the driver against the MingHeEmulator
+ * under a set of line fault profiles and reports effective throughput and the
+ * latency distribution of a plain get command for each.
+ *
+ * No converter needed - everything runs on the Arduino itself.  Use this to
+ * tune retry and timeout settings with data instead of guesswork.
+ */
+
+#define LOGGER LiteSerial
+//#define LOGGER Serial
+
+// Requests per profile.  Each latency sample is 2 bytes of SRAM.
+#define SAMPLES_PER_PROFILE 100
+
+// A value the emulator holds, so a read that claims success can be checked.
+#define EXPECTED_MAX_VOLTAGE 1234
+
+#include "MingHeBuckConverter.h"
+#include "MingHeEmulator.h"
+
+MingHeEmulator emulator(1, 6015);
+MingHeBuckConverter converter(&emulator, 1);
+
+/*
+ * min/max delay, tail delay, tail chance, drop, flip, spurious, stuck err
+ * chance, stuck err length, deaf after baud change.  Chances are per thousand.
+ */
+const MingHeFaultProfile PROGMEM profiles[] = {
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+  {5, 40, 300, 10, 0, 0, 0, 0, 0, 0},
+  {2, 10, 0, 0, 5, 0, 0, 0, 0, 0},
+  {2, 10, 0, 0, 0, 20, 0, 0, 0, 0},
+  {2, 10, 0, 0, 0, 0, 50, 0, 0, 0},
+  {2, 10, 0, 0, 0, 0, 0, 10, 5, 0},
+  {5, 40, 300, 10, 2, 10, 20, 5, 3, 0},
+};
+
+const char PROGMEM name_clean[] = "clean";
+const char PROGMEM name_jitter[] = "jitter + 1% 300ms tail";
+const char PROGMEM name_drop[] = "0.5% dropped bytes";
+const char PROGMEM name_flip[] = "2% bit flips";
+const char PROGMEM name_spurious[] = "5% spurious frames";
+const char PROGMEM name_stuck[] = "1% stuck err x5";
+const char PROGMEM name_all[] = "everything at once";
+
+const char * const PROGMEM profile_names[] = {
+  name_clean, name_jitter, name_drop, name_flip, name_spurious, name_stuck,
+  name_all,
+};
+
+#define PROFILE_COUNT (sizeof(profiles) / sizeof(profiles[0]))
+
+uint16_t latency_ms[SAMPLES_PER_PROFILE];
+
+// Insertion sort - small array, and this is not the part being measured.
+void sortLatencies(void) {
+  for (uint16_t i = 1; i < SAMPLES_PER_PROFILE; i++) {
+    uint16_t value = latency_ms[i];
+    uint16_t j = i;
+    while (j && latency_ms[j - 1] > value) {
+      latency_ms[j] = latency_ms[j - 1];
+      j--;
+    }
+    latency_ms[j] = value;
+  }
+}
+
+uint16_t percentile(const uint8_t pct) {
+  return latency_ms[((uint32_t)(SAMPLES_PER_PROFILE - 1) * pct) / 100];
+}
+
+void runProfile(const uint8_t index) {
+  MingHeFaultProfile profile;
+  uint32_t start_ms, elapsed_ms, request_start_us;
+  uint16_t good = 0;
+
+  memcpy_P(&profile, &profiles[index], sizeof(profile));
+  emulator.setFaultProfile(profile);
+  emulator.setMaxVoltage(EXPECTED_MAX_VOLTAGE);
+  emulator.resetCounters();
+
+  start_ms = millis();
+  for (uint16_t i = 0; i < SAMPLES_PER_PROFILE; i++) {
+    request_start_us = micros();
+    MingHeReading reading = converter.getReading(MINGHE_COMMAND_MAX_VOLTAGE);
+    if (reading.ok() && (reading.value == EXPECTED_MAX_VOLTAGE)) {
+      good++;
+    }
+    latency_ms[i] = (micros() - request_start_us) / 1000;
+  }
+  elapsed_ms = millis() - start_ms;
+  if (!elapsed_ms) {
+    elapsed_ms = 1;
+  }
+
+  sortLatencies();
+
+  LOGGER.print(F("Profile: "));
+  LOGGER.println((const __FlashStringHelper *)
+          pgm_read_ptr(&profile_names[index]));
+  LOGGER.print(F("  Good reads: "));
+  LOGGER.print(good);
+  LOGGER.print(F(" / "));
+  LOGGER.println(SAMPLES_PER_PROFILE);
+  LOGGER.print(F("  Throughput (good reads/s): "));
+  LOGGER.println((good * 1000UL) / elapsed_ms);
+  LOGGER.print(F("  Latency p50/p90/p99/max (ms): "));
+  LOGGER.print(percentile(50));
+  LOGGER.print(F(" / "));
+  LOGGER.print(percentile(90));
+  LOGGER.print(F(" / "));
+  LOGGER.print(percentile(99));
+  LOGGER.print(F(" / "));
+  LOGGER.println(latency_ms[SAMPLES_PER_PROFILE - 1]);
+
+  const MingHeEmulatorCounters &counters = emulator.getCounters();
+  LOGGER.print(F("  Injected: dropped bytes "));
+  LOGGER.print(counters.dropped_bytes);
+  LOGGER.print(F(", flips "));
+  LOGGER.print(counters.flipped_frames);
+  LOGGER.print(F(", spurious "));
+  LOGGER.print(counters.spurious_frames);
+  LOGGER.print(F(", err "));
+  LOGGER.print(counters.err_replies);
+  LOGGER.print(F(", tail delays "));
+  LOGGER.println(counters.tail_delays);
+}
+
+void setup() {
+  delay(2000);
+
+  LOGGER.begin(115200);
+
+  for (uint8_t i = 0; i < PROFILE_COUNT; i++) {
+    runProfile(i);
+  }
+  LOGGER.println(F("Benchmark complete."));
+}
+
+void loop() {
+}
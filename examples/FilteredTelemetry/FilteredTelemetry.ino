@@ -0,0 +1,70 @@
+/*
+ * Filtered readings with MingHeTelemetry.  The voltage and current are read
+ * every 200ms without blocking, the voltage through a median filter and the
+ * current through a Kalman filter, and both are printed as read and as
+ * filtered once a second.
+ *
+ * Also counted is how often each value changed - how many writes a controller
+ * acting on every change would have made.  On a steady load, the filtered
+ * values change far less often than the raw ones.
+ */
+
+#include "MingHeBuckConverter.h"
+#include "MingHeFilter.h"
+#include "MingHeTelemetry.h"
+
+#define PRINT_MS 1000
+
+// TX pin 3, RX pin 2, Device ID 01
+MingHeBuckConverter converter(3, 2, 1, MINGHE_BAUD_9600);
+MingHeTelemetry telemetry(&converter);
+
+// A reading a few counts off now and then is thrown out, and steady jitter of
+// a count or two is smoothed away.
+MingHeMedianFilter voltage_filter(5);
+MingHeKalmanFilter current_filter(1, 4);
+
+uint32_t last_print_ms;
+uint32_t last_raw, last_filtered;
+uint16_t raw_changes, filtered_changes;
+
+void setup() {
+  Serial.begin(115200);
+
+  telemetry.setInterval(200);
+  telemetry.setFilter(MINGHE_TELEMETRY_VOLTAGE, &voltage_filter);
+  telemetry.setFilter(MINGHE_TELEMETRY_CURRENT, &current_filter);
+}
+
+void printChannel(const __FlashStringHelper *name, const uint8_t channel) {
+  Serial.print(name);
+  Serial.print(telemetry.getRaw(channel));
+  Serial.print(F(" raw, "));
+  Serial.print(telemetry.getValue(channel));
+  Serial.print(F(" filtered  "));
+}
+
+void loop() {
+  if (telemetry.poll() && telemetry.hasSample(MINGHE_TELEMETRY_CURRENT)) {
+    if (telemetry.getRaw(MINGHE_TELEMETRY_CURRENT) != last_raw) {
+      last_raw = telemetry.getRaw(MINGHE_TELEMETRY_CURRENT);
+      raw_changes++;
+    }
+    if (telemetry.getValue(MINGHE_TELEMETRY_CURRENT) != last_filtered) {
+      last_filtered = telemetry.getValue(MINGHE_TELEMETRY_CURRENT);
+      filtered_changes++;
+    }
+  }
+
+  if ((millis() - last_print_ms) >= PRINT_MS) {
+    last_print_ms = millis();
+    printChannel(F("V/100: "), MINGHE_TELEMETRY_VOLTAGE);
+    printChannel(F("A/100: "), MINGHE_TELEMETRY_CURRENT);
+    Serial.print(F("current changes: "));
+    Serial.print(raw_changes);
+    Serial.print(F(" raw, "));
+    Serial.println(filtered_changes);
+  }
+
+  // Everything else the sketch does goes here.
+}
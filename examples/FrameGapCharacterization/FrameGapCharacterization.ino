@@ -0,0 +1,64 @@
+#include <LiteSerialLogger.h>
+
+/*
+ * Measure the minimum reliable gap between frames, per transition type and per
+ * baud rate, and print a table to paste into your sketch:
+ *
+ *   converter.setFrameGapTable(frame_gaps);
+ *
+ * By default this runs against the emulator, set up with known minimum gaps,
+ * so you can see the search find them.  Comment out USE_EMULATOR to measure a
+ * real converter - and expect it to take a few minutes per baud rate.
+ */
+
+#define LOGGER LiteSerial
+//#define LOGGER Serial
+
+#define USE_EMULATOR
+
+// Baud rates to characterize.  Don't go past 57600 with SoftwareSerial.
+#define MIN_BAUD MINGHE_BAUD_9600
+#define MAX_BAUD MINGHE_BAUD_38400
+
+#include "MingHeBuckConverter.h"
+#include "MingHeGapCharacterizer.h"
+
+#ifdef USE_EMULATOR
+#include "MingHeEmulator.h"
+
+MingHeEmulator emulator(1, 6015);
+MingHeBuckConverter converter(&emulator, 1);
+
+void changeEmulatorBaud(const uint32_t baud_rate) {
+  emulator.setBaudRate(baud_rate);
+}
+#else
+// TX pin 3, RX pin 2, Device ID 01
+MingHeBuckConverter converter(3, 2, 1, MINGHE_BAUD_9600);
+#endif
+
+MingHeGapCharacterizer characterizer(&converter);
+MingHeFrameGaps table[MINGHE_BAUD_COUNT];
+
+void setup() {
+  delay(2000);
+
+  LOGGER.begin(115200);
+
+#ifdef USE_EMULATOR
+  // The emulated device needs 1ms between reads, and 3ms either side of a
+  // write.
+  MingHeFrameGaps device_gaps = {{{1000, 3000}, {3000, 3000}}};
+  emulator.setMinimumGaps(device_gaps);
+  converter.setBaudRateCallback(changeEmulatorBaud);
+#endif
+
+  LOGGER.println(F("Characterizing frame gaps..."));
+  if (!characterizer.characterizeBaudRates(table, MIN_BAUD, MAX_BAUD)) {
+    LOGGER.println(F("Warning: some rates could not be characterized."));
+  }
+  MingHeGapCharacterizer::printTable(LOGGER, table);
+}
+
+void loop() {
+}
@@ -176,7 +176,9 @@ bool testTemperatureSet(void) {
   uint16_t old_shutdown_temperature = 0;
   uint16_t old_fan_start_temperature = 0;
 
-  if (!converter.getTemperature()) {
+  // A failed read returns 0 - check the status rather than the value.
+  converter.getTemperature();
+  if (converter.getLastStatus() != MINGHE_STATUS_OK) {
     LOGGER.println(F("Error: Cannot get temperature."));
     success = false;
   }
@@ -0,0 +1,43 @@
+/*
+ * The smallest useful setup: set the voltage and current limits, switch the
+ * output on, and watch what comes out.  No serial logging - this is what the
+ * driver costs on its own, for sizing against a small part.
+ *
+ * Build it with the features you don't need turned off (see MingHeConfig.h),
+ * or run extras/size_report.sh to see what each combination costs.
+ */
+
+#include "MingHeBuckConverter.h"
+
+// 5.00V, 1.00A.
+#define TARGET_VOLTAGE 500
+#define TARGET_CURRENT 100
+
+// Turn the output off if the voltage drops below this (a short, or overload).
+#define MINIMUM_VOLTAGE 450
+
+// TX pin 3, RX pin 2, Device ID 01
+MingHeBuckConverter converter(3, 2, 1, MINGHE_BAUD_9600);
+
+bool output_on;
+
+void setup() {
+  output_on = converter.setMaxVoltage(TARGET_VOLTAGE) &&
+      converter.setMaxCurrent(TARGET_CURRENT) &&
+      converter.setOutputEnabled(true);
+}
+
+void loop() {
+  uint16_t volts;
+
+  if (!output_on) {
+    return;
+  }
+
+  volts = converter.getVoltage();
+  if ((converter.getLastStatus() == MINGHE_STATUS_OK) && 
+          (volts < MINIMUM_VOLTAGE)) {
+    output_on = !converter.setOutputEnabled(false);
+  }
+  delay(1000);
+}
@@ -0,0 +1,63 @@
+/*
+ * Reading the converter without stopping the rest of the sketch.  The voltage
+ * and current are read in turn with beginGet and poll, while loop() keeps
+ * blinking the LED on time - no delay() anywhere, and no waiting on the
+ * device.
+ *
+ * Use a hardware serial port for this if the board has a spare one.  The
+ * request goes into its transmit buffer and the UART interrupt sends it while
+ * loop() runs.  SoftwareSerial works too, but holds the CPU for each request
+ * (about 12ms at 9600 baud) while it bit-bangs it out.
+ */
+
+#include "MingHeBuckConverter.h"
+
+#define BLINK_MS 250
+
+// TX pin 3, RX pin 2, Device ID 01
+MingHeBuckConverter converter(3, 2, 1, MINGHE_BAUD_9600);
+
+const char commands[] = {MINGHE_COMMAND_VOLTAGE, MINGHE_COMMAND_CURRENT};
+uint8_t next_command;
+uint16_t readings[sizeof(commands)];
+
+uint32_t last_blink_ms;
+bool led_on;
+
+void setup() {
+  Serial.begin(115200);
+  pinMode(LED_BUILTIN, OUTPUT);
+}
+
+void loop() {
+  uint8_t status;
+
+  // Keep one transaction going all the time.  If beginGet can't start one -
+  // the unit is quarantined, or the command is unsupported or out of range for
+  // it - that's the command's result, and it's on to the next.
+  if (converter.isBusy() || converter.beginGet(commands[next_command])) {
+    status = converter.poll();
+  } else {
+    status = converter.getLastStatus();
+  }
+
+  if (status != MINGHE_STATUS_PENDING) {
+    if (status == MINGHE_STATUS_OK) {
+      readings[next_command] = converter.getAsyncReading().value;
+    }
+    if (++next_command >= sizeof(commands)) {
+      next_command = 0;
+      Serial.print(readings[0]);
+      Serial.print(F(" V/100, "));
+      Serial.print(readings[1]);
+      Serial.println(F(" A/100"));
+    }
+  }
+
+  // Everything else the sketch does goes here.
+  if ((millis() - last_blink_ms) >= BLINK_MS) {
+    last_blink_ms = millis();
+    led_on = !led_on;
+    digitalWrite(LED_BUILTIN, led_on);
+  }
+}
@@ -0,0 +1,150 @@
+#include <LiteSerialLogger.h>
+
+/*
+ * Bus scaling benchmark.  Builds racks of 1 to 16 emulated converters on one
+ * shared line (MingHeRack) and, for each, times:
+ *
+ *   - a discovery scan of addresses 1-20, one quick probe each,
+ *   - round-robin polling of every unit through a MingHeBus,
+ *   - switching every output on, one verified set per unit,
+ *   - round-robin polling again with one unit that sometimes answers after
+ *     its timeout - its late replies collide with the next unit's.
+ *
+ * No converters needed.  Each emulated unit and its driver take a few hundred
+ * bytes of SRAM, so on anything smaller than a Mega trim RACK_SIZES.
+ */
+
+#define LOGGER LiteSerial
+//#define LOGGER Serial
+
+#include "MingHeBuckConverter.h"
+#include "MingHeBus.h"
+#include "MingHeEmulator.h"
+#include "MingHeRack.h"
+
+#define MAX_UNITS 16
+const uint8_t RACK_SIZES[] = {1, 2, 4, 8, 16};
+
+// Addresses tried by the scan, and how long to wait on each.
+#define SCAN_LIMIT 20
+#define SCAN_DEADLINE_MS 100
+#define READS_PER_UNIT 10
+
+// The slow unit answers in 2-10ms, except 20% of the time it takes 250ms -
+// past the 200ms response timeout.
+const MingHeFaultProfile PROGMEM slow_profile =
+  {2, 10, 250, 200, 0, 0, 0, 0, 0, 0};
+
+MingHeEmulator *emulators[MAX_UNITS];
+MingHeBuckConverter *converters[MAX_UNITS];
+
+// Poll every unit READS_PER_UNIT times, round-robin.  Returns the good reads,
+// and the time taken in elapsed_ms.
+uint16_t pollRack(MingHeBus &bus, const uint8_t units, uint32_t *elapsed_ms) {
+  uint32_t start_ms = millis();
+  uint16_t good = 0;
+  MingHeBuckConverter *unit;
+
+  for (uint16_t i = 0; i < (uint16_t)units * READS_PER_UNIT; i++) {
+    unit = bus.next();
+    if (unit && unit->getReading(MINGHE_COMMAND_VOLTAGE).ok()) {
+      good++;
+    }
+  }
+  *elapsed_ms = millis() - start_ms;
+  if (!*elapsed_ms) {
+    *elapsed_ms = 1;
+  }
+  return good;
+}
+
+void runRack(const uint8_t units) {
+  MingHeRack rack;
+  MingHeBus bus;
+  MingHeFaultProfile profile;
+  uint32_t start_ms, elapsed_ms;
+  uint16_t good;
+  uint8_t found = 0, switched = 0;
+
+  for (uint8_t i = 0; i < units; i++) {
+    emulators[i] = new MingHeEmulator(i + 1, 6015);
+    rack.addUnit(emulators[i]);
+    converters[i] = new MingHeBuckConverter(&rack, i + 1);
+    bus.addUnit(converters[i]);
+  }
+
+  LOGGER.print(F("Units: "));
+  LOGGER.println(units);
+
+  // Discovery.  One driver, moved from address to address, giving up quickly
+  // on the ones that don't answer.
+  MingHeBuckConverter scanner(&rack, 1);
+  scanner.setLineState(bus.getLineState());
+  scanner.setRetryPolicy(1, 0, SCAN_DEADLINE_MS);
+  scanner.setQuarantinePolicy(0, 0, 0);
+  start_ms = millis();
+  for (uint8_t address = 1; address <= SCAN_LIMIT; address++) {
+    scanner.resetDeviceId(address);
+    scanner.getMachineModel();
+    if (scanner.getLastStatus() == MINGHE_STATUS_OK) {
+      found++;
+    }
+  }
+  LOGGER.print(F("  Scan: found "));
+  LOGGER.print(found);
+  LOGGER.print(F(" in "));
+  LOGGER.print(millis() - start_ms);
+  LOGGER.println(F(" ms"));
+
+  good = pollRack(bus, units, &elapsed_ms);
+  LOGGER.print(F("  Polling: "));
+  LOGGER.print(good);
+  LOGGER.print(F(" good, "));
+  LOGGER.print((good * 1000UL) / elapsed_ms);
+  LOGGER.println(F(" reads/s"));
+
+  start_ms = millis();
+  for (uint8_t i = 0; i < units; i++) {
+    if (converters[i]->setOutputEnabled(true)) {
+      switched++;
+    }
+  }
+  LOGGER.print(F("  All outputs on: "));
+  LOGGER.print(switched);
+  LOGGER.print(F(" in "));
+  LOGGER.print(millis() - start_ms);
+  LOGGER.println(F(" ms"));
+
+  // One slow unit, tried once per read so the rest don't wait on retries.
+  memcpy_P(&profile, &slow_profile, sizeof(profile));
+  emulators[0]->setFaultProfile(profile);
+  converters[0]->setRetryPolicy(1, 0, MINGHE_DEFAULT_DEADLINE_MS);
+  rack.resetCounters();
+  good = pollRack(bus, units, &elapsed_ms);
+  LOGGER.print(F("  With a slow unit: "));
+  LOGGER.print(good);
+  LOGGER.print(F(" / "));
+  LOGGER.print(units * READS_PER_UNIT);
+  LOGGER.print(F(" good, "));
+  LOGGER.print((good * 1000UL) / elapsed_ms);
+  LOGGER.print(F(" reads/s, "));
+  LOGGER.print(rack.getCounters().collided_bytes);
+  LOGGER.println(F(" bytes collided"));
+
+  for (uint8_t i = 0; i < units; i++) {
+    delete converters[i];
+    delete emulators[i];
+  }
+}
+
+void setup() {
+  LOGGER.begin(115200);
+
+  for (uint8_t i = 0; i < sizeof(RACK_SIZES); i++) {
+    runRack(RACK_SIZES[i]);
+  }
+  LOGGER.println(F("Benchmark complete."));
+}
+
+void loop() {
+}
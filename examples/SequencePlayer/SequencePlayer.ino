@@ -0,0 +1,110 @@
+/*
+ * A load profile, played from a table in flash with MingHeSequencePlayer,
+ * against an emulated converter with a 10 ohm load.  A voltage staircase from
+ * 5V to 12V, a step every half second, three times over - then it waits for
+ * the current to settle and switches off.
+ *
+ * For comparison, the same staircase is run first the usual way, with the
+ * blocking setters and delay().  Every set and its verify read push the rest
+ * of the profile back, so it runs long.  The player times each step from when
+ * the one before was due, so it finishes on time, with each step a frame's
+ * time late at worst.
+ *
+ * A profile can be read from a file instead, with readSequence - see
+ * MingHeSequence.h for the format.
+ */
+
+#define LOGGER Serial
+
+#include "MingHeBuckConverter.h"
+#include "MingHeEmulator.h"
+#include "MingHePlant.h"
+#include "MingHeSequence.h"
+
+#define STAIR_MS 500
+#define REPEATS 3
+
+const MingHeSequenceStep PROGMEM profile[] = {
+  MINGHE_STEP_SET(0, MINGHE_COMMAND_MAX_CURRENT, 200),
+  MINGHE_STEP_SET(0, MINGHE_COMMAND_MAX_VOLTAGE, 500),
+  MINGHE_STEP_OUTPUT(0, true),
+  // Step 3: the staircase.
+  MINGHE_STEP_SET(STAIR_MS, MINGHE_COMMAND_MAX_VOLTAGE, 600),
+  MINGHE_STEP_SET(STAIR_MS, MINGHE_COMMAND_MAX_VOLTAGE, 700),
+  MINGHE_STEP_SET(STAIR_MS, MINGHE_COMMAND_MAX_VOLTAGE, 800),
+  MINGHE_STEP_SET(STAIR_MS, MINGHE_COMMAND_MAX_VOLTAGE, 900),
+  MINGHE_STEP_SET(STAIR_MS, MINGHE_COMMAND_MAX_VOLTAGE, 1000),
+  MINGHE_STEP_SET(STAIR_MS, MINGHE_COMMAND_MAX_VOLTAGE, 1100),
+  MINGHE_STEP_SET(STAIR_MS, MINGHE_COMMAND_MAX_VOLTAGE, 1200),
+  MINGHE_STEP_SET(STAIR_MS, MINGHE_COMMAND_MAX_VOLTAGE, 500),
+  MINGHE_STEP_LOOP(0, 3, REPEATS),
+  // 1.2A at 12V, so 0.5A flows at 5V - wait up to 2s for that.
+  MINGHE_STEP_WAIT_BELOW(0, MINGHE_COMMAND_CURRENT, 50, 20),
+  MINGHE_STEP_OUTPUT(STAIR_MS, false),
+  MINGHE_STEP_END
+};
+
+// Eight stairs a time round, and the half second at the end.
+#define PROFILE_MS ((8UL * REPEATS + 1) * STAIR_MS)
+
+MingHePlant plant;
+MingHeEmulator emulator(1, 6015);
+MingHeBuckConverter converter(&emulator, 1);
+MingHeSequencePlayer player(&converter);
+
+uint32_t start_ms;
+
+void runBlocking(void) {
+  converter.setMaxCurrent(200);
+  converter.setMaxVoltage(500);
+  converter.setOutputEnabled(true);
+  for (uint8_t repeat = 0; repeat < REPEATS; repeat++) {
+    for (uint16_t volts = 600; volts <= 1200; volts += 100) {
+      delay(STAIR_MS);
+      converter.setMaxVoltage(volts);
+    }
+    delay(STAIR_MS);
+    converter.setMaxVoltage(500);
+  }
+  delay(STAIR_MS);
+  converter.setOutputEnabled(false);
+}
+
+void setup() {
+  LOGGER.begin(115200);
+
+  plant.setResistiveLoad(10000);
+  emulator.setPlant(&plant);
+
+  start_ms = millis();
+  runBlocking();
+  LOGGER.print(F("Blocking: "));
+  LOGGER.print(millis() - start_ms);
+  LOGGER.print(F(" ms for a "));
+  LOGGER.print(PROFILE_MS);
+  LOGGER.println(F(" ms profile"));
+
+  start_ms = millis();
+  player.start(profile);
+}
+
+void loop() {
+  // Anything else the sketch does can go here.
+  if (player.poll() == MINGHE_SEQUENCE_RUNNING) {
+    return;
+  }
+  if (!start_ms) {
+    return;
+  }
+
+  LOGGER.print(F("Player: "));
+  LOGGER.print(millis() - start_ms);
+  LOGGER.print(F(" ms, "));
+  LOGGER.print(player.getStepsPlayed());
+  LOGGER.print(F(" steps, worst "));
+  LOGGER.print(player.getMaxLateMs());
+  LOGGER.print(F(" ms late, "));
+  LOGGER.println((player.getState() == MINGHE_SEQUENCE_DONE) ? F("done") :
+          F("failed"));
+  start_ms = 0;
+}
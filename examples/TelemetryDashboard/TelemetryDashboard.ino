@@ -0,0 +1,119 @@
+/*
+ * Rolling statistics with MingHeTelemetry and MingHeWindowStats.  The
+ * voltage, current, power and temperature are read every quarter second, and
+ * each is fed to a one minute window.  Every ten seconds the minimum, maximum,
+ * mean and standard deviation of each over the last minute are printed -
+ * without keeping a minute of readings anywhere.
+ *
+ * Every reading is printed too, as ms,channel,value, so the log can be run
+ * through extras/window_stats.py for exact windows of any length:
+ *
+ *   extras/window_stats.py log.csv --window 300 --every 60
+ *
+ * The summary lines start with #, which the script skips.
+ *
+ * The four windows take about 520 bytes of SRAM.
+ */
+
+#include "MingHeBuckConverter.h"
+#include "MingHeTelemetry.h"
+#include "MingHeWindowStats.h"
+
+#define WINDOW_MS 60000UL
+#define SUMMARY_MS 10000UL
+#define CHANNELS 4
+
+// TX pin 3, RX pin 2, Device ID 01
+MingHeBuckConverter converter(3, 2, 1, MINGHE_BAUD_9600);
+MingHeTelemetry telemetry(&converter);
+
+const uint8_t channels[CHANNELS] = {
+  MINGHE_TELEMETRY_VOLTAGE,
+  MINGHE_TELEMETRY_CURRENT,
+  MINGHE_TELEMETRY_WATTS,
+  MINGHE_TELEMETRY_TEMPERATURE,
+};
+const char *const names[CHANNELS] = {
+  "voltage", "current", "watts", "temperature"
+};
+
+MingHeWindowStats windows[CHANNELS] = {
+  MingHeWindowStats(WINDOW_MS),
+  MingHeWindowStats(WINDOW_MS),
+  MingHeWindowStats(WINDOW_MS),
+  MingHeWindowStats(WINDOW_MS),
+};
+
+uint32_t last_sample_ms[CHANNELS];
+uint32_t last_summary_ms;
+
+void setup() {
+  uint8_t enabled = 0;
+
+  Serial.begin(115200);
+
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    enabled |= MINGHE_TELEMETRY_BIT(channels[i]);
+    telemetry.addStats(channels[i], &windows[i]);
+  }
+  telemetry.setChannels(enabled);
+  telemetry.setInterval(250);
+}
+
+// Means and standard deviations come in 1/16ths.
+void printSixteenths(const uint32_t value) {
+  uint8_t hundredths = (value % MINGHE_WINDOW_FRACTION) * 100 /
+          MINGHE_WINDOW_FRACTION;
+
+  Serial.print(value / MINGHE_WINDOW_FRACTION);
+  Serial.print(hundredths < 10 ? F(".0") : F("."));
+  Serial.print(hundredths);
+}
+
+void printSummary(const uint8_t i) {
+  MingHeWindowSummary summary;
+
+  if (!windows[i].getSummary(&summary)) {
+    return;
+  }
+  Serial.print(F("# "));
+  Serial.print(names[i]);
+  Serial.print(F(" over "));
+  Serial.print(summary.span_ms / 1000);
+  Serial.print(F("s: "));
+  Serial.print(summary.count);
+  Serial.print(F(" readings, min "));
+  Serial.print(summary.min);
+  Serial.print(F(", max "));
+  Serial.print(summary.max);
+  Serial.print(F(", mean "));
+  printSixteenths(summary.mean);
+  Serial.print(F(", stddev "));
+  printSixteenths(summary.stddev);
+  Serial.println();
+}
+
+void loop() {
+  if (telemetry.poll()) {
+    // Print whichever channel just came in.
+    for (uint8_t i = 0; i < CHANNELS; i++) {
+      if (telemetry.getSampleMs(channels[i]) != last_sample_ms[i]) {
+        last_sample_ms[i] = telemetry.getSampleMs(channels[i]);
+        Serial.print(last_sample_ms[i]);
+        Serial.print(',');
+        Serial.print(names[i]);
+        Serial.print(',');
+        Serial.println(telemetry.getRaw(channels[i]));
+      }
+    }
+  }
+
+  if ((millis() - last_summary_ms) >= SUMMARY_MS) {
+    last_summary_ms = millis();
+    for (uint8_t i = 0; i < CHANNELS; i++) {
+      printSummary(i);
+    }
+  }
+
+  // Everything else the sketch does goes here.
+}
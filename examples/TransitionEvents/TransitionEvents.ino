@@ -0,0 +1,116 @@
+/*
+ * Transition callbacks with MingHeTelemetry, run against an emulated
+ * converter so it all happens on the bench in a few seconds.  A 10 ohm load
+ * on a 12V, 0.5A supply holds it in CC; raising the current limit moves it to
+ * CV.  The heatsink is set up too small for the load, so it warms past the
+ * fan start and then the shutdown temperature, the output trips off, and it
+ * cools back down again.
+ *
+ * Nothing in loop reads the limiting factor, output state or temperature -
+ * each change is printed by a callback as telemetry picks it up.
+ */
+
+#define LOGGER Serial
+
+#include "MingHeBuckConverter.h"
+#include "MingHeEmulator.h"
+#include "MingHePlant.h"
+#include "MingHeTelemetry.h"
+
+#define TIME_SCALE 100
+// Raise the current limit after a simulated minute.
+#define STEP_MS (60000UL / TIME_SCALE)
+
+// 25C ambient, 10% loss, 50C/W without the fan and 45C/W with it - not enough
+// for the 14.4W the load takes in CV.
+const MingHeThermal thermal = {25, 10, 500, 450, 60};
+
+MingHePlant plant;
+MingHeEmulator emulator(1, 6015);
+MingHeBuckConverter converter(&emulator, 1);
+MingHeTelemetry telemetry(&converter);
+
+uint32_t start_ms;
+bool stepped;
+
+void printTime(const MingHeTelemetryEvent &event) {
+  LOGGER.print(((event.ms - start_ms) * TIME_SCALE) / 1000);
+  LOGGER.print(F("s: "));
+}
+
+void printLimitingFactor(const uint8_t limiting_factor) {
+  switch (limiting_factor) {
+    case MINGHE_LIMITING_FACTOR_VOLTAGE:
+      LOGGER.print(F("CV"));
+      break;
+    case MINGHE_LIMITING_FACTOR_CURRENT:
+      LOGGER.print(F("CC"));
+      break;
+    default:
+      LOGGER.print(F("off"));
+      break;
+  }
+}
+
+void onLimitingFactor(const MingHeTelemetryEvent &event) {
+  printTime(event);
+  printLimitingFactor(event.from);
+  LOGGER.print(F(" -> "));
+  printLimitingFactor(event.to);
+  LOGGER.println();
+}
+
+void onOutputState(const MingHeTelemetryEvent &event) {
+  printTime(event);
+  LOGGER.println(event.to ? F("output on") : F("output off"));
+}
+
+void onTemperature(const MingHeTelemetryEvent &event) {
+  printTime(event);
+  LOGGER.print(event.value);
+  LOGGER.print(F("C, "));
+  LOGGER.print(event.to ? F("over ") : F("back under "));
+  LOGGER.println((event.type == MINGHE_EVENT_FAN_TEMPERATURE) ?
+          F("fan start") : F("shutdown"));
+}
+
+void setup() {
+  LOGGER.begin(115200);
+
+  plant.setResistiveLoad(10000);
+  plant.setThermal(thermal);
+  plant.setTimeScale(TIME_SCALE);
+  emulator.setPlant(&plant);
+
+  converter.setMaxVoltage(1200);
+  converter.setMaxCurrent(50);
+
+  telemetry.setChannels(MINGHE_TELEMETRY_BIT(MINGHE_TELEMETRY_LIMITING_FACTOR) |
+          MINGHE_TELEMETRY_BIT(MINGHE_TELEMETRY_OUTPUT_STATE) |
+          MINGHE_TELEMETRY_BIT(MINGHE_TELEMETRY_TEMPERATURE));
+  telemetry.setInterval(50);
+  telemetry.setCallback(MINGHE_EVENT_LIMITING_FACTOR, onLimitingFactor);
+  telemetry.setCallback(MINGHE_EVENT_OUTPUT_STATE, onOutputState);
+  telemetry.setCallback(MINGHE_EVENT_FAN_TEMPERATURE, onTemperature);
+  telemetry.setCallback(MINGHE_EVENT_SHUTDOWN_TEMPERATURE, onTemperature);
+  if (!telemetry.loadTemperatureSetpoints()) {
+    LOGGER.println(F("Couldn't read the temperature setpoints"));
+  }
+
+  // Let telemetry see it off before it comes on.
+  while (!telemetry.hasSample(MINGHE_TELEMETRY_OUTPUT_STATE)) {
+    telemetry.poll();
+  }
+  converter.setOutputEnabled(true);
+  start_ms = millis();
+  stepped = false;
+}
+
+void loop() {
+  telemetry.poll();
+
+  if (!stepped && ((millis() - start_ms) >= STEP_MS)) {
+    stepped = true;
+    converter.setMaxCurrent(200);
+  }
+}
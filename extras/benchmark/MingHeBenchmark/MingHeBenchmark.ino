@@ -0,0 +1,242 @@
+/*
+ * Cycle counts for the driver's hot paths, on an ATmega328P.  Built by the
+ * Makefile in the directory above and run under simavr, with peer.c playing
+ * the converter on the other end of the UART - but it runs just as well on a
+ * real Uno with a converter on pins 0/1 (no USB serial monitor, then).
+ *
+ * Timer 1 runs at the CPU clock, with an overflow interrupt stretching it to
+ * 32 bits, so every figure is in CPU cycles, averaged over ITERATIONS runs.
+ * Interrupts stay on - timer 0 and the UART interrupts are part of the real
+ * cost.  Results come out one per line as "name cycles", for easy diffing.
+ */
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "MingHeBuckConverter.h"
+#include "MingHeChecksum.h"
+
+#define ITERATIONS 100
+
+// Values the loopback replies carry.
+#define REPLY_VALUE "12345"
+
+volatile uint16_t timer1_overflows;
+
+ISR(TIMER1_OVF_vect) {
+  timer1_overflows++;
+}
+
+// Timer 1 stretched to 32 bits.  An overflow that has happened but not been
+// counted yet shows up as the flag set with the count just wrapped.
+uint32_t cycles(void) {
+  uint8_t sreg = SREG;
+  uint16_t low, high;
+
+  cli();
+  low = TCNT1;
+  high = timer1_overflows;
+  if ((TIFR1 & _BV(TOV1)) && (low < 0x8000)) {
+    high++;
+  }
+  SREG = sreg;
+  return ((uint32_t)high << 16) | low;
+}
+
+/*
+ * A stream that answers instantly with a canned reply once the request's
+ * newline is written, and notes the cycle count at that point - so a
+ * transaction splits cleanly into encoding (up to the newline) and decoding
+ * (the rest), with no line time in either.
+ */
+class LoopbackStream : public Stream {
+public:
+  void setReply(const char *reply) {
+    reply_ = reply;
+    reply_length_ = strlen(reply);
+    position_ = 0;
+    armed_ = false;
+  }
+  uint32_t request_end_cycles;
+
+  virtual int available(void) { return armed_ ? reply_length_ - position_ : 0; }
+  virtual int read(void) {
+    return (armed_ && (position_ < reply_length_)) ? reply_[position_++] : -1;
+  }
+  virtual int peek(void) {
+    return (armed_ && (position_ < reply_length_)) ? reply_[position_] : -1;
+  }
+  virtual size_t write(uint8_t c) {
+    if (c == '\n') {
+      request_end_cycles = cycles();
+      position_ = 0;
+      armed_ = true;
+    }
+    return 1;
+  }
+  virtual void flush(void) {}
+  using Print::write;
+
+private:
+  const char *reply_;
+  uint8_t reply_length_, position_;
+  bool armed_;
+};
+
+LoopbackStream loopback;
+MingHeBuckConverter loopback_converter(&loopback, 1);
+MingHeBuckConverter uart_converter(&Serial, 1);
+
+char get_reply[20], set_reply[20];
+uint32_t overhead;
+
+// Build ":01" + body + LRC + CR LF.
+void buildReply(char *buffer, const char *body) {
+  MingHeBuckConverterChecksum checksum;
+  uint8_t length;
+
+  strcpy(buffer, ":01");
+  strcat(buffer, body);
+  checksum.addOutputString(buffer);
+  length = strlen(buffer);
+  buffer[length++] = checksum.getChecksumCharacter();
+  buffer[length++] = '\r';
+  buffer[length++] = '\n';
+  buffer[length] = 0;
+}
+
+void report(const __FlashStringHelper *name, const uint32_t total, 
+        const uint16_t per) {
+  Serial.print(name);
+  Serial.print(' ');
+  Serial.println(total / per);
+  Serial.flush();
+}
+
+void benchmarkChecksum(void) {
+  MingHeBuckConverterChecksum checksum;
+  volatile uint8_t counter = 0;
+  const char *p;
+  uint32_t start, subtract_total = 0, modulus_total = 0;
+  uint16_t chars = 0;
+
+  for (uint16_t i = 0; i < ITERATIONS; i++) {
+    start = cycles();
+    checksum.reset();
+    checksum.addOutputString(get_reply);
+    subtract_total += cycles() - start - overhead;
+
+    // The obvious way, for comparison.
+    start = cycles();
+    counter = 0;
+    for (p = get_reply; *p; p++) {
+      counter = (counter + *p) % 26;
+    }
+    modulus_total += cycles() - start - overhead;
+    chars += p - get_reply;
+  }
+  report(F("checksum_subtract_per_char"), subtract_total, chars);
+  report(F("checksum_modulus_per_char"), modulus_total, chars);
+}
+
+// The decoder converts digits as they arrive, so this is no longer on the
+// driver's path - it's kept as the yardstick the inline conversion replaced.
+void benchmarkConversion(void) {
+  volatile char digits[] = REPLY_VALUE;
+  volatile uint32_t value;
+  uint32_t start, total = 0;
+
+  for (uint16_t i = 0; i < ITERATIONS; i++) {
+    start = cycles();
+    value = atol((const char *)digits);
+    total += cycles() - start - overhead;
+  }
+  (void)value;
+  report(F("atol_5_digits"), total, ITERATIONS);
+}
+
+void benchmarkLoopback(void) {
+  uint32_t start, end, encode = 0, decode = 0;
+  uint16_t failures = 0;
+
+  loopback.setReply(get_reply);
+  for (uint16_t i = 0; i < ITERATIONS; i++) {
+    start = cycles();
+    if (!loopback_converter.getReading(MINGHE_COMMAND_VOLTAGE).ok()) {
+      failures++;
+    }
+    end = cycles();
+    encode += loopback.request_end_cycles - start - overhead;
+    decode += end - loopback.request_end_cycles - overhead;
+  }
+  report(F("get_frame_encode"), encode, ITERATIONS);
+  report(F("get_frame_decode"), decode, ITERATIONS);
+
+  loopback.setReply(set_reply);
+  encode = decode = 0;
+  for (uint16_t i = 0; i < ITERATIONS; i++) {
+    start = cycles();
+    if (!loopback_converter.setValue(MINGHE_COMMAND_MAX_VOLTAGE, 12345)) {
+      failures++;
+    }
+    end = cycles();
+    encode += loopback.request_end_cycles - start - overhead;
+    decode += end - loopback.request_end_cycles - overhead;
+  }
+  report(F("set_frame_encode"), encode, ITERATIONS);
+  report(F("set_frame_decode"), decode, ITERATIONS);
+  report(F("loopback_failures"), failures, 1);
+}
+
+// A whole transaction over the real UART, line time and all.  Needs the peer.
+void benchmarkUart(void) {
+  uint32_t start, total = 0;
+  uint16_t failures = 0;
+
+  for (uint16_t i = 0; i < ITERATIONS; i++) {
+    start = cycles();
+    if (!uart_converter.getReading(MINGHE_COMMAND_VOLTAGE).ok()) {
+      failures++;
+    }
+    total += cycles() - start - overhead;
+  }
+  report(F("uart_get_frame_115200"), total, ITERATIONS);
+  report(F("uart_failures"), failures, 1);
+}
+
+void setup() {
+  MingHeFrameGaps no_gaps = {{{0, 0}, {0, 0}}};
+  uint32_t start;
+
+  Serial.begin(115200);
+
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);
+  TIMSK1 = _BV(TOIE1);
+
+  // Cost of taking a reading, taken off everything else.
+  start = cycles();
+  overhead = cycles() - start;
+
+  buildReply(get_reply, "rv" REPLY_VALUE);
+  buildReply(set_reply, "ok");
+  loopback_converter.setFrameGaps(no_gaps);
+  uart_converter.setFrameGaps(no_gaps);
+  uart_converter.setRetryPolicy(1, 0, 100);
+
+  report(F("timer_overhead"), overhead, 1);
+  benchmarkChecksum();
+  benchmarkConversion();
+  benchmarkLoopback();
+  benchmarkUart();
+  Serial.println(F("done"));
+  Serial.flush();
+
+  // Interrupts off and asleep - simavr takes this as the end of the run.
+  cli();
+  sleep_enable();
+  sleep_cpu();
+}
+
+void loop() {
+}
@@ -0,0 +1,153 @@
+/*
+ * simavr harness for the MingHeBenchmark firmware.  Loads the ELF into a
+ * simulated ATmega328P at 16MHz and sits on the other end of UART 0 as a
+ * MingHe converter at address 01: requests are answered (reads with the
+ * last value set, 12345 to start with), and any other line the firmware
+ * prints is passed through to stdout.
+ *
+ * usage: peer firmware.elf
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_irq.h"
+#include "avr_uart.h"
+
+// Give up on a run that goes on longer than this (a minute of AVR time).
+#define MAX_CYCLES (16000000ULL * 60)
+
+static avr_t *avr;
+static avr_irq_t *uart_input;
+
+static char line[80];
+static int line_length;
+static unsigned long registers[128];
+
+// Sum of the characters, modulo 26, as a letter - the protocol's LRC.
+static char lrc(const char *frame) {
+  unsigned sum = 0;
+
+  while (*frame) {
+    sum += (unsigned char)*frame++;
+  }
+  return 'A' + (sum % 26);
+}
+
+static void sendFrame(const char *address, const char *body) {
+  char frame[40];
+  size_t length;
+
+  snprintf(frame, sizeof(frame) - 3, ":%.2s%s", address, body);
+  length = strlen(frame);
+  frame[length++] = lrc(frame);
+  frame[length++] = '\r';
+  frame[length++] = '\n';
+  frame[length] = 0;
+  for (size_t i = 0; i < length; i++) {
+    avr_raise_irq(uart_input, (uint8_t)frame[i]);
+  }
+}
+
+// line holds ":AArC[digits]L" - address, r or s, command, value, LRC.
+static void handleRequest(void) {
+  char body[24];
+  unsigned char command;
+  char received_lrc;
+
+  if (line_length < 6) {
+    return;
+  }
+  received_lrc = line[line_length - 1];
+  line[line_length - 1] = 0;
+  if (lrc(line) != received_lrc) {
+    return;
+  }
+  command = (unsigned char)line[4] & 0x7F;
+  if (line[3] == 'r') {
+    snprintf(body, sizeof(body), "r%c%lu", command, registers[command]);
+  } else if (line[3] == 's') {
+    registers[command] = strtoul(line + 5, NULL, 10);
+    strcpy(body, "ok");
+  } else {
+    return;
+  }
+  sendFrame(line + 1, body);
+}
+
+static void uartOutput(struct avr_irq_t *irq, uint32_t value, void *param) {
+  char c = (char)value;
+
+  if (c == '\n') {
+    line[line_length] = 0;
+    if (line[0] == ':') {
+      handleRequest();
+    } else {
+      puts(line);
+      fflush(stdout);
+    }
+    line_length = 0;
+  } else if ((c != '\r') && (line_length < (int)sizeof(line) - 1)) {
+    line[line_length++] = c;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  elf_firmware_t firmware;
+  uint32_t flags = 0;
+  int state = cpu_Running;
+
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s firmware.elf\n", argv[0]);
+    return 2;
+  }
+
+  memset(&firmware, 0, sizeof(firmware));
+  if (elf_read_firmware(argv[1], &firmware)) {
+    fprintf(stderr, "Unable to load %s\n", argv[1]);
+    return 2;
+  }
+
+  avr = avr_make_mcu_by_name("atmega328p");
+  if (!avr) {
+    fprintf(stderr, "simavr has no atmega328p\n");
+    return 2;
+  }
+  avr_init(avr);
+  firmware.frequency = 16000000;
+  avr_load_firmware(avr, &firmware);
+
+  for (int i = 0; i < 128; i++) {
+    registers[i] = 12345;
+  }
+
+  // The UART is ours - don't let simavr echo it to the console as well.
+  avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+  flags &= ~AVR_UART_FLAG_STDIO;
+  avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+
+  uart_input = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+  avr_irq_register_notify(
+      avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT),
+      uartOutput, NULL);
+
+  while ((state != cpu_Done) && (state != cpu_Crashed)) {
+    state = avr_run(avr);
+    if (avr->cycle > MAX_CYCLES) {
+      fprintf(stderr, "Timed out\n");
+      return 1;
+    }
+  }
+  return (state == cpu_Crashed) ? 1 : 0;
+}
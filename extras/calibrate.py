@@ -0,0 +1,270 @@
+#!/usr/bin/env python3
+#
+# Fit calibration tables (see src/MingHeCalibration.h) from readings taken
+# against a reference meter, and write them out as C initializers to hand to
+# MingHeBuckConverter::setCalibration.  The tables are worked out exactly the
+# way MingHeCalibration::fromPoints does it, so what is reported here is what
+# the device will do.
+#
+# usage: extras/calibrate.py readings.csv --header calibration.h
+#            [--segments 1] [--name calibration]
+#
+# CSV has a header row with unit, channel, device and reference columns, and
+# a row per reading.  unit can be left out if there's only the one.  Values
+# are in volts and amps.
+#
+#   unit,channel,device,reference
+#   7,max_voltage,5.00,5.09
+#   7,max_voltage,50.00,50.93
+#   7,voltage,4.98,5.09
+#   7,voltage,50.12,50.93
+#
+# Channels:
+#   max_voltage, max_current   the limits: device is what it was set to,
+#                              reference what the output really did.
+#   voltage, current           the readings: device is what it read,
+#                              reference what the meter did.
+#
+# With --segments 1 (the default) each table is a least squares gain and
+# offset.  More segments fit a joined up line through that many pieces, with
+# the joins spread evenly through the readings - take a good few readings
+# across the range for that.
+#
+# Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+# of any sort.
+#
+# This is released as full open source, no license.  Do what you want with it.
+#
+# However, if you find it useful, tossing a few bucks in the tip jar on my blog
+# would be appreciated.
+
+import argparse
+import csv
+import re
+import sys
+
+# From MingHeCalibration.h.
+CALIBRATION_SEGMENTS = 4
+CALIBRATION_ONE = 32768
+CALIBRATION_SHIFT = 15
+
+CHANNELS = {
+    'max_voltage': 'MINGHE_COMMAND_MAX_VOLTAGE',
+    'max_current': 'MINGHE_COMMAND_MAX_CURRENT',
+    'voltage': 'MINGHE_COMMAND_VOLTAGE',
+    'current': 'MINGHE_COMMAND_CURRENT',
+}
+
+# Volts and amps to device counts.
+SCALE = 100
+
+
+class CalibrationError(Exception):
+    pass
+
+
+def parse_csv(path):
+    """Readings by (unit, channel), as (device, reference) counts."""
+    readings = {}
+    with open(path) as f:
+        for number, row in enumerate(csv.DictReader(f), 2):
+            where = '%s:%d' % (path, number)
+            unit = (row.get('unit') or '').strip()
+            name = (row.get('channel') or '').strip().lower()
+            if name not in CHANNELS:
+                raise CalibrationError('%s: unknown channel %r' %
+                                       (where, name))
+            try:
+                device = float(row['device']) * SCALE
+                reference = float(row['reference']) * SCALE
+            except (KeyError, TypeError, ValueError):
+                raise CalibrationError('%s: bad reading' % where)
+            readings.setdefault((unit, name), []).append((device, reference))
+    if not readings:
+        raise CalibrationError('%s: no readings' % path)
+    return readings
+
+
+def solve(matrix, vector):
+    """Gaussian elimination with partial pivoting.  None if singular."""
+    size = len(vector)
+    rows = [matrix[i][:] + [vector[i]] for i in range(size)]
+    for col in range(size):
+        pivot = max(range(col, size), key=lambda r: abs(rows[r][col]))
+        if abs(rows[pivot][col]) < 1e-12:
+            return None
+        rows[col], rows[pivot] = rows[pivot], rows[col]
+        for r in range(col + 1, size):
+            factor = rows[r][col] / rows[col][col]
+            for c in range(col, size + 1):
+                rows[r][c] -= factor * rows[col][c]
+    result = [0.0] * size
+    for r in reversed(range(size)):
+        total = rows[r][size] - sum(rows[r][c] * result[c]
+                                    for c in range(r + 1, size))
+        result[r] = total / rows[r][r]
+    return result
+
+
+def knots_for(readings, segments):
+    """segments + 1 device values, spread evenly through the readings."""
+    values = sorted(set(int(round(d)) for d, _ in readings))
+    if len(values) < segments + 1:
+        raise CalibrationError('%d different readings, %d needed' %
+                               (len(values), segments + 1))
+    last = len(values) - 1
+    return [values[(i * last + segments // 2) // segments]
+            for i in range(segments + 1)]
+
+
+def hat(knots, i, x):
+    """The weight knot i has at x, on a line joining the knots.  The end
+    pieces carry on past the first and last knot."""
+    piece = 0
+    while piece < len(knots) - 2 and x >= knots[piece + 1]:
+        piece += 1
+    left, right = knots[piece], knots[piece + 1]
+    t = (x - left) / float(right - left)
+    if i == piece:
+        return 1 - t
+    if i == piece + 1:
+        return t
+    return 0.0
+
+
+def fit(readings, segments):
+    """Least squares fit of the reference values at each knot."""
+    knots = knots_for(readings, segments)
+    size = len(knots)
+    matrix = [[0.0] * size for _ in range(size)]
+    vector = [0.0] * size
+    for device, reference in readings:
+        weights = [hat(knots, i, device) for i in range(size)]
+        for i in range(size):
+            vector[i] += weights[i] * reference
+            for j in range(size):
+                matrix[i][j] += weights[i] * weights[j]
+    actuals = solve(matrix, vector)
+    if actuals is None:
+        raise CalibrationError('not enough readings between the joins')
+    return [(knot, int(round(actual))) for knot, actual in
+            zip(knots, actuals)]
+
+
+def slope(rise, run):
+    """MingHeCalibration's fixed point slope, or None if it won't fit."""
+    scaled = (rise * CALIBRATION_ONE + run // 2) // run
+    return scaled if scaled <= 0xFFFF else None
+
+
+def from_points(points):
+    """MingHeCalibration::fromPoints: segments as (device, actual, gain,
+    inverse)."""
+    segments = []
+    for (device, actual), (next_device, next_actual) in zip(points,
+                                                             points[1:]):
+        if next_device > 0x7FFF or next_actual > 0x7FFF:
+            raise CalibrationError('values over 32767 counts')
+        run, rise = next_device - device, next_actual - actual
+        if run <= 0 or rise <= 0:
+            raise CalibrationError('the fit goes backwards - check the '
+                                   'readings')
+        gain, inverse = slope(rise, run), slope(run, rise)
+        if not gain or not inverse:
+            raise CalibrationError('slope %.3f is outside 0.5 to 2' %
+                                   (rise / float(run)))
+        segments.append((device, actual, gain, inverse))
+    return segments
+
+
+def convert(value, from_start, to_start, gain):
+    distance = max(-0x7FFF, min(0x7FFF, value - from_start))
+    result = to_start + ((distance * gain + CALIBRATION_ONE // 2) >>
+                         CALIBRATION_SHIFT)
+    return max(0, min(0xFFFF, result))
+
+
+def to_actual(segments, device):
+    i = len(segments) - 1
+    while i and device < segments[i][0]:
+        i -= 1
+    return convert(device, segments[i][0], segments[i][1], segments[i][2])
+
+
+def to_device(segments, actual):
+    i = len(segments) - 1
+    while i and actual < segments[i][1]:
+        i -= 1
+    return convert(actual, segments[i][1], segments[i][0], segments[i][3])
+
+
+def residual(segments, name, device, reference):
+    """How far off, in counts, the corrected value is for one reading."""
+    if name.startswith('max_'):
+        # The sketch asks for reference, and device should be sent for it.
+        return to_device(segments, int(round(reference))) - device
+    return to_actual(segments, int(round(device))) - reference
+
+
+def identifier(text):
+    text = re.sub(r'[^A-Za-z0-9_]', '_', text)
+    return text if not text[:1].isdigit() else 'unit_' + text
+
+
+def write_header(path, name, tables):
+    with open(path, 'w') as f:
+        f.write('// Fitted by extras/calibrate.py.  Hand each table to\n')
+        f.write('// setCalibration with the command in its comment.\n')
+        for unit, channel, segments in tables:
+            table = identifier('_'.join(part for part in
+                                        (name, unit, channel) if part))
+            f.write('\n// %s\n' % CHANNELS[channel])
+            f.write('const MingHeCalibration %s = {%d, {\n' %
+                    (table, len(segments)))
+            for segment in segments:
+                f.write('  {%d, %d, %d, %d},\n' % segment)
+            f.write('}};\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Fit calibration tables for MingHeBuckConverter.')
+    parser.add_argument('readings', help='CSV of readings')
+    parser.add_argument('--header', help='C header with the tables')
+    parser.add_argument('--name', default='calibration',
+                        help='prefix for the table names')
+    parser.add_argument('--segments', type=int, default=1,
+                        help='straight pieces per table, 1 to %d (1)' %
+                        CALIBRATION_SEGMENTS)
+    args = parser.parse_args()
+
+    if not 1 <= args.segments <= CALIBRATION_SEGMENTS:
+        sys.stderr.write('error: --segments is 1 to %d\n' %
+                         CALIBRATION_SEGMENTS)
+        return 1
+
+    tables = []
+    try:
+        readings = parse_csv(args.readings)
+        for (unit, channel), points in sorted(readings.items()):
+            where = '%s%s' % (unit + ' ' if unit else '', channel)
+            try:
+                segments = from_points(fit(points, args.segments))
+            except CalibrationError as e:
+                raise CalibrationError('%s: %s' % (where, e))
+            worst = max(abs(residual(segments, channel, d, r))
+                        for d, r in points)
+            sys.stderr.write('%-24s %3d readings, worst %.1f counts after '
+                             'correction\n' % (where, len(points), worst))
+            tables.append((unit, channel, segments))
+    except (CalibrationError, IOError) as e:
+        sys.stderr.write('error: %s\n' % e)
+        return 1
+
+    if args.header:
+        write_header(args.header, args.name, tables)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,497 @@
+#!/usr/bin/env python3
+#
+# Compile a load profile written as CSV or JSON into the step format that
+# MingHeSequencePlayer plays (see src/MingHeSequence.h), checking it against
+# the converter model's limits and dropping writes that do nothing.  Writes
+# the binary file readSequence loads, and/or a PROGMEM table to paste into a
+# sketch, and reports the frames it costs and how long it should take at the
+# given baud rate.
+#
+# usage: extras/sequence_compiler.py profile.csv -o profile.bin
+#            [--header profile.h --name profile] [--model 6015]
+#            [--baud 9600] [--protocol ascii|modbus]
+#
+# CSV has a header row with delay, action, channel, value and option columns,
+# and a row per step.  delay is seconds after the step before was due.
+#
+#   delay,action,channel,value,option
+#   0,set,current,2.00,
+#   0,set,voltage,5.00,
+#   0,set,output,on,
+#   0,repeat,,3,
+#   0.5,set,voltage,6.00,
+#   0.5,set,voltage,5.00,
+#   0.5,end,,,
+#   0,wait_below,current,0.50,2
+#   0.5,set,output,off,
+#
+# Actions:
+#   set          channel to value.  Channels are voltage and current (in volts
+#                and amps - the limits), output (on/off), shutdown_temperature
+#                and fan_temperature (C), or raw:<command letter> for anything
+#                else, in device counts.
+#   wait_above,  read channel until it's at or above, at or below, or equal to
+#   wait_below,  value, giving up after option seconds (none if blank).  Here
+#   wait_equal   voltage and current are the measured values, and there's
+#                also temperature (C), limiting (off/cv/cc) and raw:<letter>.
+#   pause        nothing - just the delay.
+#   repeat       run the rows up to the matching end value times, 0 for ever.
+#   end          end of a repeat.  Its delay comes before going round again.
+#
+# JSON is a list of objects with the same keys, except that a repeat is
+# {"repeat": 3, "steps": [...], "end_delay": 0.5}.
+#
+# Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+# of any sort.
+#
+# This is released as full open source, no license.  Do what you want with it.
+#
+# However, if you find it useful, tossing a few bucks in the tip jar on my blog
+# would be appreciated.
+
+import argparse
+import copy
+import csv
+import json
+import struct
+import sys
+
+# From MingHeSequence.h.
+SEQ_END = 0
+SEQ_SET = 1
+SEQ_PAUSE = 2
+SEQ_WAIT_ABOVE = 3
+SEQ_WAIT_BELOW = 4
+SEQ_WAIT_EQUAL = 5
+SEQ_LOOP = 6
+MAX_LOOPS = 4
+SEQUENCE_VERSION = 1
+MAX_WORD = 0xFFFF
+
+WAIT_OPS = {
+    'wait_above': SEQ_WAIT_ABOVE,
+    'wait_below': SEQ_WAIT_BELOW,
+    'wait_equal': SEQ_WAIT_EQUAL,
+}
+OP_NAMES = {
+    SEQ_END: 'END', SEQ_SET: 'SET', SEQ_PAUSE: 'PAUSE',
+    SEQ_WAIT_ABOVE: 'WAIT_ABOVE', SEQ_WAIT_BELOW: 'WAIT_BELOW',
+    SEQ_WAIT_EQUAL: 'WAIT_EQUAL', SEQ_LOOP: 'LOOP',
+}
+
+# Channel: command letter, and counts per unit.
+SET_CHANNELS = {
+    'voltage': ('u', 100),
+    'current': ('i', 100),
+    'output': ('o', 1),
+    'shutdown_temperature': ('e', 1),
+    'fan_temperature': ('f', 1),
+}
+READ_CHANNELS = {
+    'voltage': ('v', 100),
+    'current': ('j', 100),
+    'output': ('o', 1),
+    'temperature': ('p', 1),
+    'limiting': ('c', 1),
+}
+WORDS = {'on': 1, 'off': 0, 'true': 1, 'false': 0, 'cv': 1, 'cc': 2}
+
+# Models that don't follow from their number - as in MingHeBuckConverter.cpp.
+MODEL_PROFILES = {4015: (4500, 1500), 6015: (6000, 1500)}
+MIN_TEMPERATURE = 20
+MAX_TEMPERATURE = 120
+
+# Default frame gap (MINGHE_POST_READ_DELAY_MS).
+FRAME_GAP_MS = 5
+
+
+class ProfileError(Exception):
+    pass
+
+
+def model_limits(model):
+    """Max voltage and current in counts, the way findModelProfile does."""
+    if model in MODEL_PROFILES:
+        return MODEL_PROFILES[model]
+    if model < 100 or model > 9999 or not model % 100:
+        raise ProfileError('model %d makes no sense' % model)
+    return (model // 100) * 100, (model % 100) * 100
+
+
+def parse_seconds(text, where):
+    if text in (None, ''):
+        return 0
+    try:
+        seconds = float(text)
+    except ValueError:
+        raise ProfileError('%s: bad time %r' % (where, text))
+    if seconds < 0:
+        raise ProfileError('%s: negative time' % where)
+    return int(round(seconds * 1000))
+
+
+def parse_value(text, scale, where):
+    text = str(text).strip().lower()
+    if text in WORDS:
+        return WORDS[text]
+    try:
+        value = int(round(float(text) * scale))
+    except ValueError:
+        raise ProfileError('%s: bad value %r' % (where, text))
+    if value < 0 or value > MAX_WORD:
+        raise ProfileError('%s: value %r out of range' % (where, text))
+    return value
+
+
+def channel(name, table, where):
+    name = (name or '').strip().lower()
+    if name.startswith('raw:') and len(name) == 5 and name[4].isalpha():
+        return name[4], 1
+    if name not in table:
+        raise ProfileError('%s: unknown channel %r' % (where, name))
+    return table[name]
+
+
+class Step(object):
+    def __init__(self, where, delay_ms, op, command='\0', value=0, extra=0):
+        self.where = where
+        self.delay_ms = delay_ms
+        self.op = op
+        self.command = command
+        self.value = value
+        self.extra = extra
+
+
+class Repeat(object):
+    def __init__(self, where, delay_ms, count, body, end_delay_ms):
+        self.where = where
+        self.delay_ms = delay_ms
+        self.count = count
+        self.body = body
+        self.end_delay_ms = end_delay_ms
+
+
+def make_step(row, where):
+    action = (row.get('action') or '').strip().lower()
+    delay_ms = parse_seconds(row.get('delay'), where)
+
+    if action == 'set':
+        command, scale = channel(row.get('channel'), SET_CHANNELS, where)
+        return Step(where, delay_ms, SEQ_SET, command,
+                    parse_value(row.get('value'), scale, where))
+    if action in WAIT_OPS:
+        command, scale = channel(row.get('channel'), READ_CHANNELS, where)
+        timeout_ms = parse_seconds(row.get('option'), where)
+        # Tenths of a second, rounded up so a timeout is never cut short.
+        timeout = (timeout_ms + 99) // 100
+        if timeout > MAX_WORD:
+            raise ProfileError('%s: timeout too long' % where)
+        return Step(where, delay_ms, WAIT_OPS[action], command,
+                    parse_value(row.get('value'), scale, where), timeout)
+    if action == 'pause':
+        return Step(where, delay_ms, SEQ_PAUSE)
+    raise ProfileError('%s: unknown action %r' % (where, action))
+
+
+def parse_csv(path):
+    """Rows into a tree of steps and repeats."""
+    stack = [[]]
+    repeats = []
+    with open(path, newline='') as f:
+        reader = csv.DictReader(f)
+        for line, row in enumerate(reader, 2):
+            where = '%s:%d' % (path, line)
+            row = dict((k.strip().lower(), v) for k, v in row.items() if k)
+            action = (row.get('action') or '').strip().lower()
+            if not action or action.startswith('#'):
+                continue
+            if action == 'repeat':
+                count = parse_value(row.get('value'), 1, where)
+                repeats.append((where, parse_seconds(row.get('delay'), where),
+                                count))
+                stack.append([])
+            elif action == 'end':
+                if not repeats:
+                    raise ProfileError('%s: end without repeat' % where)
+                start_where, delay_ms, count = repeats.pop()
+                body = stack.pop()
+                stack[-1].append(Repeat(start_where, delay_ms, count, body,
+                                        parse_seconds(row.get('delay'),
+                                                      where)))
+            else:
+                stack[-1].append(make_step(row, where))
+    if repeats:
+        raise ProfileError('%s: repeat without end' % repeats[-1][0])
+    return stack[0]
+
+
+def parse_json_list(items, path):
+    nodes = []
+    for i, item in enumerate(items):
+        where = '%s: item %d' % (path, i)
+        if not isinstance(item, dict):
+            raise ProfileError('%s: not an object' % where)
+        if 'repeat' in item:
+            nodes.append(Repeat(
+                where, parse_seconds(item.get('delay'), where),
+                parse_value(item['repeat'], 1, where),
+                parse_json_list(item.get('steps', []), path),
+                parse_seconds(item.get('end_delay'), where)))
+        else:
+            row = dict((k, '' if v is None else str(v))
+                       for k, v in item.items())
+            nodes.append(make_step(row, where))
+    return nodes
+
+
+def parse_json(path):
+    with open(path) as f:
+        try:
+            items = json.load(f)
+        except ValueError as e:
+            raise ProfileError('%s: %s' % (path, e))
+    if not isinstance(items, list):
+        raise ProfileError('%s: expected a list of steps' % path)
+    return parse_json_list(items, path)
+
+
+def check_limits(nodes, max_voltage, max_current, depth=0):
+    """The range checks checkRequest makes, so nothing gets refused on the
+    device halfway through a run."""
+    for node in nodes:
+        if isinstance(node, Repeat):
+            if node.count:
+                depth_here = depth + 1
+                if depth_here > MAX_LOOPS:
+                    raise ProfileError('%s: repeats nested deeper than %d' %
+                                       (node.where, MAX_LOOPS))
+            else:
+                depth_here = depth
+            check_limits(node.body, max_voltage, max_current, depth_here)
+            continue
+        if node.op != SEQ_SET:
+            continue
+        high = {'u': max_voltage, 'i': max_current, 'o': 1, 'g': 1, 's': 1,
+                'x': 1, 'm': 9, 'n': 9, 'b': 7}.get(node.command)
+        low = 0
+        if node.command in 'ef':
+            low, high = MIN_TEMPERATURE, MAX_TEMPERATURE
+        elif node.command == 'd':
+            low, high = 1, 99
+        if high is not None and not low <= node.value <= high:
+            raise ProfileError('%s: %s %d is outside %d-%d for this model' %
+                               (node.where, node.command, node.value, low,
+                                high))
+
+
+def optimize(nodes, known=None):
+    """
+    Drop what makes no difference on the device: pauses (their time goes to
+    the next step), a write straight away overwritten by another to the same
+    command, and writes of the value already set.  The output is never taken
+    as known - the unit switches it off itself on over temperature.  What is
+    known doesn't carry into or out of a repeat, since it's different each
+    time round.  Returns the new list and the delay left over at the end.
+    """
+    known = dict(known or {})
+    out = []
+    carry = 0
+
+    for node in nodes:
+        if isinstance(node, Repeat):
+            node.delay_ms += carry
+            carry = 0
+            node.body, tail = optimize(node.body)
+            node.end_delay_ms += tail
+            out.append(node)
+            known = {}
+            continue
+
+        node.delay_ms += carry
+        carry = 0
+        if node.op == SEQ_PAUSE:
+            carry = node.delay_ms
+            continue
+        if node.op != SEQ_SET:
+            out.append(node)
+            continue
+        if node.command != 'o' and known.get(node.command) == node.value:
+            carry = node.delay_ms
+            continue
+        last = out[-1] if out else None
+        if (isinstance(last, Step) and last.op == SEQ_SET and
+                last.command == node.command and node.delay_ms == 0):
+            node.delay_ms = last.delay_ms
+            out.pop()
+        known[node.command] = node.value
+        out.append(node)
+    return out, carry
+
+
+def emit(nodes, steps):
+    """Flatten the tree into player steps, splitting long delays."""
+    def delay_steps(delay_ms):
+        # Whatever won't fit in one step's delay goes into pauses ahead of it.
+        while delay_ms > MAX_WORD:
+            steps.append(Step('', MAX_WORD, SEQ_PAUSE))
+            delay_ms -= MAX_WORD
+        return delay_ms
+
+    for node in nodes:
+        if isinstance(node, Repeat):
+            lead = delay_steps(node.delay_ms)
+            if lead:
+                steps.append(Step(node.where, lead, SEQ_PAUSE))
+            start = len(steps)
+            emit(node.body, steps)
+            if len(steps) > MAX_WORD:
+                raise ProfileError('too many steps')
+            steps.append(Step(node.where, delay_steps(node.end_delay_ms),
+                              SEQ_LOOP, '\0', start, node.count))
+        else:
+            node.delay_ms = delay_steps(node.delay_ms)
+            steps.append(node)
+
+
+def frame_ms(step, baud, protocol, turnaround_ms):
+    """How long a step's transaction holds the line: request and reply at 10
+    bits a character, the device's turnaround and the frame gap."""
+    if protocol == 'modbus':
+        # Write single register, echoed back, or read one register.
+        characters = 16 if step.op == SEQ_SET else 15
+    elif step.op == SEQ_SET:
+        # ":01su1200X\n", then ":01okX\r\n".
+        characters = 6 + len(str(step.value)) + 8
+    else:
+        # ":01rvX\n", then ":01rv1200X\r\n" - guess 4 digits.
+        characters = 6 + 12
+    return characters * 10000.0 / baud + turnaround_ms + FRAME_GAP_MS
+
+
+def estimate(steps, baud, protocol, turnaround_ms, limit=1000000):
+    """
+    Play the steps on paper the way the player does, with every wait met at
+    its first read.  Returns frames, run time, the most any step will start
+    late, the wait timeouts that could be added on top, and whether it runs
+    for ever (in which case the rest is for the first time round).
+    """
+    due = 0.0
+    line_free = 0.0
+    frames = 0
+    worst_late = 0.0
+    wait_ms = 0
+    loops = {}
+    index = 0
+    played = 0
+
+    while played < limit:
+        step = steps[index]
+        due += step.delay_ms
+        played += 1
+        if step.op == SEQ_END:
+            return frames, max(due, line_free), worst_late, wait_ms, False
+        if step.op == SEQ_PAUSE:
+            index += 1
+        elif step.op == SEQ_LOOP:
+            if not step.extra:
+                return frames, max(due, line_free), worst_late, wait_ms, True
+            left = loops.get(index, step.extra) - 1
+            if left:
+                loops[index] = left
+                index = step.value
+            else:
+                loops.pop(index, None)
+                index += 1
+        else:
+            start = max(due, line_free)
+            worst_late = max(worst_late, start - due)
+            line_free = start + frame_ms(step, baud, protocol, turnaround_ms)
+            frames += 1
+            if step.op != SEQ_SET:
+                # The schedule restarts from when the wait was met.
+                due = line_free
+                wait_ms += step.extra * 100
+            index += 1
+    raise ProfileError('too many steps to estimate - over %d' % limit)
+
+
+def write_binary(path, steps):
+    with open(path, 'wb') as f:
+        f.write(b'MHSQ' + struct.pack('<BH', SEQUENCE_VERSION, len(steps)))
+        for step in steps:
+            f.write(struct.pack('<HBBHH', step.delay_ms, step.op,
+                                ord(step.command), step.value, step.extra))
+
+
+def write_header(path, name, steps):
+    with open(path, 'w') as f:
+        f.write('// Compiled by extras/sequence_compiler.py.\n')
+        f.write('const MingHeSequenceStep PROGMEM %s[] = {\n' % name)
+        for step in steps:
+            command = ("'%s'" % step.command) if step.command != '\0' else '0'
+            f.write('  {%d, MINGHE_SEQ_%s, %s, %d, %d},\n' %
+                    (step.delay_ms, OP_NAMES[step.op], command, step.value,
+                     step.extra))
+        f.write('};\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Compile a load profile for MingHeSequencePlayer.')
+    parser.add_argument('profile', help='CSV or JSON profile')
+    parser.add_argument('-o', '--output', help='binary sequence file')
+    parser.add_argument('--header', help='C header with a PROGMEM table')
+    parser.add_argument('--name', default='profile',
+                        help='name of the table in the header')
+    parser.add_argument('--model', type=int, default=6015,
+                        help='converter model, for the limits (6015)')
+    parser.add_argument('--baud', type=int, default=9600)
+    parser.add_argument('--protocol', choices=('ascii', 'modbus'),
+                        default='ascii')
+    parser.add_argument('--turnaround-ms', type=float, default=0,
+                        help='time the device takes to answer (0)')
+    parser.add_argument('--no-optimize', action='store_true',
+                        help='keep every write as written')
+    args = parser.parse_args()
+
+    try:
+        if args.profile.lower().endswith('.json'):
+            nodes = parse_json(args.profile)
+        else:
+            nodes = parse_csv(args.profile)
+        max_voltage, max_current = model_limits(args.model)
+        check_limits(nodes, max_voltage, max_current)
+
+        written = []
+        emit(copy.deepcopy(nodes) + [Step('', 0, SEQ_END)], written)
+        tail = 0
+        if not args.no_optimize:
+            nodes, tail = optimize(nodes)
+        steps = []
+        emit(nodes + [Step('', tail, SEQ_END)], steps)
+
+        frames, run_ms, late_ms, wait_ms, forever = estimate(
+            steps, args.baud, args.protocol, args.turnaround_ms)
+    except (ProfileError, IOError) as e:
+        sys.stderr.write('error: %s\n' % e)
+        return 1
+
+    if args.output:
+        write_binary(args.output, steps)
+    if args.header:
+        write_header(args.header, args.name, steps)
+
+    sys.stderr.write('%d steps (%d bytes), %d as written\n' %
+                     (len(steps), 7 + 8 * len(steps), len(written)))
+    sys.stderr.write('%s: %d frames, %.1f s%s\n' %
+                     ('First time round' if forever else 'Run', frames,
+                      run_ms / 1000.0,
+                      (' plus up to %.1f s of waits' % (wait_ms / 1000.0))
+                      if wait_ms else ''))
+    sys.stderr.write('Worst step %.0f ms late at %d baud (%s)\n' %
+                     (late_ms, args.baud, args.protocol))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,47 @@
+#!/bin/sh
+#
+# Build a sketch with a few combinations of the MingHeConfig.h switches and
+# print the flash and RAM each one uses.  Needs arduino-cli with the board's
+# core installed, and this library where arduino-cli can find it.
+#
+# usage: extras/size_report.sh [sketch directory] [fqbn]
+#
+# Defaults to the MinimalControl example on an Uno.
+
+LIBRARY=$(cd "$(dirname "$0")/.." && pwd)
+SKETCH=${1:-$LIBRARY/examples/MinimalControl}
+FQBN=${2:-arduino:avr:uno}
+BUILD=$(mktemp -d)
+
+trap 'rm -rf "$BUILD"' EXIT
+
+OFF_EXTRAS="-DMINGHE_ENABLE_MEMORY=0 -DMINGHE_ENABLE_CONFIG_SETTERS=0 \
+-DMINGHE_ENABLE_SNAPSHOT=0 -DMINGHE_ENABLE_MODEL_PROFILES=0 \
+-DMINGHE_ENABLE_CALIBRATION=0"
+OFF_LINK="-DMINGHE_ENABLE_STATS=0 -DMINGHE_ENABLE_QUARANTINE=0 \
+-DMINGHE_ENABLE_RS485=0 -DMINGHE_ENABLE_LOW_POWER=0"
+
+# name|flags
+CONFIGS="everything|
+no memory, setters, snapshots, profiles or calibration|$OFF_EXTRAS
+no stats, quarantine, RS-485 or low power|$OFF_LINK
+minimal|$OFF_EXTRAS $OFF_LINK
+minimal, no response checksum|$OFF_EXTRAS $OFF_LINK -DMINGHE_ENABLE_RX_CHECKSUM=0"
+
+printf '%-55s %8s %8s\n' "Configuration" "Flash" "RAM"
+
+echo "$CONFIGS" | while IFS='|' read -r NAME FLAGS; do
+  OUTPUT=$(arduino-cli compile --fqbn "$FQBN" --build-path "$BUILD" \
+      --library "$LIBRARY" --clean \
+      --build-property "compiler.cpp.extra_flags=$FLAGS" "$SKETCH" 2>&1)
+  if [ $? -ne 0 ]; then
+    printf '%-55s %s\n' "$NAME" "build failed:"
+    echo "$OUTPUT" | grep -i error | head -5
+    continue
+  fi
+  # "Sketch uses 4060 bytes (12%) of program storage space..."
+  # "Global variables use 229 bytes (11%) of dynamic memory..."
+  FLASH=$(echo "$OUTPUT" | sed -n 's/^Sketch uses \([0-9]*\) bytes.*/\1/p')
+  RAM=$(echo "$OUTPUT" | sed -n 's/^Global variables use \([0-9]*\) bytes.*/\1/p')
+  printf '%-55s %8s %8s\n' "$NAME" "$FLASH" "$RAM"
+done
@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+#
+# Exact rolling statistics over a log of readings, for windows of any length.
+# MingHeWindowStats keeps a handful of buckets on the device, so its windows
+# move a quarter at a time; this keeps every reading in the window and moves
+# it a reading at a time, with the minimum and maximum kept in monotonic
+# queues so each reading costs the same however long the window is.
+#
+# usage: extras/window_stats.py log.csv --window 60 [--every 10]
+#            [--samples] [--channel voltage]
+#
+# The log has a line per reading - ms, channel, value - as the
+# TelemetryDashboard example prints them.  Lines starting with # are skipped.
+#
+#   1500,voltage,1200
+#   1500,current,251
+#
+# --window is in seconds, or readings with --samples.  Writes a CSV line per
+# channel every --every seconds of log (every reading if not given): ms,
+# channel, count, min, max, mean and stddev, in the log's units.
+#
+# Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+# of any sort.
+#
+# This is released as full open source, no license.  Do what you want with it.
+#
+# However, if you find it useful, tossing a few bucks in the tip jar on my blog
+# would be appreciated.
+
+import argparse
+import collections
+import csv
+import math
+import sys
+
+
+class Window(object):
+    """Readings inside the window, with running sums and monotonic queues of
+    (index, value) for the minimum and maximum."""
+
+    def __init__(self, length, by_samples):
+        self.length = length
+        self.by_samples = by_samples
+        self.readings = collections.deque()
+        self.lows = collections.deque()
+        self.highs = collections.deque()
+        self.index = 0
+        self.total = 0
+        self.squares = 0
+
+    def add(self, ms, value):
+        self.readings.append((self.index, ms, value))
+        self.total += value
+        self.squares += value * value
+        # Anything no lower than the new reading can never be the minimum
+        # again, and likewise for the maximum.
+        while self.lows and self.lows[-1][1] >= value:
+            self.lows.pop()
+        self.lows.append((self.index, value))
+        while self.highs and self.highs[-1][1] <= value:
+            self.highs.pop()
+        self.highs.append((self.index, value))
+        self.index += 1
+        self.expire(ms)
+
+    def expire(self, now_ms):
+        while self.readings and self.too_old(self.readings[0], now_ms):
+            index, _, value = self.readings.popleft()
+            self.total -= value
+            self.squares -= value * value
+            if self.lows[0][0] == index:
+                self.lows.popleft()
+            if self.highs[0][0] == index:
+                self.highs.popleft()
+
+    def too_old(self, reading, now_ms):
+        if self.by_samples:
+            return len(self.readings) > self.length
+        return now_ms - reading[1] >= self.length
+
+    def summary(self):
+        count = len(self.readings)
+        if not count:
+            return None
+        mean = self.total / float(count)
+        # Integer sums, so this is exact until the last divide.
+        variance = (self.squares * count - self.total * self.total) / \
+            float(count * count)
+        return (count, self.lows[0][1], self.highs[0][1], mean,
+                math.sqrt(max(variance, 0.0)))
+
+
+def read_log(path, channels):
+    with open(path) as f:
+        for number, row in enumerate(csv.reader(f), 1):
+            if not row or row[0].lstrip().startswith('#'):
+                continue
+            try:
+                ms, channel, value = int(row[0]), row[1].strip(), int(row[2])
+            except (IndexError, ValueError):
+                raise ValueError('%s:%d: expected ms,channel,value' %
+                                 (path, number))
+            if not channels or channel in channels:
+                yield ms, channel, value
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Exact rolling statistics over a log of readings.')
+    parser.add_argument('log', help='CSV of ms,channel,value')
+    parser.add_argument('--window', type=float, required=True,
+                        help='window length, in seconds (or readings)')
+    parser.add_argument('--samples', action='store_true',
+                        help='--window is a number of readings')
+    parser.add_argument('--every', type=float,
+                        help='seconds between summaries (every reading)')
+    parser.add_argument('--channel', action='append',
+                        help='only this channel (can be given again)')
+    args = parser.parse_args()
+
+    length = int(args.window) if args.samples else int(args.window * 1000)
+    if length <= 0:
+        sys.stderr.write('error: --window has to be more than 0\n')
+        return 1
+    every_ms = int(args.every * 1000) if args.every else 0
+
+    windows = collections.OrderedDict()
+    out = csv.writer(sys.stdout, lineterminator='\n')
+    out.writerow(['ms', 'channel', 'count', 'min', 'max', 'mean', 'stddev'])
+    next_ms = None
+
+    def write(ms, channel, window):
+        summary = window.summary()
+        if summary:
+            count, low, high, mean, stddev = summary
+            out.writerow([ms, channel, count, low, high,
+                          '%.2f' % mean, '%.2f' % stddev])
+
+    def report(ms):
+        for channel, window in windows.items():
+            window.expire(ms)
+            write(ms, channel, window)
+
+    try:
+        for ms, channel, value in read_log(args.log, args.channel):
+            if every_ms:
+                if next_ms is None:
+                    next_ms = ms + every_ms
+                while ms > next_ms:
+                    report(next_ms)
+                    next_ms += every_ms
+            if channel not in windows:
+                windows[channel] = Window(length, args.samples)
+            windows[channel].add(ms, value)
+            if not every_ms:
+                write(ms, channel, windows[channel])
+    except (ValueError, IOError) as e:
+        sys.stderr.write('error: %s\n' % e)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,587 @@
+/*
+ * Batch acceptance testing.  See MingHeAcceptance.h.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#include "MingHeAcceptance.h"
+
+// Step types.  A check reads a value and fails if it's outside low to high.
+// A save reads a setting into a slot, and a restore writes it back - if the
+// save worked.
+#define STEP_SET 0
+#define STEP_CHECK 1
+#define STEP_SAVE 2
+#define STEP_RESTORE 3
+#define STEP_WAIT 4
+
+// Slots for the settings the temperature and switch suites put back.  The
+// switches take three, from SLOT_SWITCHES.
+#define SLOT_SHUTDOWN_TEMPERATURE 0
+#define SLOT_FAN_TEMPERATURE 1
+#define SLOT_SWITCHES 2
+
+// With the output off, anything under 0.10V and 0.10A is nothing.
+#define OUTPUT_OFF_LIMIT 10
+
+// The switches tested by the misc suite, in slot order.
+const static char PROGMEM misc_commands[3] = {
+  MINGHE_COMMAND_BEEPER_ENABLED,
+  MINGHE_COMMAND_BOOT_OUTPUT_ENABLED,
+  MINGHE_COMMAND_FAST_VOLTAGE_CHANGE,
+};
+
+MingHeAcceptance::MingHeAcceptance() {
+  MingHeAcceptancePlan plan = {6000, 100, 1500, 100, 1000, 100, 500, true, 70,
+      65535, 9};
+
+  plan_ = plan;
+  suites_ = MINGHE_ALL_SUITES;
+  port_count_ = unit_count_ = 0;
+  running_ = false;
+  remaining_ = 0;
+  start_ms_ = elapsed_ms_ = 0;
+}
+
+bool MingHeAcceptance::addBus(MingHeBus *bus) {
+  Port *port;
+
+  if (port_count_ >= MINGHE_ACCEPTANCE_MAX_PORTS) {
+    return false;
+  }
+  port = &ports_[port_count_];
+  port->first = unit_count_;
+  port->count = 0;
+  for (uint8_t i = 0; i < bus->getUnitCount(); i++) {
+    if (unit_count_ >= MINGHE_ACCEPTANCE_MAX_UNITS) {
+      port_count_++;
+      return false;
+    }
+    units_[unit_count_].converter = bus->getUnit(i);
+    results_[unit_count_].port = port_count_;
+    results_[unit_count_].address = bus->getUnit(i)->getDeviceId();
+    unit_count_++;
+    port->count++;
+  }
+  port_count_++;
+  return true;
+}
+
+/*
+ * The suites, a step at a time, worked out from the plan and the step number
+ * so nothing but the number needs keeping.  Each follows its test function in
+ * the example sketch.
+ */
+bool MingHeAcceptance::getStep(const Unit &unit, const uint8_t suite,
+        const uint16_t index, Step *step) const {
+  uint16_t max_voltage = plan_.max_voltage, max_current = plan_.max_current;
+  uint16_t value_step, count;
+  uint8_t which;
+
+#if MINGHE_ENABLE_MODEL_PROFILES
+  const MingHeModelProfile *profile = unit.converter->getModelProfile();
+
+  if (profile) {
+    if (max_voltage > profile->max_voltage) {
+      max_voltage = profile->max_voltage;
+    }
+    if (max_current > profile->max_current) {
+      max_current = profile->max_current;
+    }
+  }
+#else
+  (void)unit;
+#endif
+
+  // A check that takes any value, unless filled in otherwise.
+  step->type = STEP_CHECK;
+  step->command = 0;
+  step->value = step->low = 0;
+  step->high = 0xFFFFFFFFUL;
+  step->slot = 0;
+
+  switch (suite) {
+    // Set each value in turn and read it back.
+    case MINGHE_SUITE_VOLTAGE:
+    case MINGHE_SUITE_CURRENT:
+      if (suite == MINGHE_SUITE_VOLTAGE) {
+        step->command = MINGHE_COMMAND_MAX_VOLTAGE;
+        value_step = plan_.voltage_step ? plan_.voltage_step : 1;
+        count = max_voltage / value_step + 1;
+      } else {
+        step->command = MINGHE_COMMAND_MAX_CURRENT;
+        value_step = plan_.current_step ? plan_.current_step : 1;
+        count = max_current / value_step + 1;
+      }
+      if (index >= count * 2) {
+        return false;
+      }
+      step->value = step->low = step->high = (index / 2) * value_step;
+      if (!(index & 1)) {
+        step->type = STEP_SET;
+      }
+      return true;
+
+    // Safe limits, output off and quiet, then on and regulating, then off.
+    case MINGHE_SUITE_OUTPUT:
+      switch (index) {
+        case 0:
+          step->type = STEP_SET;
+          step->command = MINGHE_COMMAND_MAX_VOLTAGE;
+          step->value = plan_.output_voltage;
+          return true;
+        case 1:
+          step->type = STEP_SET;
+          step->command = MINGHE_COMMAND_MAX_CURRENT;
+          step->value = plan_.output_current;
+          return true;
+        case 2:
+        case 10:
+          step->type = STEP_SET;
+          step->command = MINGHE_COMMAND_OUTPUT_STATE;
+          return true;
+        case 3:
+          step->command = MINGHE_COMMAND_VOLTAGE;
+          step->high = OUTPUT_OFF_LIMIT;
+          return true;
+        case 4:
+          step->command = MINGHE_COMMAND_CURRENT;
+          step->high = OUTPUT_OFF_LIMIT;
+          return true;
+        case 5:
+          step->command = MINGHE_COMMAND_LIMITING_FACTOR;
+          step->high = MINGHE_LIMITING_FACTOR_OFF;
+          return true;
+        case 6:
+          step->type = STEP_SET;
+          step->command = MINGHE_COMMAND_OUTPUT_STATE;
+          step->value = 1;
+          return true;
+        case 7:
+          step->type = STEP_WAIT;
+          step->value = plan_.settle_ms;
+          return true;
+        case 8:
+          step->command = MINGHE_COMMAND_VOLTAGE;
+          step->low = OUTPUT_OFF_LIMIT;
+          return true;
+        case 9:
+          step->command = MINGHE_COMMAND_LIMITING_FACTOR;
+          step->low = step->high = plan_.load_attached ?
+              MINGHE_LIMITING_FACTOR_CURRENT : MINGHE_LIMITING_FACTOR_VOLTAGE;
+          return true;
+      }
+      return false;
+
+    // The temperature has to read.  Then, for the shutdown limit and the fan
+    // one in turn: save, set to the test value, check, put back.
+    case MINGHE_SUITE_TEMPERATURE:
+      if (!index) {
+        step->command = MINGHE_COMMAND_TEMPERATURE;
+        return true;
+      }
+      if (index > 8) {
+        return false;
+      }
+      if (index & 1) {
+        step->command = MINGHE_COMMAND_SHUTDOWN_TEMPERATURE;
+        step->slot = SLOT_SHUTDOWN_TEMPERATURE;
+      } else {
+        step->command = MINGHE_COMMAND_FAN_TEMPERATURE;
+        step->slot = SLOT_FAN_TEMPERATURE;
+      }
+      step->value = step->low = step->high = plan_.test_temperature;
+      switch ((index - 1) / 2) {
+        case 0: step->type = STEP_SAVE; break;
+        case 1: step->type = STEP_SET; break;
+        case 3: step->type = STEP_RESTORE; break;
+      }
+      return true;
+
+    // All three switches: save, set off, check, set on, check, put back.
+    case MINGHE_SUITE_MISC:
+      if (index >= 18) {
+        return false;
+      }
+      which = index % 3;
+      step->command = pgm_read_byte(&misc_commands[which]);
+      step->slot = SLOT_SWITCHES + which;
+      switch (index / 3) {
+        case 0: step->type = STEP_SAVE; break;
+        case 1: step->type = STEP_SET; break;
+        case 2: step->high = 0; break;
+        case 3: step->type = STEP_SET; step->value = 1; break;
+        case 4: step->low = step->high = 1; break;
+        case 5: step->type = STEP_RESTORE; break;
+      }
+      return true;
+
+    // Both counters set, then read back.  They keep running with the output
+    // on, so allow what the driver's own verify does.
+    case MINGHE_SUITE_SETTABLES:
+      if (index >= 4) {
+        return false;
+      }
+      if (index & 1) {
+        step->command = MINGHE_COMMAND_RUNTIME;
+        step->high = (uint32_t)plan_.settable_value + SECOND_TOLERANCE;
+      } else {
+        step->command = MINGHE_COMMAND_MAMP_HOURS;
+        step->high = (uint32_t)plan_.settable_value + MAMP_HOUR_TOLERANCE;
+      }
+      step->value = step->low = plan_.settable_value;
+      if (index < 2) {
+        step->type = STEP_SET;
+      }
+      return true;
+
+    // Store the full limits, zero them, and load them back.
+    case MINGHE_SUITE_MEMORY:
+      switch (index) {
+        case 0:
+        case 6:
+          step->command = MINGHE_COMMAND_MAX_VOLTAGE;
+          step->value = step->low = step->high = max_voltage;
+          break;
+        case 1:
+        case 7:
+          step->command = MINGHE_COMMAND_MAX_CURRENT;
+          step->value = step->low = step->high = max_current;
+          break;
+        case 2:
+          step->command = MINGHE_COMMAND_STORE_TO_MEMORY;
+          step->value = plan_.memory_slot;
+          break;
+        case 3:
+          step->command = MINGHE_COMMAND_MAX_VOLTAGE;
+          break;
+        case 4:
+          step->command = MINGHE_COMMAND_MAX_CURRENT;
+          break;
+        case 5:
+          step->command = MINGHE_COMMAND_LOAD_FROM_MEMORY;
+          step->value = plan_.memory_slot;
+          break;
+        default:
+          return false;
+      }
+      if (index < 6) {
+        step->type = STEP_SET;
+      }
+      return true;
+  }
+  return false;
+}
+
+void MingHeAcceptance::begin(void) {
+  for (uint8_t i = 0; i < unit_count_; i++) {
+    units_[i].suite = 0;
+    units_[i].step = 0;
+    units_[i].waiting = false;
+    units_[i].saved_valid = 0;
+    results_[i].passed = results_[i].failed = 0;
+    results_[i].failed_suite = MINGHE_SUITE_COUNT;
+    results_[i].failed_step = 0;
+    results_[i].failed_status = MINGHE_STATUS_OK;
+    results_[i].transactions = 0;
+    results_[i].elapsed_ms = 0;
+  }
+  // Each port starts with its first unit.
+  for (uint8_t i = 0; i < port_count_; i++) {
+    ports_[i].active = -1;
+    ports_[i].cursor = ports_[i].count ? ports_[i].count - 1 : 0;
+  }
+  remaining_ = unit_count_;
+  running_ = (unit_count_ > 0);
+  start_ms_ = millis();
+  elapsed_ms_ = 0;
+}
+
+uint32_t MingHeAcceptance::getElapsedMs() const {
+  return running_ ? millis() - start_ms_ : elapsed_ms_;
+}
+
+void MingHeAcceptance::finishUnit(const uint8_t index) {
+  results_[index].elapsed_ms = millis() - start_ms_;
+  if (!--remaining_) {
+    elapsed_ms_ = millis() - start_ms_;
+    running_ = false;
+  }
+}
+
+void MingHeAcceptance::failStep(const uint8_t index, const uint8_t status) {
+  MingHeAcceptanceResult &result = results_[index];
+  const Unit &unit = units_[index];
+
+  result.failed |= MINGHE_SUITE_BIT(unit.suite);
+  if (result.failed_suite == MINGHE_SUITE_COUNT) {
+    result.failed_suite = unit.suite;
+    result.failed_step = unit.step;
+    result.failed_status = status;
+  }
+}
+
+/*
+ * Skip over suites not asked for, waits that are over and restores with
+ * nothing to put back, closing off each suite as its steps run out.
+ */
+bool MingHeAcceptance::prepare(const uint8_t index) {
+  Unit &unit = units_[index];
+  MingHeAcceptanceResult &result = results_[index];
+  uint8_t bit;
+  Step step;
+
+  while (unit.suite < MINGHE_SUITE_COUNT) {
+    bit = MINGHE_SUITE_BIT(unit.suite);
+    if (!(suites_ & bit) || !getStep(unit, unit.suite, unit.step, &step)) {
+      if ((suites_ & bit) && !(result.failed & bit)) {
+        result.passed |= bit;
+      }
+      unit.step = 0;
+      if (++unit.suite == MINGHE_SUITE_COUNT) {
+        finishUnit(index);
+      }
+      continue;
+    }
+
+    if (step.type == STEP_WAIT) {
+      if (!unit.waiting) {
+        unit.waiting = true;
+        unit.wait_start_ms = millis();
+      }
+      if ((millis() - unit.wait_start_ms) < step.value) {
+        return false;
+      }
+      unit.waiting = false;
+      unit.step++;
+      continue;
+    }
+    if ((step.type == STEP_RESTORE) &&
+            !(unit.saved_valid & (1 << step.slot))) {
+      unit.step++;
+      continue;
+    }
+    return true;
+  }
+  return false;
+}
+
+bool MingHeAcceptance::startStep(const uint8_t index) {
+  Unit &unit = units_[index];
+  MingHeBuckConverter *converter = unit.converter;
+  bool started;
+  Step step;
+
+  getStep(unit, unit.suite, unit.step, &step);
+  switch (step.type) {
+    case STEP_SET:
+      started = converter->beginSet(step.command, step.value);
+      break;
+    case STEP_RESTORE:
+      started = converter->beginSet(step.command, unit.saved[step.slot]);
+      break;
+    default:
+      started = converter->beginGet(step.command);
+      break;
+  }
+  if (!started) {
+    failStep(index, converter->isBusy() ? MINGHE_STATUS_PENDING :
+        converter->getLastStatus());
+    unit.step++;
+    return false;
+  }
+  results_[index].transactions++;
+  return true;
+}
+
+void MingHeAcceptance::finishStep(const uint8_t index, const uint8_t status) {
+  Unit &unit = units_[index];
+  MingHeReading reading = unit.converter->getAsyncReading();
+  Step step;
+
+  getStep(unit, unit.suite, unit.step, &step);
+  if (status != MINGHE_STATUS_OK) {
+    failStep(index, status);
+  } else if (step.type == STEP_SAVE) {
+    unit.saved[step.slot] = reading.value;
+    unit.saved_valid |= (1 << step.slot);
+  } else if ((step.type == STEP_CHECK) &&
+          ((reading.value < step.low) || (reading.value > step.high))) {
+    failStep(index, MINGHE_STATUS_OK);
+  }
+  unit.step++;
+}
+
+// Round-robin from the unit after the last to have the line.  A unit whose
+// step can't even be started moves straight on to its next one.
+void MingHeAcceptance::schedulePort(Port &port) {
+  uint8_t index;
+
+  for (uint8_t i = 0; i < port.count; i++) {
+    port.cursor++;
+    if (port.cursor >= port.count) {
+      port.cursor = 0;
+    }
+    index = port.first + port.cursor;
+    while (prepare(index)) {
+      if (startStep(index)) {
+        port.active = index;
+        return;
+      }
+    }
+  }
+}
+
+bool MingHeAcceptance::poll(void) {
+  uint8_t status;
+
+  if (!running_) {
+    return false;
+  }
+  for (uint8_t i = 0; i < port_count_; i++) {
+    Port &port = ports_[i];
+
+    if (port.active >= 0) {
+      status = units_[port.active].converter->poll();
+      if (status == MINGHE_STATUS_PENDING) {
+        continue;
+      }
+      finishStep(port.active, status);
+      port.active = -1;
+    }
+    schedulePort(port);
+  }
+  return running_;
+}
+
+void MingHeAcceptance::run(void) {
+  begin();
+  while (poll()) {
+  }
+}
+
+uint8_t MingHeAcceptance::getSuiteResult(const uint8_t index,
+        const uint8_t suite) const {
+  if (results_[index].failed & MINGHE_SUITE_BIT(suite)) {
+    return MINGHE_SUITE_FAILED;
+  }
+  if (results_[index].passed & MINGHE_SUITE_BIT(suite)) {
+    return MINGHE_SUITE_PASSED;
+  }
+  return MINGHE_SUITE_NOT_RUN;
+}
+
+bool MingHeAcceptance::unitPassed(const uint8_t index) const {
+  return !results_[index].failed &&
+      ((results_[index].passed & suites_) == suites_);
+}
+
+const __FlashStringHelper *MingHeAcceptance::getSuiteName(
+        const uint8_t suite) {
+  switch (suite) {
+    case MINGHE_SUITE_VOLTAGE: return F("voltage");
+    case MINGHE_SUITE_CURRENT: return F("current");
+    case MINGHE_SUITE_OUTPUT: return F("output");
+    case MINGHE_SUITE_TEMPERATURE: return F("temperature");
+    case MINGHE_SUITE_MISC: return F("misc");
+    case MINGHE_SUITE_SETTABLES: return F("settables");
+    case MINGHE_SUITE_MEMORY: return F("memory");
+  }
+  return F("none");
+}
+
+void MingHeAcceptance::printResult(Print &out, const uint8_t index,
+        const uint8_t suite) const {
+  switch (getSuiteResult(index, suite)) {
+    case MINGHE_SUITE_PASSED: out.print(F("pass")); break;
+    case MINGHE_SUITE_FAILED: out.print(F("fail")); break;
+  }
+}
+
+// suite:step:status, or nothing.
+void MingHeAcceptance::printFailure(Print &out,
+        const MingHeAcceptanceResult &result) {
+  if (result.failed_suite >= MINGHE_SUITE_COUNT) {
+    return;
+  }
+  out.print(getSuiteName(result.failed_suite));
+  out.print(':');
+  out.print(result.failed_step);
+  out.print(':');
+  out.print(result.failed_status);
+}
+
+void MingHeAcceptance::printCsv(Print &out) const {
+  out.print(F("port,address"));
+  for (uint8_t suite = 0; suite < MINGHE_SUITE_COUNT; suite++) {
+    out.print(',');
+    out.print(getSuiteName(suite));
+  }
+  out.println(F(",result,first_failure,transactions,ms"));
+
+  for (uint8_t i = 0; i < unit_count_; i++) {
+    out.print(results_[i].port);
+    out.print(',');
+    out.print(results_[i].address);
+    for (uint8_t suite = 0; suite < MINGHE_SUITE_COUNT; suite++) {
+      out.print(',');
+      printResult(out, i, suite);
+    }
+    out.print(',');
+    out.print(unitPassed(i) ? F("pass") : F("fail"));
+    out.print(',');
+    printFailure(out, results_[i]);
+    out.print(',');
+    out.print(results_[i].transactions);
+    out.print(',');
+    out.println(results_[i].elapsed_ms);
+  }
+}
+
+void MingHeAcceptance::printJson(Print &out) const {
+  out.println('[');
+  for (uint8_t i = 0; i < unit_count_; i++) {
+    out.print(F("  {\"port\": "));
+    out.print(results_[i].port);
+    out.print(F(", \"address\": "));
+    out.print(results_[i].address);
+    out.print(F(", \"suites\": {"));
+    for (uint8_t suite = 0; suite < MINGHE_SUITE_COUNT; suite++) {
+      if (suite) {
+        out.print(F(", "));
+      }
+      out.print('"');
+      out.print(getSuiteName(suite));
+      out.print(F("\": "));
+      if (getSuiteResult(i, suite) == MINGHE_SUITE_NOT_RUN) {
+        out.print(F("null"));
+      } else {
+        out.print('"');
+        printResult(out, i, suite);
+        out.print('"');
+      }
+    }
+    out.print(F("}, \"result\": \""));
+    out.print(unitPassed(i) ? F("pass") : F("fail"));
+    out.print(F("\", \"first_failure\": "));
+    if (results_[i].failed_suite < MINGHE_SUITE_COUNT) {
+      out.print('"');
+      printFailure(out, results_[i]);
+      out.print('"');
+    } else {
+      out.print(F("null"));
+    }
+    out.print(F(", \"transactions\": "));
+    out.print(results_[i].transactions);
+    out.print(F(", \"ms\": "));
+    out.print(results_[i].elapsed_ms);
+    out.println((i + 1 < unit_count_) ? F("},") : F("}"));
+  }
+  out.println(']');
+}
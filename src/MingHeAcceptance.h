@@ -0,0 +1,208 @@
+/*
+ * Incoming inspection for a batch of converters.  Runs the checks from the
+ * MingHeBuckConverter example sketch - voltage and current sweeps, output
+ * enable, temperature limits, the switches, the settable counters and a
+ * memory slot - against every unit on one or more buses at once, and reports
+ * a pass/fail matrix, one row per unit and one column per suite, as CSV or
+ * JSON.
+ *
+ * Each bus is a port: a MingHeBus with its units already added, on its own
+ * serial line.  Every port has a transaction on the go whenever any of its
+ * units has one to do, all on the non-blocking engine (beginGet, beginSet and
+ * poll), so the ports run side by side.  A line can only carry one frame at a
+ * time, so units sharing a port take turns, a step each - but a unit waiting
+ * on its output to settle leaves the line to the others.  Spread a batch over
+ * as many ports as there are to hand: a port per unit tests the lot in the
+ * time one takes.
+ *
+ * The runner drives the units it's given and nothing else may use them until
+ * it's done.  Settings the suites change are read first and put back after,
+ * as the example does - except the limits, which are left at what the last
+ * suite set them to, and the output, which is left off.  Each unit's run state
+ * and result take about 50 bytes of SRAM.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#ifndef __MING_HE_ACCEPTANCE_H__
+#define __MING_HE_ACCEPTANCE_H__
+
+#include "MingHeBuckConverter.h"
+#include "MingHeBus.h"
+
+// Ports, and units across all of them.
+#define MINGHE_ACCEPTANCE_MAX_PORTS 4
+#define MINGHE_ACCEPTANCE_MAX_UNITS 16
+
+// The suites, in the order they run.  A bit each in a suite mask.
+#define MINGHE_SUITE_VOLTAGE 0
+#define MINGHE_SUITE_CURRENT 1
+#define MINGHE_SUITE_OUTPUT 2
+#define MINGHE_SUITE_TEMPERATURE 3
+#define MINGHE_SUITE_MISC 4
+#define MINGHE_SUITE_SETTABLES 5
+#define MINGHE_SUITE_MEMORY 6
+#define MINGHE_SUITE_COUNT 7
+#define MINGHE_SUITE_BIT(suite) (1 << (suite))
+#define MINGHE_ALL_SUITES 0x7F
+
+// A suite's result for a unit.
+#define MINGHE_SUITE_NOT_RUN 0
+#define MINGHE_SUITE_PASSED 1
+#define MINGHE_SUITE_FAILED 2
+
+/**
+ * What the suites set and expect.  The defaults are the example sketch's: a
+ * 6015 swept to 60V and 15A in 100 count steps, 10V and 1A for the output
+ * test with a 1 ohm load attached, 70C for the temperature limits, 65535 in
+ * the counters and memory slot 9.
+ */
+struct MingHeAcceptancePlan {
+  // Sweeps, and the values stored to memory.  The sweeps stop short of the
+  // limits of a unit's model profile, if it has one.
+  uint16_t max_voltage, voltage_step;
+  uint16_t max_current, current_step;
+  // Limits for the output test, and how long the output gets to settle.
+  uint16_t output_voltage, output_current;
+  uint16_t settle_ms;
+  // With a load attached, the output should come up in CC.  Otherwise, CV.
+  bool load_attached;
+  uint8_t test_temperature;
+  uint16_t settable_value;
+  uint8_t memory_slot;
+};
+
+// How a unit did.  Suites are MINGHE_SUITE_BIT masks.
+struct MingHeAcceptanceResult {
+  uint8_t port;
+  uint8_t address;
+  uint8_t passed, failed;
+  // The first step to fail, and why: suite, step number within it, and the
+  // transaction status (MINGHE_STATUS_OK if it went through but the value
+  // was wrong).  The suite is MINGHE_SUITE_COUNT if nothing failed.
+  uint8_t failed_suite;
+  uint16_t failed_step;
+  uint8_t failed_status;
+  // Transactions made, and time from the start of the batch until the unit
+  // finished.
+  uint16_t transactions;
+  uint32_t elapsed_ms;
+};
+
+class MingHeAcceptance {
+public:
+  MingHeAcceptance();
+
+  /**
+   * Add a bus as a port, with the units on it now.  Returns false if there
+   * are too many ports or units - units past the limit are left out.
+   */
+  bool addBus(MingHeBus *bus);
+
+  void setPlan(const MingHeAcceptancePlan &plan) { plan_ = plan; }
+  const MingHeAcceptancePlan &getPlan() const { return plan_; }
+  // Which suites to run (MINGHE_SUITE_BIT mask).  All of them by default.
+  void setSuites(const uint8_t suites) { suites_ = suites; }
+
+  /**
+   * Start a batch, clearing the last one's results.  Then call poll from
+   * loop() until it returns false, or call run to do the lot and return
+   * when it's done.
+   */
+  void begin(void);
+  bool poll(void);
+  void run(void);
+
+  bool isRunning() const { return running_; }
+  // Time the batch took, or has taken so far.
+  uint32_t getElapsedMs() const;
+
+  uint8_t getUnitCount() const { return unit_count_; }
+  const MingHeAcceptanceResult &getResult(const uint8_t index) const {
+    return results_[index];
+  }
+  // MINGHE_SUITE_NOT_RUN, _PASSED or _FAILED.
+  uint8_t getSuiteResult(const uint8_t index, const uint8_t suite) const;
+  // True if every suite asked for passed.
+  bool unitPassed(const uint8_t index) const;
+
+  /**
+   * The matrix.  CSV has a header row, then a row per unit: port, address,
+   * a column per suite (pass, fail or blank if not run), the overall result,
+   * the first failure as suite:step:status, transactions and milliseconds.
+   * JSON is an array with an object per unit, carrying the same.
+   */
+  void printCsv(Print &out) const;
+  void printJson(Print &out) const;
+
+  static const __FlashStringHelper *getSuiteName(const uint8_t suite);
+
+private:
+  // A step of a suite, and a unit's progress through them - see
+  // MingHeAcceptance.cpp.
+  struct Step {
+    uint8_t type;
+    char command;
+    uint32_t value;
+    uint32_t low, high;
+    uint8_t slot;
+  };
+
+  struct Unit {
+    MingHeBuckConverter *converter;
+    uint8_t suite;
+    uint16_t step;
+    bool waiting;
+    uint32_t wait_start_ms;
+    // Settings read at the start of a suite, to put back at the end.
+    uint32_t saved[5];
+    uint8_t saved_valid;
+  };
+
+  struct Port {
+    uint8_t first, count;
+    // The unit with a transaction on the line (or -1), and the last to have
+    // one.
+    int8_t active;
+    uint8_t cursor;
+  };
+
+  // Fill in a step of a suite for a unit.  False past the end of the suite.
+  bool getStep(const Unit &unit, const uint8_t suite, const uint16_t index,
+          Step *step) const;
+  // Move a unit to its next step that needs the line.  False if it's waiting
+  // or done.
+  bool prepare(const uint8_t index);
+  // Put the step on the line.  False if it couldn't be started.
+  bool startStep(const uint8_t index);
+  void finishStep(const uint8_t index, const uint8_t status);
+  void failStep(const uint8_t index, const uint8_t status);
+  void finishUnit(const uint8_t index);
+  // Find a unit on the port with a step to start, and start it.
+  void schedulePort(Port &port);
+
+  static void printFailure(Print &out, const MingHeAcceptanceResult &result);
+  void printResult(Print &out, const uint8_t index, const uint8_t suite)
+          const;
+
+  MingHeAcceptancePlan plan_;
+  uint8_t suites_;
+
+  Port ports_[MINGHE_ACCEPTANCE_MAX_PORTS];
+  uint8_t port_count_;
+  Unit units_[MINGHE_ACCEPTANCE_MAX_UNITS];
+  MingHeAcceptanceResult results_[MINGHE_ACCEPTANCE_MAX_UNITS];
+  uint8_t unit_count_;
+
+  bool running_;
+  uint8_t remaining_;
+  uint32_t start_ms_, elapsed_ms_;
+};
+
+#endif // __MING_HE_ACCEPTANCE_H__
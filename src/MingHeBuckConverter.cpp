@@ -13,12 +13,101 @@
 
 #include "MingHeBuckConverter.h"
 
+#if defined(__AVR__) && MINGHE_ENABLE_LOW_POWER
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#endif
+
 // Can't fit this in uint16s.  But at least it's in progmem.
 const static uint32_t PROGMEM minghe_baud_index_table[8] = 
   {9600, 19200, 38400, 57600, 115200, 1200, 2400, 4800};
 
-const char PROGMEM response_ok[] = "ok";
-const char PROGMEM response_err[] = "err";
+/*
+ * Commands that don't fit the defaults.  Storing to and loading from memory
+ * write the device's EEPROM, and so does an address change, so they get longer
+ * to answer and some quiet time afterwards.  The baud rate command is only ever
+ * sent once (see setBaudRate).
+ */
+const static MingHeCommandTiming PROGMEM minghe_command_timing_table[] = {
+#if MINGHE_ENABLE_MEMORY
+  {MINGHE_COMMAND_STORE_TO_MEMORY, 1000, 50, 0, 3000},
+  {MINGHE_COMMAND_LOAD_FROM_MEMORY, 1000, 50, 0, 3000},
+#endif
+#if MINGHE_ENABLE_CONFIG_SETTERS
+  {MINGHE_COMMAND_ADDRESS, 1000, 50, 0, 3000},
+#endif
+  {MINGHE_COMMAND_BAUD_RATE, MINGHE_DEFAULT_RESPONSE_TIMEOUT_MS, 0, 1, 0},
+};
+
+#define RW_SETTING (MINGHE_CMD_READ | MINGHE_CMD_WRITE | MINGHE_CMD_VERIFY | \
+        MINGHE_CMD_SETTING)
+#define RW_SWITCH (RW_SETTING | MINGHE_CMD_BOOL)
+#define RW_COUNTER (MINGHE_CMD_READ | MINGHE_CMD_WRITE | MINGHE_CMD_CLIMBS)
+
+/*
+ * Everything the device understands.  Snapshots hold the readable values in
+ * this order, and settings are applied in this order - keep the limits ahead
+ * of the output state.
+ */
+constexpr static MingHeCommandDescriptor PROGMEM minghe_command_table[] = {
+  {MINGHE_COMMAND_MACHINE_MODEL, MINGHE_CMD_READ, 2, 0},
+  {MINGHE_COMMAND_COMMUNICATION_VERSION, MINGHE_CMD_READ, 2, 0},
+  {MINGHE_COMMAND_MAX_VOLTAGE, RW_SETTING, 2, 0},
+  {MINGHE_COMMAND_MAX_CURRENT, RW_SETTING, 2, 0},
+  {MINGHE_COMMAND_SHUTDOWN_TEMPERATURE, RW_SETTING, 2, 0},
+  {MINGHE_COMMAND_FAN_TEMPERATURE, RW_SETTING, 2, 0},
+  {MINGHE_COMMAND_FAST_VOLTAGE_CHANGE, RW_SWITCH, 1, 0},
+  {MINGHE_COMMAND_BOOT_OUTPUT_ENABLED, RW_SWITCH, 1, 0},
+  {MINGHE_COMMAND_BEEPER_ENABLED, RW_SWITCH, 1, 0},
+  {MINGHE_COMMAND_OUTPUT_STATE, RW_SWITCH, 1, 0},
+  {MINGHE_COMMAND_VOLTAGE, MINGHE_CMD_READ, 2, 0},
+  {MINGHE_COMMAND_CURRENT, MINGHE_CMD_READ, 2, 0},
+  {MINGHE_COMMAND_LIMITING_FACTOR, MINGHE_CMD_READ, 1, 0},
+  {MINGHE_COMMAND_WATTS, MINGHE_CMD_READ, 4, 0},
+  {MINGHE_COMMAND_TEMPERATURE, MINGHE_CMD_READ, 2, 0},
+  {MINGHE_COMMAND_MAMP_HOURS, RW_COUNTER, 4, MAMP_HOUR_TOLERANCE},
+  {MINGHE_COMMAND_RUNTIME, RW_COUNTER, 4, SECOND_TOLERANCE},
+  {MINGHE_COMMAND_BAUD_RATE, MINGHE_CMD_WRITE, 1, 0},
+#if MINGHE_ENABLE_CONFIG_SETTERS
+  {MINGHE_COMMAND_ADDRESS, MINGHE_CMD_WRITE, 1, 0},
+#endif
+#if MINGHE_ENABLE_MEMORY
+  {MINGHE_COMMAND_STORE_TO_MEMORY, MINGHE_CMD_WRITE, 1, 0},
+  {MINGHE_COMMAND_LOAD_FROM_MEMORY, MINGHE_CMD_WRITE, 1, 0},
+#endif
+};
+
+#define MINGHE_COMMAND_COUNT \
+  (sizeof(minghe_command_table) / sizeof(MingHeCommandDescriptor))
+
+// Add up the snapshot space at compile time, to check the header's figure.
+constexpr uint8_t snapshotBytes(const uint8_t index) {
+  return (index >= MINGHE_COMMAND_COUNT) ? 0 : 
+      (((minghe_command_table[index].flags & MINGHE_CMD_READ) ? 
+      minghe_command_table[index].width : 0) + snapshotBytes(index + 1));
+}
+
+static_assert(snapshotBytes(0) == MINGHE_SNAPSHOT_BYTES, 
+        "MINGHE_SNAPSHOT_BYTES does not match the command table");
+static_assert(MINGHE_COMMAND_COUNT <= 32, 
+        "Snapshot valid bits only cover 32 commands");
+
+#if MINGHE_ENABLE_MODEL_PROFILES
+// Temperature settings the protocol document gives, in degrees C.
+#define MODEL_MIN_TEMPERATURE 20
+#define MODEL_MAX_TEMPERATURE 120
+
+/*
+ * Models that don't follow from their number.  The protocol document gives the
+ * 4015 a voltage range up to 45.00V.  The 6015 is here as the common case.
+ */
+const static MingHeModelProfile PROGMEM minghe_model_profiles[] = {
+  {4015, 4500, 1500, 1, 1, MODEL_MIN_TEMPERATURE, MODEL_MAX_TEMPERATURE,
+      MINGHE_ALL_COMMANDS},
+  {6015, 6000, 1500, 1, 1, MODEL_MIN_TEMPERATURE, MODEL_MAX_TEMPERATURE,
+      MINGHE_ALL_COMMANDS},
+};
+#endif
 
 MingHeBuckConverter::MingHeBuckConverter(const uint8_t tx_pin, 
         const uint8_t rx_pin, const uint8_t device_id, 
@@ -27,15 +116,85 @@ MingHeBuckConverter::MingHeBuckConverter(const uint8_t tx_pin,
 
   swserial_ = new SoftwareSerial(rx_pin, tx_pin);
 
-  baud_rate = pgm_read_word_near(minghe_baud_index_table + start_baud_index);
+  baud_rate = baudRateFromIndex(start_baud_index);
 
   swserial_->begin(baud_rate);
+  stream_ = swserial_;
+  baud_index_ = start_baud_index;
 
   device_id_ = device_id;
+  init();
+}
+
+MingHeBuckConverter::MingHeBuckConverter(Stream *stream, 
+        const uint8_t device_id, const uint8_t start_baud_index) {
+  swserial_ = NULL;
+  stream_ = stream;
+  baud_index_ = start_baud_index;
+  device_id_ = device_id;
+  init();
+}
+
+// Look up the baud rate for a MINGHE_BAUD_ index.  The table entries are 32
+// bits wide - 115200 does not fit in a word read.
+uint32_t MingHeBuckConverter::baudRateFromIndex(const uint8_t baud_index) {
+  if (baud_index >= sizeof(minghe_baud_index_table) / sizeof(uint32_t)) {
+    return 0;
+  }
+  return pgm_read_dword_near(minghe_baud_index_table + baud_index);
+}
+
+// Setup shared by the constructors.
+void MingHeBuckConverter::init() {
+  setRetryPolicy(MINGHE_DEFAULT_ATTEMPTS, MINGHE_DEFAULT_BACKOFF_MS,
+          MINGHE_DEFAULT_DEADLINE_MS);
+  setQuarantinePolicy(MINGHE_DEFAULT_QUARANTINE_THRESHOLD,
+          MINGHE_DEFAULT_MIN_PROBE_MS, MINGHE_DEFAULT_MAX_PROBE_MS);
+#if MINGHE_ENABLE_STATS
+  resetStats();
+#endif
+  baud_rate_callback_ = NULL;
+#if MINGHE_ENABLE_RS485
+  driver_enable_pin_ = MINGHE_NO_PIN;
+  echo_suppression_ = false;
+  echo_length_ = 0;
+#endif
+#if MINGHE_ENABLE_LOW_POWER
+  low_power_wait_ = false;
+#endif
+  for (uint8_t from = 0; from < 2; from++) {
+    for (uint8_t to = 0; to < 2; to++) {
+      frame_gaps_.gap_us[from][to] = MINGHE_POST_READ_DELAY_MS * 1000U;
+    }
+  }
+  frame_gap_table_ = NULL;
+  setCommandTimingTable(minghe_command_timing_table, 
+          sizeof(minghe_command_timing_table) / sizeof(MingHeCommandTiming));
+  transaction_start_ms_ = millis();
+  response_timeout_ms_ = MINGHE_DEFAULT_RESPONSE_TIMEOUT_MS;
+  transaction_attempts_ = retry_policy_.attempts;
+  transaction_deadline_ms_ = retry_policy_.deadline_ms;
+  transaction_settle_ms_ = 0;
+  line_ = &own_line_;
+  markFrameEnd(REQUEST_GET);
+  last_status_ = MINGHE_STATUS_OK;
+  async_state_ = MINGHE_ASYNC_IDLE;
+  transmit_ms_ = 0;
+  protocol_ = &ascii_protocol_;
+#if MINGHE_ENABLE_MODEL_PROFILES
+  has_model_profile_ = false;
+  range_policy_ = MINGHE_RANGE_REJECT;
+#endif
+#if MINGHE_ENABLE_CALIBRATION
+  for (uint8_t i = 0; i < MINGHE_CALIBRATION_COMMANDS; i++) {
+    calibration_[i] = NULL;
+  }
+#endif
 }
 
 MingHeBuckConverter::~MingHeBuckConverter() {
-  free(swserial_);
+  // Only delete the SoftwareSerial if we created it.
+  delete swserial_;
 }
 
 void MingHeBuckConverter::resetDeviceId(const uint16_t device_id) {
@@ -44,485 +203,1027 @@ void MingHeBuckConverter::resetDeviceId(const uint16_t device_id) {
 
 void MingHeBuckConverter::resetBaudrate(const uint8_t new_baud_rate_flag) {
   uint32_t baud_rate;
-  baud_rate = pgm_read_word_near(minghe_baud_index_table + new_baud_rate_flag);
+
+  baud_rate = baudRateFromIndex(new_baud_rate_flag);
+  if (!baud_rate) {
+    return;
+  }
+  baud_index_ = new_baud_rate_flag;
+  loadFrameGapsForBaud();
+
+  // If the transport belongs to someone else, let them know.
+  if (!swserial_) {
+    if (baud_rate_callback_) {
+      baud_rate_callback_(baud_rate);
+    }
+    return;
+  }
 
   swserial_->begin(baud_rate);
 }
 
-void MingHeBuckConverter::sendSerialChar(const char c) {
-  checksum_.addOutputCharacter(c);
-  swserial_->write(c);
+void MingHeBuckConverter::setProtocol(MingHeProtocol *protocol) {
+  finishPending();
+  protocol_ = protocol ? protocol : &ascii_protocol_;
+}
+
+void MingHeBuckConverter::setFrameGaps(const MingHeFrameGaps &gaps) {
+  frame_gaps_ = gaps;
+}
+
+void MingHeBuckConverter::setFrameGapTable(const MingHeFrameGaps *table) {
+  frame_gap_table_ = table;
+  loadFrameGapsForBaud();
+}
+
+// Pick the current baud rate's row out of the PROGMEM gap table, if there is
+// one.
+void MingHeBuckConverter::loadFrameGapsForBaud(void) {
+  if (frame_gap_table_) {
+    memcpy_P(&frame_gaps_, frame_gap_table_ + baud_index_, 
+            sizeof(frame_gaps_));
+  }
 }
 
 /*
- * Send a request to the device.  This will either be a set, or a read.  If it's
- * a read, then value is going to be null (it's not sent).  If this is a set
- * command, use a null terminated character string in value and that will be
- * appended after the proper prefix and command.
+ * Note the end of a frame, so the gap before the next one can be timed.  If
+ * the device has more to send after the byte that ended the frame for us, the
+ * gap runs from after that.
  */
-void MingHeBuckConverter::sendRequest(const bool set, const char command, 
-        const char *value) {
-  char address[3];
-  const char *p;
-  
-  // Reset the checksum for this sequence.
-  checksum_.reset();
-
-  sendSerialChar(':');
-
-  itoa(device_id_, address, 10);
-
-  // Device ID is always 2 characters.
-  if (device_id_ < 10) {
-    sendSerialChar('0');
-    sendSerialChar(address[0]);
-  } else {
-    sendSerialChar(address[0]);
-    sendSerialChar(address[1]);
-  }
-
-  // If a set command, the command prefix is s, otherwise read with r.
-  sendSerialChar(set ? 's' : 'r');
-
-  sendSerialChar(command);
-
-  // Send the value string - if it's not null.
-  if (value) {
-    p = value;
-    while (*p) {
-      sendSerialChar(*p);
-      p++;
-    }
-  }
+void MingHeBuckConverter::markFrameEnd(const bool set,
+        const uint16_t trailer_us) {
+  line_->last_frame_end_us = micros();
+  line_->last_frame_trailer_us = trailer_us;
+  line_->last_frame_was_set = set;
+  settle_ms_ = transaction_settle_ms_;
+}
 
-  // Send the checksum - this is not included in value as it's dependent on the
-  // device ID.
-  swserial_->print(checksum_.getChecksumCharacter());
-  swserial_->print('\n');
+/*
+ * True once the required gap between the last frame and this one is over.
+ * Time spent by the caller between transactions counts, so a program that
+ * polls slowly never waits on it at all.
+ */
+bool MingHeBuckConverter::frameGapElapsed(const bool set) const {
+  uint32_t gap_us = frame_gaps_.gap_us[line_->last_frame_was_set][set] +
+          line_->last_frame_trailer_us + settle_ms_ * 1000UL;
+
+  return (micros() - line_->last_frame_end_us) >= gap_us;
 }
 
-// Either read a character from serial or return 0 if timeout happens.
-char MingHeBuckConverter::readCharUntilTimeout(const uint32_t timeout_ms) {
-  uint32_t start_millis = millis();
+void MingHeBuckConverter::setLineState(MingHeLineState *line) {
+  line_ = line ? line : &own_line_;
+}
 
-  while (!swserial_->available()) {
-    if ((millis() - start_millis) >= timeout_ms) {
-      return 0;
+void MingHeBuckConverter::setCommandTimingTable(
+        const MingHeCommandTiming *table, const uint8_t count) {
+  command_timing_table_ = table;
+  command_timing_count_ = table ? count : 0;
+}
+
+// Find the command in the timing table, or fill in the defaults.
+void MingHeBuckConverter::getCommandTiming(const char command, 
+        MingHeCommandTiming *timing) const {
+  for (uint8_t i = 0; i < command_timing_count_; i++) {
+    if ((char)pgm_read_byte_near(&command_timing_table_[i].command) == 
+            command) {
+      memcpy_P(timing, command_timing_table_ + i, sizeof(*timing));
+      return;
     }
   }
-  // Character is available - return it!
-  return swserial_->read();
+  timing->command = command;
+  timing->response_ms = MINGHE_DEFAULT_RESPONSE_TIMEOUT_MS;
+  timing->settle_ms = 0;
+  timing->attempts = 0;
+  timing->deadline_ms = 0;
 }
 
-// Swallow newlines (\n or \r) and return when the next entry in the buffer is
-// something else.  Or the timeout has happened.
-void MingHeBuckConverter::swallowNewlines(const uint32_t timeout_ms) {
-  uint32_t start_millis = millis();
+#if MINGHE_ENABLE_STATS
+void MingHeBuckConverter::resetStats(void) {
+  memset(&stats_, 0, sizeof(stats_));
+}
+#endif
+
+// Tally one attempt on the wire, by how it went.
+void MingHeBuckConverter::countAttempt(const uint8_t status) {
+#if MINGHE_ENABLE_STATS
+  stats_.attempts++;
+  switch (status) {
+    case MINGHE_STATUS_TIMEOUT: stats_.timeouts++; break;
+    case MINGHE_STATUS_CHECKSUM: stats_.checksum_errors++; break;
+    case MINGHE_STATUS_WRONG_DEVICE: stats_.wrong_device++; break;
+    case MINGHE_STATUS_BAD_RESPONSE: stats_.bad_responses++; break;
+    case MINGHE_STATUS_DEVICE_ERROR: stats_.device_errors++; break;
+  }
+#else
+  (void)status;
+#endif
+}
 
-  while (1) {
-    if (!swserial_->available()) {
-      delay(MINGHE_POST_READ_DELAY_MS);
-      return;
-    }
-    // Swallow CR or LF, terminate on any other character.
-    if (swserial_->peek() == '\r') {
-      swserial_->read();
-    } else if (swserial_->peek() == '\n') {
-      swserial_->read();
-    } else {
-      // Not a CR or LF, break out.
-      return;
-    }
+#if MINGHE_ENABLE_RS485
+void MingHeBuckConverter::setTransceiverPin(const uint8_t driver_enable_pin) {
+  driver_enable_pin_ = driver_enable_pin;
+  if (driver_enable_pin_ != MINGHE_NO_PIN) {
+    // Idle in receive.
+    digitalWrite(driver_enable_pin_, LOW);
+    pinMode(driver_enable_pin_, OUTPUT);
   }
 }
 
+void MingHeBuckConverter::setEchoSuppression(const bool enabled) {
+  echo_suppression_ = enabled;
+}
+#endif
+
 /*
- * Read the response, given the expected command.  The response will mirror the
- * command and then include the value, if it's a read command.  By this point,
- * the response has been read into the buffer and is validated (checksum match).
- * 
- * This verifies that the set/read character and the command character are
- * correct, then copies the value field (the numbers), ending when the checksum
- * character is found (uppercase, not a digit).
+ * Send a request to the device.  This will either be a set, or a read.  The
+ * protocol builds the frame, and it's handed to the stream in a single write.
+ * A HardwareSerial copies it into its transmit buffer and returns, and the
+ * data register empty interrupt sends it from there - the caller is free to
+ * get on with something else while it goes out.  A SoftwareSerial has no
+ * such buffer, and returns once the last stop bit is out.
  */
-bool MingHeBuckConverter::readResponse(const bool set, const char command, 
-        char *value) {
-  char response_buffer[16] = {0};
+void MingHeBuckConverter::sendRequest(const bool set, const char command,
+        const uint32_t value) {
+  uint8_t frame[MINGHE_MAX_REQUEST_LENGTH];
+  uint8_t length;
+  uint32_t baud_rate;
 
-  // If the read fails, return false.
-  if (!readResponseIntoBuffer(response_buffer, sizeof(response_buffer) - 1)) {
-    return false;
-  }
-  
-  // If we're here, it means the read succeeded, and the checksum is good.
+  length = protocol_->buildRequest(frame, device_id_, set, command, value);
 
-  // First char should be set/request.
-  if (response_buffer[0] != (set ? 's' : 'r')) {
-    //Serial.println(F("Wrong set/read value.  Failing."));
-    return false;
+#if MINGHE_ENABLE_RS485
+  // Note what the echo should look like: how long it is, how it starts, and
+  // what it adds up to.
+  echo_length_ = 0;
+  if (echo_suppression_) {
+    echo_checksum_.reset();
+    for (uint8_t i = 0; i < length; i++) {
+      echo_checksum_.addOutputCharacter(frame[i]);
+    }
+    echo_length_ = length;
+    echo_start_ = frame[0];
+    echo_received_ = 0;
+    echo_junk_ = 0;
   }
 
-  // Next is the command character.
-  if (response_buffer[1] != command) {
-    //Serial.println(F("Wrong command value.  Failing."));
-    return false;
+  // Take the bus.
+  if (driver_enable_pin_ != MINGHE_NO_PIN) {
+    digitalWrite(driver_enable_pin_, HIGH);
   }
-  
-  // Copy bytes into the array until a non-number is found.
-  for (byte i = 0; i < sizeof(response_buffer) - 2; i++) {
-    value[i] = response_buffer[i + 2];
-    if (!isdigit(value[i])) {
-      return true;
-    }
+#endif
+
+  stream_->write(frame, length);
+
+  /*
+   * The response timeout should run from the end of the request, not from
+   * when it was queued - at low baud rates, a buffered HardwareSerial takes a
+   * good while to send it.  Rather than wait here, allow for the time on the
+   * wire (10 bits a character) on top of the wait for the first byte back.
+   */
+  baud_rate = baudRateFromIndex(baud_index_);
+  transmit_ms_ = baud_rate ? (length * 10000UL) / baud_rate + 1 : 0;
+
+#if MINGHE_ENABLE_RS485
+  /*
+   * Letting go of the bus does have to wait for the stop bit of the last byte.
+   * For a HardwareSerial, flush() waits for the transmit complete flag, which
+   * is set at the end of the stop bit.  SoftwareSerial write() already returns
+   * after the stop bit, and its flush() does nothing.  No extra padding
+   * needed.
+   */
+  if (driver_enable_pin_ != MINGHE_NO_PIN) {
+    stream_->flush();
+    digitalWrite(driver_enable_pin_, LOW);
   }
-  
-  return true;
+#endif
 }
 
-// Returns true on ok response, false on err response or other error.
-bool MingHeBuckConverter::checkForOk() {
-  char response_buffer[16] = {0};
-
-  // If the read fails, return false.
-  if (!readResponseIntoBuffer(response_buffer, sizeof(response_buffer) - 1)) {
-    return false;
+#if MINGHE_ENABLE_RS485
+/*
+ * With the receiver left enabled while transmitting, every byte sent comes
+ * straight back.  Take as many bytes as were sent and check they add up to the
+ * same LRC - if not, something else was driving the bus at the same time, and
+ * whatever follows can't be trusted either.  Trailing bytes of the last
+ * response may still be ahead of the echo, so it starts at the first byte of
+ * the request.
+ */
+uint8_t MingHeBuckConverter::takeEcho(const uint8_t c) {
+  if (!echo_received_) {
+    if (c != echo_start_) {
+      if (++echo_junk_ >= MINGHE_MAX_JUNK_CHARACTERS) {
+        return MINGHE_STATUS_BAD_RESPONSE;
+      }
+      return MINGHE_STATUS_PENDING;
+    }
+    echo_received_checksum_.reset();
   }
-  
-  if (strcmp_P(response_buffer, response_ok) == 0) {
-    return true;
+  echo_received_checksum_.addOutputCharacter(c);
+  if (++echo_received_ < echo_length_) {
+    return MINGHE_STATUS_PENDING;
   }
-  
-  return false;
+
+  echo_length_ = 0;
+  if (echo_received_checksum_.getChecksumCharacter() != 
+          echo_checksum_.getChecksumCharacter()) {
+    return MINGHE_STATUS_BAD_RESPONSE;
+  }
+  return MINGHE_STATUS_PENDING;
 }
+#endif
+
+#if MINGHE_ENABLE_LOW_POWER
+void MingHeBuckConverter::setLowPowerWait(const bool enabled) {
+  low_power_wait_ = enabled;
+}
+#endif
 
 /*
- * Read the response from the device into a provided buffer.  This will strip
- * off the colon and device ID, then copy the two command bytes and the response
- * value into the buffer.  It does NOT null terminate - the calling code should
- * do that.
+ * Idle the CPU until the next interrupt, if low power waiting is on.  Idle mode
+ * keeps the clocks running, so the RX pin change interrupt (SoftwareSerial) or
+ * USART receive interrupt (HardwareSerial) wakes it for the start of a byte -
+ * and SoftwareSerial has the whole byte in its buffer by the time the ISR
+ * returns.  The timer 0 overflow behind millis() wakes it at least every
+ * 1.024ms, so no timeout is overshot by more than that.
+ *
+ * The available() check runs with interrupts off, and the instruction after
+ * sei() always runs before any pending interrupt, so a byte arriving between
+ * the check and the sleep wakes the CPU straight back up rather than being
+ * missed until the next timer tick.
  */
-bool MingHeBuckConverter::readResponseIntoBuffer(char *buffer, 
-        const byte buffer_length) {
-  uint8_t chars_read = 0, data_length = 0;
-  char c;
-  char device_id[3] = {0};
-
-  checksum_.reset();
-  // Read until we get a ':' that indicates the start of a response.
-  do {
-    c = readCharUntilTimeout(MINGHE_PER_CHARACTER_TIMEOUT_MS);
-    chars_read++;
-
-    // If enough junk characters are read, something is wrong, read has failed.
-    if (chars_read >= MINGHE_MAX_JUNK_CHARACTERS) {
-      //Serial.println(F("Too many junk characters found, failing."));
-      return false;
+void MingHeBuckConverter::idle(void) {
+#if defined(__AVR__) && MINGHE_ENABLE_LOW_POWER
+  if (!low_power_wait_) {
+    return;
+  }
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  cli();
+  if (!stream_->available()) {
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+  }
+  sei();
+#endif
+}
+
+// delay(), but sleeping between timer ticks if low power waiting is on.
+void MingHeBuckConverter::waitMs(const uint32_t wait_ms) {
+#if MINGHE_ENABLE_LOW_POWER
+  uint32_t start_millis;
+
+  if (low_power_wait_) {
+    start_millis = millis();
+    while ((millis() - start_millis) < wait_ms) {
+      idle();
     }
-  } while (c != ':');
+    return;
+  }
+#endif
+  delay(wait_ms);
+}
 
-  // Presumably, we have a ':' - start reading out data.
-  checksum_.addOutputCharacter(c);
+void MingHeBuckConverter::setRetryPolicy(const uint8_t attempts, 
+        const uint16_t backoff_ms, const uint16_t deadline_ms) {
+  // Always at least one try.  A deadline of 0 is none at all.
+  retry_policy_.attempts = attempts ? attempts : 1;
+  retry_policy_.backoff_ms = backoff_ms;
+  retry_policy_.deadline_ms = deadline_ms;
+}
 
-  // Next two bytes are the device ID.
-  device_id[0] = readCharUntilTimeout(MINGHE_PER_CHARACTER_TIMEOUT_MS);
-  checksum_.addOutputCharacter(device_id[0]);
-  device_id[1] = readCharUntilTimeout(MINGHE_PER_CHARACTER_TIMEOUT_MS);
-  checksum_.addOutputCharacter(device_id[1]);
+#if MINGHE_ENABLE_QUARANTINE
+void MingHeBuckConverter::setQuarantinePolicy(const uint8_t threshold, 
+        const uint32_t min_probe_ms, const uint32_t max_probe_ms) {
+  quarantine_threshold_ = threshold;
+  min_probe_ms_ = min_probe_ms;
+  max_probe_ms_ = max_probe_ms;
+  clearQuarantine();
+}
 
-  // If the device ID does not match, the read is not from this unit - fail.
-  if (atoi(device_id) != device_id_) {
-    return false;
-  }
+void MingHeBuckConverter::clearQuarantine() {
+  consecutive_failures_ = 0;
+  quarantined_ = false;
+  probe_interval_ms_ = min_probe_ms_;
+}
 
-  // Read into the buffer until an uppercase character is found.
-  for (data_length = 0; data_length < buffer_length; data_length++) {
-    c = readCharUntilTimeout(MINGHE_PER_CHARACTER_TIMEOUT_MS);
-    // Last character will be a capital and the checksum byte.
-    if (isupper(c)) {
-      // Checksum character: Check it and break.
-      if (c != checksum_.getChecksumCharacter()) {
-        return false;
-      }
-      // Checksum is fine, break out.
-      break;
-    }
+bool MingHeBuckConverter::isProbeDue() const {
+  return quarantined_ && 
+          ((millis() - quarantine_start_ms_) >= probe_interval_ms_);
+}
+#endif
 
-    // Populate the buffer.
-    buffer[data_length] = c;
-    checksum_.addOutputCharacter(c);
+/*
+ * Set up the timing for a transaction: the command's own, where the timing
+ * table has it, and the retry policy for the rest.
+ */
+bool MingHeBuckConverter::beginTransaction(const char command) {
+  MingHeCommandTiming timing;
+
+#if MINGHE_ENABLE_STATS
+  stats_.transactions++;
+#endif
+#if MINGHE_ENABLE_QUARANTINE
+  if (quarantined_ && !isProbeDue()) {
+#if MINGHE_ENABLE_STATS
+    stats_.quarantined++;
+#endif
+    last_status_ = MINGHE_STATUS_QUARANTINED;
+    return false;
   }
-  // End of buffer copy - swallow newline.
-  swallowNewlines(MINGHE_PER_CHARACTER_TIMEOUT_MS);
+#endif
+
+  getCommandTiming(command, &timing);
+  response_timeout_ms_ = timing.response_ms;
+  transaction_attempts_ = timing.attempts ? 
+          timing.attempts : retry_policy_.attempts;
+  transaction_deadline_ms_ = timing.deadline_ms ? 
+          timing.deadline_ms : retry_policy_.deadline_ms;
+  transaction_settle_ms_ = timing.settle_ms;
 
+  transaction_start_ms_ = millis();
   return true;
 }
 
-// Execute a get command on the device.   Return the value.
-uint32_t MingHeBuckConverter::executeGetCommand(const char command) {
-  char response[11] = {0};
-  sendRequest(REQUEST_GET, command, NULL);
+/*
+ * Track consecutive wire failures.  A device "err" still means the unit is
+ * alive and talking, so it counts as a success here.
+ */
+void MingHeBuckConverter::endTransaction(const uint8_t status) {
+  last_status_ = status;
 
-  // If the response fails, return 0.
-  if (!readResponse(REQUEST_GET, command, response)) {
-    return 0;
+#if MINGHE_ENABLE_QUARANTINE
+  if ((status == MINGHE_STATUS_OK) || (status == MINGHE_STATUS_DEVICE_ERROR)) {
+    clearQuarantine();
+    return;
   }
-  
-  // Convert the value to a uint32 and return it.
-  return (uint32_t) atol(response);
-}
 
-// Get the machine model - typically 6015, which means 60V max, 15A max.
-uint16_t MingHeBuckConverter::getMachineModel() {
-  return (uint16_t)executeGetCommand(MINGHE_COMMAND_MACHINE_MODEL);
+  if (quarantined_) {
+    // Failed probe - wait twice as long for the next one.
+    probe_interval_ms_ <<= 1;
+    if (probe_interval_ms_ > max_probe_ms_) {
+      probe_interval_ms_ = max_probe_ms_;
+    }
+    quarantine_start_ms_ = millis();
+    return;
+  }
+
+  if (quarantine_threshold_ && 
+          (++consecutive_failures_ >= quarantine_threshold_)) {
+    quarantined_ = true;
+    quarantine_start_ms_ = millis();
+  }
+#endif
 }
 
-// Basic connection check - ensure the machine matches what is expected.
-bool MingHeBuckConverter::testConnection(const uint16_t model_number) {
-  if (getMachineModel() == model_number) {
-    return true;
+// Throw away anything sitting in the receive buffer - stale bytes from a failed
+// attempt would otherwise be read as the start of the next response.
+void MingHeBuckConverter::drainInput(void) {
+#if MINGHE_ENABLE_RS485
+  echo_length_ = 0;
+#endif
+  while (stream_->available()) {
+    stream_->read();
   }
-  return false;
 }
 
-// Get the current voltage limit on the machine.
-uint16_t MingHeBuckConverter::getMaxVoltage() {
-  return (uint16_t)executeGetCommand(MINGHE_COMMAND_MAX_VOLTAGE);
+/*
+ * Decide if a failed attempt gets another go, and if so, how long to back off
+ * first.  The backoff doubles each attempt.  A retry is only made if the
+ * backoff finishes inside the deadline (if there is one), and a device "err"
+ * is never retried - asking again will get the same answer.
+ */
+bool MingHeBuckConverter::shouldRetry(const uint8_t status) {
+  // Probes of a quarantined unit get a single attempt.
+  if ((status == MINGHE_STATUS_DEVICE_ERROR) || isQuarantined() ||
+          (attempts_made_ >= transaction_attempts_)) {
+    return false;
+  }
+
+  backoff_ms_ = (uint32_t)retry_policy_.backoff_ms << (attempts_made_ - 1);
+  if (transaction_deadline_ms_ &&
+          ((millis() - transaction_start_ms_ + backoff_ms_) >= 
+          transaction_deadline_ms_)) {
+    return false;
+  }
+  return true;
 }
 
-// Get the current amperage limit on the machine.
-uint16_t MingHeBuckConverter::getMaxCurrent() {
-  return (uint16_t)executeGetCommand(MINGHE_COMMAND_MAX_CURRENT);
+bool MingHeBuckConverter::beginGet(const char command) {
+  return beginAsync(REQUEST_GET, command, 0);
 }
 
-// Returns true if the output is enabled, false if not.
-bool MingHeBuckConverter::getOutputEnabled() {
-  return (bool)executeGetCommand(MINGHE_COMMAND_OUTPUT_STATE);
+bool MingHeBuckConverter::beginSet(const char command, const uint32_t value) {
+  return beginAsync(REQUEST_SET, command, toDevice(command, value));
 }
 
-// Get the current voltage on the machine output.
-uint16_t MingHeBuckConverter::getVoltage() {
-  return (uint16_t)executeGetCommand(MINGHE_COMMAND_VOLTAGE);
+// Start a transaction, and get the request out straight away if the frame gap
+// is already over.
+bool MingHeBuckConverter::beginAsync(const bool set, const char command,
+        const uint32_t value) {
+  uint32_t checked_value = value;
+
+  if (isBusy()) {
+    return false;
+  }
+#if MINGHE_ENABLE_MODEL_PROFILES
+  last_status_ = checkRequest(set, command, &checked_value);
+  if (last_status_ != MINGHE_STATUS_OK) {
+    return false;
+  }
+#endif
+  if (!protocol_->supports(set, command, checked_value)) {
+    last_status_ = MINGHE_STATUS_UNSUPPORTED;
+    return false;
+  }
+  if (!beginTransaction(command)) {
+    return false;
+  }
+
+  async_set_ = set;
+  async_command_ = command;
+  async_value_ = checked_value;
+  attempts_made_ = 0;
+  async_state_ = MINGHE_ASYNC_GAP;
+  poll();
+  return true;
 }
 
-// Get the current amperage on the machine output.
-uint16_t MingHeBuckConverter::getCurrent() {
-  return (uint16_t)executeGetCommand(MINGHE_COMMAND_CURRENT);
+// True until the first byte of the echo, or the response, is in.
+bool MingHeBuckConverter::waitingForStart(void) const {
+#if MINGHE_ENABLE_RS485
+  if (echo_length_) {
+    return !echo_received_;
+  }
+#endif
+  return protocol_->awaitingStart();
 }
 
-/* 
- * Report the limiting factor - voltage, amperage, or the output is off.  This
- * will be one of:
- * MINGHE_LIMITING_FACTOR_OFF (0)
- * MINGHE_LIMITING_FACTOR_VOLTAGE (1)
- * MINGHE_LIMITING_FACTOR_CURRENT (2)
+/*
+ * Move the transaction in flight along as far as it can go without waiting:
+ * send the request once the frame gap is over, decode whatever bytes of the
+ * reply have arrived, and time out, back off and retry as needed.
  */
-uint8_t MingHeBuckConverter::getLimitingFactor() {
-  return (uint8_t)executeGetCommand(MINGHE_COMMAND_LIMITING_FACTOR);
-}
+uint8_t MingHeBuckConverter::poll(void) {
+  uint32_t now_ms, limit_ms;
+  uint8_t status, c;
 
-// Get the current output watts (volts * amps))
-uint32_t MingHeBuckConverter::getWatts() {
-  return executeGetCommand(MINGHE_COMMAND_WATTS);
-}
+  switch (async_state_) {
+    case MINGHE_ASYNC_IDLE:
+      return last_status_;
 
-// Get the mAh passed through the machine.
-uint32_t MingHeBuckConverter::getmAmpHours() {
-  return executeGetCommand(MINGHE_COMMAND_MAMP_HOURS);
+    case MINGHE_ASYNC_BACKOFF:
+      if ((millis() - state_start_ms_) < backoff_ms_) {
+        return MINGHE_STATUS_PENDING;
+      }
+      drainInput();
+      async_state_ = MINGHE_ASYNC_GAP;
+      // Fall through
+
+    case MINGHE_ASYNC_GAP:
+#if MINGHE_ENABLE_RS485
+      /*
+       * Don't drive the bus while anything is still coming in - the rest of
+       * a frame that failed part way, or its CR LF.  Each byte that arrives
+       * starts the gap again.
+       */
+      if ((driver_enable_pin_ != MINGHE_NO_PIN) && stream_->available()) {
+        drainInput();
+        line_->last_frame_end_us = micros();
+        return MINGHE_STATUS_PENDING;
+      }
+#endif
+      // Give the device the quiet time it needs after the last frame.
+      if (!frameGapElapsed(async_set_)) {
+        return MINGHE_STATUS_PENDING;
+      }
+      sendRequest(async_set_, async_command_, async_value_);
+      async_state_ = MINGHE_ASYNC_RESPONSE;
+      state_start_ms_ = millis();
+      break;
+  }
+
+  while (stream_->available()) {
+    c = stream_->read();
+    state_start_ms_ = millis();
+#if MINGHE_ENABLE_RS485
+    // Our own request comes back first on a half-duplex bus with echo.
+    if (echo_length_) {
+      status = takeEcho(c);
+    } else
+#endif
+    status = protocol_->decodeByte(c);
+    if (status != MINGHE_STATUS_PENDING) {
+      return finishAttempt(status);
+    }
+  }
+
+  /*
+   * A timeout at any point ends the attempt - there's no point waiting on the
+   * rest of a frame that has stopped arriving.  The device gets the command's
+   * response time to start talking, but once the ':' is in, the rest has to
+   * keep coming at line speed.  Neither runs past the transaction deadline.
+   */
+  now_ms = millis();
+  limit_ms = MINGHE_INTER_CHARACTER_TIMEOUT_MS;
+  if (waitingForStart()) {
+    limit_ms = response_timeout_ms_ + transmit_ms_;
+  }
+  if (((now_ms - state_start_ms_) >= limit_ms) || (transaction_deadline_ms_ &&
+          ((now_ms - transaction_start_ms_) >= transaction_deadline_ms_))) {
+    return finishAttempt(MINGHE_STATUS_TIMEOUT);
+  }
+  return MINGHE_STATUS_PENDING;
 }
 
-// Get the output on time, in seconds.
-uint32_t MingHeBuckConverter::getPowerOnTime() {
-  return executeGetCommand(MINGHE_COMMAND_RUNTIME);
+// An attempt is over - go round again, or finish the transaction.
+uint8_t MingHeBuckConverter::finishAttempt(const uint8_t status) {
+  uint32_t baud_rate = baudRateFromIndex(baud_index_);
+  uint16_t trailer_us = 0;
+
+  /*
+   * Unless it timed out, the device is still sending the end of its frame -
+   * at least the protocol's trailer, at 10 bits a character.  At low baud
+   * rates that is longer than a typical frame gap, so the gap has to run from
+   * after it.
+   */
+  if ((status != MINGHE_STATUS_TIMEOUT) && baud_rate) {
+    trailer_us = (uint16_t)((protocol_->trailerLength() * 10000000UL) /
+            baud_rate);
+  }
+  markFrameEnd(async_set_, trailer_us);
+  countAttempt(status);
+  attempts_made_++;
+
+  if ((status != MINGHE_STATUS_OK) && shouldRetry(status)) {
+    async_state_ = MINGHE_ASYNC_BACKOFF;
+    state_start_ms_ = millis();
+    return MINGHE_STATUS_PENDING;
+  }
+
+  async_state_ = MINGHE_ASYNC_IDLE;
+  endTransaction(status);
+  return status;
 }
 
-// Get current machine temperature.
-uint16_t MingHeBuckConverter::getTemperature() {
-  return (uint16_t)executeGetCommand(MINGHE_COMMAND_TEMPERATURE);
+// Run the transaction in flight, if there is one, to the end.
+uint8_t MingHeBuckConverter::finishPending(void) {
+  uint8_t status;
+
+  while ((status = poll()) == MINGHE_STATUS_PENDING) {
+    idle();
+  }
+  return status;
 }
 
-// Get the currently set shutdown protection temperature.
-uint16_t MingHeBuckConverter::getShutdownTemperature() {
-  return (uint16_t)executeGetCommand(MINGHE_COMMAND_SHUTDOWN_TEMPERATURE);
+MingHeReading MingHeBuckConverter::getAsyncReading() const {
+  MingHeReading reading;
+
+  reading.status = isBusy() ? MINGHE_STATUS_PENDING : last_status_;
+  if (reading.status != MINGHE_STATUS_OK) {
+    // Not calibrated - a failed read is 0, not the table's offset.  The
+    // blocking getters come through here too.
+    reading.value = 0;
+    return reading;
+  }
+  reading.value = protocol_->getValue();
+  if (!async_set_) {
+    reading.value = fromDevice(async_command_, reading.value);
+  }
+  return reading;
 }
 
-// Get the currently set fan start temperature.
-uint16_t MingHeBuckConverter::getFanStartTemperature() {
-  return (uint16_t)executeGetCommand(MINGHE_COMMAND_FAN_TEMPERATURE);
+// Execute a get command on the device, retrying as the policy allows.  Return
+// the value and how it went.
+MingHeReading MingHeBuckConverter::executeGetCommand(const char command) {
+  finishPending();
+  if (beginGet(command)) {
+    finishPending();
+  }
+  return getAsyncReading();
 }
 
-// Get the state of the fast voltage change function.
-bool MingHeBuckConverter::getFastVoltageChangeEnabled() {
-  return (bool)executeGetCommand(MINGHE_COMMAND_FAST_VOLTAGE_CHANGE);
+// Value only, for the plain getters.
+uint32_t MingHeBuckConverter::readValue(const char command) {
+  return executeGetCommand(command).value;
 }
 
-// Determine if output will be on at boot.
-bool MingHeBuckConverter::getBootOutputEnabled() {
-  return (bool)executeGetCommand(MINGHE_COMMAND_BOOT_OUTPUT_ENABLED);
+// Basic connection check - ensure the machine matches what is expected.
+bool MingHeBuckConverter::testConnection(const uint16_t model_number) {
+  if (getMachineModel() == model_number) {
+    return true;
+  }
+  return false;
 }
 
-// Determine if the beeper is enabled.
-bool MingHeBuckConverter::getBeeperEnabled() {
-  return (bool)executeGetCommand(MINGHE_COMMAND_BEEPER_ENABLED);
+bool MingHeBuckConverter::executeSetCommand(const char command, 
+        const uint32_t value) {
+  finishPending();
+  if (!beginSet(command, value)) {
+    return false;
+  }
+  return finishPending() == MINGHE_STATUS_OK;
 }
 
-// Get the communcation version (probably 22).
-uint16_t MingHeBuckConverter::getCommunicationVersion() {
-  return (uint16_t)executeGetCommand(MINGHE_COMMAND_COMMUNICATION_VERSION);
+// Switch this end to a baud rate and see if the device answers there.  A read
+// that fails at the wrong rate says nothing about whether the unit is alive,
+// so it isn't let push the unit into quarantine.
+bool MingHeBuckConverter::probeBaudRate(const uint8_t baud_rate_index) {
+  resetBaudrate(baud_rate_index);
+  waitMs(MINGHE_POST_READ_DELAY_MS);
+  drainInput();
+  clearQuarantine();
+  return executeGetCommand(MINGHE_COMMAND_MACHINE_MODEL).ok();
 }
 
+/*
+ * Change the device baud rate, and follow it on this end.  The device switches
+ * over as soon as it takes the command, so the "ok" may come back garbled or
+ * not at all - the reply can't be trusted either way.  Instead, send the
+ * command once, switch over, and check the device answers at the new rate.
+ *
+ * If it doesn't, that could be the device never switching, or only the check
+ * getting lost - likely enough at a marginal rate.  Going back to the old rate
+ * blind would lose the device for good in the second case, so look for it at
+ * the old rate, then the new one, and stay wherever it answers.  If it answers
+ * at neither, this end goes back to the old rate.
+ */
+bool MingHeBuckConverter::setBaudRate(const uint8_t baud_rate_index) {
+  uint8_t old_baud_index = baud_index_;
 
-bool MingHeBuckConverter::executeSetCommand(const char command, 
-        const uint32_t value) {
-  char request[12] = {0};
+  if (!baudRateFromIndex(baud_rate_index)) {
+    return false;
+  }
 
-  // Convert the voltage into a string to transmit (with base 10 values)
-  ltoa(value, request, 10);
+  // One shot (per the command timing table) - a retry at the old rate would go
+  // unheard.
+  executeSetCommand(MINGHE_COMMAND_BAUD_RATE, baud_rate_index);
 
-  sendRequest(REQUEST_SET, command, request);
+  // A clean "err" means the device heard and refused - nothing changed.  Not
+  // every protocol can change it, and a quarantined unit was never asked.
+  if ((last_status_ == MINGHE_STATUS_DEVICE_ERROR) || 
+          (last_status_ == MINGHE_STATUS_UNSUPPORTED) ||
+          (last_status_ == MINGHE_STATUS_QUARANTINED)) {
+    return false;
+  }
 
-  if (checkForOk()) {
+  if (probeBaudRate(baud_rate_index)) {
     return true;
   }
+  if (probeBaudRate(old_baud_index)) {
+    return false;
+  }
+  if (probeBaudRate(baud_rate_index)) {
+    return true;
+  }
+  resetBaudrate(old_baud_index);
+  waitMs(MINGHE_POST_READ_DELAY_MS);
+  drainInput();
   return false;
 }
 
+#if MINGHE_ENABLE_MODEL_PROFILES
+bool MingHeBuckConverter::findModelProfile(const uint16_t model,
+        MingHeModelProfile *profile) {
+  for (uint8_t i = 0;
+          i < sizeof(minghe_model_profiles) / sizeof(MingHeModelProfile);
+          i++) {
+    if (pgm_read_word_near(&minghe_model_profiles[i].model) == model) {
+      memcpy_P(profile, minghe_model_profiles + i, sizeof(*profile));
+      return true;
+    }
+  }
+
+  // Volts, then amps, two digits each.
+  if ((model < 100) || (model > 9999) || !(model % 100)) {
+    return false;
+  }
+  profile->model = model;
+  profile->max_voltage = (model / 100) * 100;
+  profile->max_current = (model % 100) * 100;
+  profile->voltage_step = 1;
+  profile->current_step = 1;
+  profile->min_temperature = MODEL_MIN_TEMPERATURE;
+  profile->max_temperature = MODEL_MAX_TEMPERATURE;
+  profile->commands = MINGHE_ALL_COMMANDS;
+  return true;
+}
+
+bool MingHeBuckConverter::loadModelProfile(void) {
+  MingHeReading reading = executeGetCommand(MINGHE_COMMAND_MACHINE_MODEL);
 
+  if (!reading.ok() || 
+          !findModelProfile((uint16_t)reading.value, &model_profile_)) {
+    return false;
+  }
+  has_model_profile_ = true;
+  return true;
+}
 
+void MingHeBuckConverter::setModelProfile(const MingHeModelProfile &profile) {
+  model_profile_ = profile;
+  has_model_profile_ = true;
+}
 
 /*
- * The various setters all oerate like this: Execute the command, then verify 
- * that the new value is set properly.
- * 
- * Calling code should respond properly if this returns false.
+ * Anything without a range here (counters, reads, unknown letters) goes out as
+ * is.  Clamping a slot, address or baud index would do something other than
+ * what was asked, so those are only ever refused.
  */
+uint8_t MingHeBuckConverter::checkRequest(const bool set, const char command,
+        uint32_t *value) const {
+  uint32_t low = 0, high, step = 1;
+  bool clamp = (range_policy_ == MINGHE_RANGE_CLAMP);
 
-// Set the maximum allowed voltage.
-bool MingHeBuckConverter::setMaxVoltage(const uint16_t volts_100) {
-  if (executeSetCommand(MINGHE_COMMAND_MAX_VOLTAGE, volts_100)) {
-    return (getMaxVoltage() == volts_100);
+  if (!has_model_profile_) {
+    return MINGHE_STATUS_OK;
+  }
+  if ((command >= 'a') && (command <= 'z') && 
+          !(model_profile_.commands & MINGHE_COMMAND_BIT(command))) {
+    return MINGHE_STATUS_UNSUPPORTED;
+  }
+  if (!set) {
+    return MINGHE_STATUS_OK;
   }
-  return false;
-}
 
-// Set the maximum allowed current.
-bool MingHeBuckConverter::setMaxCurrent(const uint16_t amps_100) {
-  if (executeSetCommand(MINGHE_COMMAND_MAX_CURRENT, amps_100)) {
-    return (getMaxCurrent() == amps_100);
+  switch (command) {
+    case MINGHE_COMMAND_MAX_VOLTAGE:
+      high = model_profile_.max_voltage;
+      step = model_profile_.voltage_step;
+      break;
+    case MINGHE_COMMAND_MAX_CURRENT:
+      high = model_profile_.max_current;
+      step = model_profile_.current_step;
+      break;
+    case MINGHE_COMMAND_SHUTDOWN_TEMPERATURE:
+    case MINGHE_COMMAND_FAN_TEMPERATURE:
+      low = model_profile_.min_temperature;
+      high = model_profile_.max_temperature;
+      break;
+    case MINGHE_COMMAND_OUTPUT_STATE:
+    case MINGHE_COMMAND_FAST_VOLTAGE_CHANGE:
+    case MINGHE_COMMAND_BOOT_OUTPUT_ENABLED:
+    case MINGHE_COMMAND_BEEPER_ENABLED:
+      high = 1;
+      clamp = false;
+      break;
+    case MINGHE_COMMAND_STORE_TO_MEMORY:
+    case MINGHE_COMMAND_LOAD_FROM_MEMORY:
+      high = MINGHE_MEMORY_SLOTS - 1;
+      clamp = false;
+      break;
+    case MINGHE_COMMAND_ADDRESS:
+      low = 1;
+      high = MINGHE_MAX_ADDRESS;
+      clamp = false;
+      break;
+    case MINGHE_COMMAND_BAUD_RATE:
+      high = MINGHE_BAUD_4800;
+      clamp = false;
+      break;
+    default:
+      return MINGHE_STATUS_OK;
   }
-  return false;
-}
 
-// Enable or disable the output.
-bool MingHeBuckConverter::setOutputEnabled(const bool enabled) {
-  if (executeSetCommand(MINGHE_COMMAND_OUTPUT_STATE, enabled)) {
-    return (getOutputEnabled() == enabled);
+  if ((*value < low) || (*value > high)) {
+    if (!clamp) {
+      return MINGHE_STATUS_OUT_OF_RANGE;
+    }
+    *value = (*value < low) ? low : high;
   }
-  return false;
+  if (step > 1) {
+    *value -= *value % step;
+  }
+  return MINGHE_STATUS_OK;
 }
+#endif
 
-// Set the mAh field on the device.
-bool MingHeBuckConverter::setmAmpHours(const uint32_t mamp_hours) {
-  if (executeSetCommand(MINGHE_COMMAND_MAMP_HOURS, mamp_hours)) {
-    // mAmp-hours can climb between set and read.  Allow some slack.
-    uint32_t diff;
-
-    diff = getmAmpHours() - mamp_hours;
+uint8_t MingHeBuckConverter::getCommandCount() {
+  return MINGHE_COMMAND_COUNT;
+}
 
-    if (diff < MAMP_HOUR_TOLERANCE) {
-      return true;
+int8_t MingHeBuckConverter::getCommandIndex(const char command) {
+  for (uint8_t i = 0; i < MINGHE_COMMAND_COUNT; i++) {
+    if ((char)pgm_read_byte_near(&minghe_command_table[i].command) == 
+            command) {
+      return i;
     }
   }
-  return false;
+  return -1;
 }
 
-// Set the overtemperature shutdown temperature.
-bool MingHeBuckConverter::setShutdownTemperature(const uint8_t degrees_c) {
-  if (executeSetCommand(MINGHE_COMMAND_SHUTDOWN_TEMPERATURE, degrees_c)) {
-    return (getShutdownTemperature() == degrees_c);
+char MingHeBuckConverter::getCommandAt(const uint8_t index) {
+  if (index >= MINGHE_COMMAND_COUNT) {
+    return 0;
   }
-  return false;
+  return (char)pgm_read_byte_near(&minghe_command_table[index].command);
 }
 
-// Set the fan start temperature.
-bool MingHeBuckConverter::setFanStartTemperature(const uint8_t degrees_c) {
-  if (executeSetCommand(MINGHE_COMMAND_FAN_TEMPERATURE, degrees_c)) {
-    return (getFanStartTemperature() == degrees_c);
+bool MingHeBuckConverter::getCommandDescriptor(const char command, 
+        MingHeCommandDescriptor *descriptor) {
+  int8_t index = getCommandIndex(command);
+
+  if (index < 0) {
+    return false;
   }
-  return false;
+  memcpy_P(descriptor, minghe_command_table + index, sizeof(*descriptor));
+  return true;
 }
 
-// Set the current power on time value.
-bool MingHeBuckConverter::setPowerOnTime(const uint32_t seconds) {
-  if (executeSetCommand(MINGHE_COMMAND_RUNTIME, seconds)) {
-    // Allow a few seconds difference.
-    uint32_t diff;
-    
-    diff = getPowerOnTime() - seconds;
+/*
+ * Set, then check the set took, per the command table.  Unknown commands are
+ * sent as is, with no check.
+ */
+bool MingHeBuckConverter::setVerified(const char command, 
+        const uint32_t requested) {
+  MingHeCommandDescriptor descriptor;
+  MingHeReading reading;
+  uint32_t value;
+
+  if (!executeSetCommand(command, requested)) {
+    return false;
+  }
+  // Check the read back against what was sent, after any clamping, as it
+  // will come back through the calibration table.
+  value = fromDevice(command, async_value_);
+  if (!getCommandDescriptor(command, &descriptor) || 
+          !(descriptor.flags & (MINGHE_CMD_VERIFY | MINGHE_CMD_CLIMBS))) {
+    return true;
+  }
 
-    if (diff < SECOND_TOLERANCE) {
-      return true;
-    }
+  reading = executeGetCommand(command);
+  if (!reading.ok()) {
+    return false;
   }
-  return false;
+  if (descriptor.flags & MINGHE_CMD_CLIMBS) {
+    // Unsigned, so a reading below the value written is a huge difference.
+    return (reading.value - value) < descriptor.tolerance;
+  }
+  return reading.value == value;
 }
 
-// You do NOT want to call this.  It does not work properly, as the baud rate
-// changes in the middle of the executeSetCommand and this does not work right.
-// TODO: Fix, or remove.  Any volunteers?
-bool MingHeBuckConverter::setBaudRate(const uint8_t baud_rate_index) {
-  if (executeSetCommand(MINGHE_COMMAND_BAUD_RATE, baud_rate_index)) {
-    // Calling code should probably change the baud rate now...
-    return true;
+#if MINGHE_ENABLE_CALIBRATION
+int8_t MingHeBuckConverter::calibrationIndex(const char command) {
+  switch (command) {
+    case MINGHE_COMMAND_MAX_VOLTAGE: return 0;
+    case MINGHE_COMMAND_MAX_CURRENT: return 1;
+    case MINGHE_COMMAND_VOLTAGE: return 2;
+    case MINGHE_COMMAND_CURRENT: return 3;
   }
-  return false;
+  return -1;
 }
 
-// Set the device communication address.
-bool MingHeBuckConverter::setAddress(const uint8_t new_address) {
-  if (executeSetCommand(MINGHE_COMMAND_ADDRESS, new_address)) {
-    // You'll need to call .resetDeviceId after this.
-    return true;
+bool MingHeBuckConverter::setCalibration(const char command,
+        const MingHeCalibration *calibration) {
+  int8_t index = calibrationIndex(command);
+
+  if (index < 0) {
+    return false;
   }
-  return false;
+  calibration_[index] = calibration;
+  return true;
 }
 
-// Enable or disable output on boot.
-bool MingHeBuckConverter::setBootOutputEnabled(const bool enabled) {
-  if (executeSetCommand(MINGHE_COMMAND_BOOT_OUTPUT_ENABLED, enabled)) {
-    return (getBootOutputEnabled() == enabled);
+const MingHeCalibration *MingHeBuckConverter::getCalibration(
+        const char command) const {
+  int8_t index = calibrationIndex(command);
+
+  return (index < 0) ? NULL : calibration_[index];
+}
+#endif
+
+uint32_t MingHeBuckConverter::fromDevice(const char command,
+        const uint32_t value) const {
+#if MINGHE_ENABLE_CALIBRATION
+  const MingHeCalibration *calibration = getCalibration(command);
+
+  if (calibration) {
+    return calibration->toActual(value > 0xFFFF ? 0xFFFF : value);
   }
-  return false;
+#else
+  (void)command;
+#endif
+  return value;
 }
 
-// Enable or disable the beeper.
-bool MingHeBuckConverter::setBeeperEnabled(const bool enabled) {
-  if (executeSetCommand(MINGHE_COMMAND_BEEPER_ENABLED, enabled)) {
-    return (getBeeperEnabled() == enabled);
+uint32_t MingHeBuckConverter::toDevice(const char command,
+        const uint32_t value) const {
+#if MINGHE_ENABLE_CALIBRATION
+  const MingHeCalibration *calibration = getCalibration(command);
+
+  if (calibration) {
+    return calibration->toDevice(value > 0xFFFF ? 0xFFFF : value);
   }
-  return false;
+#else
+  (void)command;
+#endif
+  return value;
 }
 
-// Enable or disable fast voltage change.
-bool MingHeBuckConverter::setFastVoltageChangeEnabled(const bool enabled) {
-  if (executeSetCommand(MINGHE_COMMAND_FAST_VOLTAGE_CHANGE, enabled)) {
-    return (getFastVoltageChangeEnabled() == enabled);
+#if MINGHE_ENABLE_SNAPSHOT
+bool MingHeBuckConverter::takeSnapshot(MingHeSnapshot *snapshot) {
+  MingHeCommandDescriptor descriptor;
+  MingHeReading reading;
+  uint8_t offset = 0;
+  bool all_read = true, block;
+
+  // Where the protocol can read everything in one frame, do that first.
+  block = executeGetCommand(MINGHE_COMMAND_READ_ALL).ok();
+
+  snapshot->valid = 0;
+  for (uint8_t i = 0; i < MINGHE_COMMAND_COUNT; i++) {
+    memcpy_P(&descriptor, minghe_command_table + i, sizeof(descriptor));
+    if (!(descriptor.flags & MINGHE_CMD_READ)) {
+      continue;
+    }
+    if (block && 
+            protocol_->getBlockValue(descriptor.command, &reading.value)) {
+      reading.value = fromDevice(descriptor.command, reading.value);
+      reading.status = MINGHE_STATUS_OK;
+    } else {
+      reading = executeGetCommand(descriptor.command);
+    }
+    if (reading.ok()) {
+      snapshot->valid |= (1UL << i);
+    } else if (reading.status != MINGHE_STATUS_UNSUPPORTED) {
+      all_read = false;
+    }
+    // Little endian, at the value's width.
+    for (uint8_t b = 0; b < descriptor.width; b++) {
+      snapshot->data[offset++] = (uint8_t)(reading.value >> (8 * b));
+    }
   }
-  return false;
+  return all_read;
 }
 
-// Store current current/amperage limit to a memory slot.
-bool MingHeBuckConverter::storeToMemory(const uint8_t slot) {
-  if (executeSetCommand(MINGHE_COMMAND_STORE_TO_MEMORY, slot)) {
-    return true;
+/*
+ * Unpack a value from a snapshot.  Snapshot data is packed in table order, so
+ * this walks the table adding up widths to find it.
+ */
+uint32_t MingHeBuckConverter::getSnapshotValue(
+        const MingHeSnapshot &snapshot, const char command) {
+  MingHeCommandDescriptor descriptor;
+  uint8_t offset = 0;
+  uint32_t value = 0;
+
+  for (uint8_t i = 0; i < MINGHE_COMMAND_COUNT; i++) {
+    memcpy_P(&descriptor, minghe_command_table + i, sizeof(descriptor));
+    if (!(descriptor.flags & MINGHE_CMD_READ)) {
+      continue;
+    }
+    if (descriptor.command == command) {
+      if (!(snapshot.valid & (1UL << i))) {
+        return 0;
+      }
+      for (uint8_t b = descriptor.width; b > 0; b--) {
+        value = (value << 8) | snapshot.data[offset + b - 1];
+      }
+      return value;
+    }
+    offset += descriptor.width;
   }
-  return false;
+  return 0;
 }
 
-// Load current/amperage limits from a memory slot.
-bool MingHeBuckConverter::loadFromMemory(const uint8_t slot) {
-  if (executeSetCommand(MINGHE_COMMAND_LOAD_FROM_MEMORY, slot)) {
-    return true;
+uint32_t MingHeBuckConverter::diffSnapshots(const MingHeSnapshot &a, 
+        const MingHeSnapshot &b) {
+  MingHeCommandDescriptor descriptor;
+  uint32_t diff = a.valid ^ b.valid;
+  uint8_t offset = 0;
+
+  for (uint8_t i = 0; i < MINGHE_COMMAND_COUNT; i++) {
+    memcpy_P(&descriptor, minghe_command_table + i, sizeof(descriptor));
+    if (!(descriptor.flags & MINGHE_CMD_READ)) {
+      continue;
+    }
+    if ((a.valid & b.valid & (1UL << i)) && 
+            memcmp(a.data + offset, b.data + offset, descriptor.width)) {
+      diff |= (1UL << i);
+    }
+    offset += descriptor.width;
   }
-  return false;
+  return diff;
 }
 
+bool MingHeBuckConverter::applySnapshot(const MingHeSnapshot &target, 
+        const MingHeSnapshot *current) {
+  MingHeCommandDescriptor descriptor;
+  uint32_t to_write = target.valid;
+  bool all_written = true;
+
+  if (current) {
+    to_write &= diffSnapshots(target, *current);
+  }
+
+  for (uint8_t i = 0; i < MINGHE_COMMAND_COUNT; i++) {
+    memcpy_P(&descriptor, minghe_command_table + i, sizeof(descriptor));
+    if (!(descriptor.flags & MINGHE_CMD_SETTING) || 
+            !(to_write & (1UL << i))) {
+      continue;
+    }
+    if (!setVerified(descriptor.command, 
+            getSnapshotValue(target, descriptor.command))) {
+      all_written = false;
+    }
+  }
+  return all_written;
+}
+#endif
@@ -16,7 +16,10 @@
 
 #include <SoftwareSerial.h>
 
+#include "MingHeCalibration.h"
 #include "MingHeChecksum.h"
+#include "MingHeConfig.h"
+#include "MingHeProtocol.h"
 
 // Indexes for setting the baud rate.
 #define MINGHE_BAUD_9600 0
@@ -28,10 +31,68 @@
 #define MINGHE_BAUD_2400 6
 #define MINGHE_BAUD_4800 7
 
-#define MINGHE_PER_CHARACTER_TIMEOUT_MS 500
+// How long to wait for the first byte of a reply, unless the command timing
+// table says otherwise, and for each byte after that.  Once a reply has
+// started, the rest follows at line speed - 50ms is 6 characters at 1200 baud.
+#define MINGHE_DEFAULT_RESPONSE_TIMEOUT_MS 200
+#define MINGHE_INTER_CHARACTER_TIMEOUT_MS 50
+// Deprecated - the old single timeout, before the first-byte wait went to
+// 200ms.  Kept so sketches that use it still build; it no longer sets anything.
+#define MINGHE_PER_CHARACTER_TIMEOUT_MS MINGHE_DEFAULT_RESPONSE_TIMEOUT_MS
+
+// No RS-485 driver enable pin.
+#define MINGHE_NO_PIN 0xFF
 
 #define MINGHE_MAX_JUNK_CHARACTERS 32
 
+// A uint32 is at most 10 decimal digits.
+#define MINGHE_MAX_VALUE_DIGITS 10
+// Longest response body: "r", the command and a full value, with some slop.
+#define MINGHE_MAX_RESPONSE_BODY 15
+// Longest request: ':', the address, 's', the command, a full value, the LRC
+// and newline.
+#define MINGHE_MAX_REQUEST_LENGTH 17
+
+// Default retry policy: 3 tries, backing off 10ms then 20ms, and never taking
+// more than 1.5s in total.
+#define MINGHE_DEFAULT_ATTEMPTS 3
+#define MINGHE_DEFAULT_BACKOFF_MS 10
+#define MINGHE_DEFAULT_DEADLINE_MS 1500
+
+// Result of a transaction.  Anything other than OK means the value is junk.
+#define MINGHE_STATUS_OK 0
+// Nothing (or not enough) came back before the timeout or deadline.
+#define MINGHE_STATUS_TIMEOUT 1
+// A response arrived, but the LRC did not match.
+#define MINGHE_STATUS_CHECKSUM 2
+// A response arrived from some other device address.
+#define MINGHE_STATUS_WRONG_DEVICE 3
+// A response arrived, but was not for the command sent, or was garbage.
+#define MINGHE_STATUS_BAD_RESPONSE 4
+// The device replied "err" - usually an out of range value.  Not retried.
+#define MINGHE_STATUS_DEVICE_ERROR 5
+// The unit is quarantined and nothing was sent.  See setQuarantinePolicy.
+#define MINGHE_STATUS_QUARANTINED 6
+// A non-blocking transaction is still under way.  See poll.
+#define MINGHE_STATUS_PENDING 7
+// The protocol in use has no way to send the request.  Nothing was sent.
+#define MINGHE_STATUS_UNSUPPORTED 8
+// The value is outside what the unit's model profile allows, and the range
+// policy is to reject.  Nothing was sent.  See setModelProfile.
+#define MINGHE_STATUS_OUT_OF_RANGE 9
+
+// Where a non-blocking transaction is at.
+#define MINGHE_ASYNC_IDLE 0
+#define MINGHE_ASYNC_GAP 1
+#define MINGHE_ASYNC_RESPONSE 2
+#define MINGHE_ASYNC_BACKOFF 3
+
+// Quarantine a unit after this many failed transactions in a row, then probe
+// it after 1s, 2s, 4s... up to once a minute until it answers.
+#define MINGHE_DEFAULT_QUARANTINE_THRESHOLD 3
+#define MINGHE_DEFAULT_MIN_PROBE_MS 1000
+#define MINGHE_DEFAULT_MAX_PROBE_MS 60000UL
+
 #define MINGHE_COMMAND_MAX_VOLTAGE 'u'
 #define MINGHE_COMMAND_MAX_CURRENT 'i'
 #define MINGHE_COMMAND_VOLTAGE 'v'
@@ -53,13 +114,34 @@
 #define MINGHE_COMMAND_ADDRESS 'd'
 #define MINGHE_COMMAND_STORE_TO_MEMORY 'm'
 #define MINGHE_COMMAND_LOAD_FROM_MEMORY 'n'
+// Not a device command: a get of every value the protocol can read in one
+// frame.  See MingHeProtocol::getBlockValue.  Unsupported on ASCII.
+#define MINGHE_COMMAND_READ_ALL '*'
+
+// Memory slots are 0-9, and addresses 1-99.
+#define MINGHE_MEMORY_SLOTS 10
+#define MINGHE_MAX_ADDRESS 99
+
+// What to do with a write outside the model profile's range: refuse it, or
+// bring it into range and send that.
+#define MINGHE_RANGE_REJECT 0
+#define MINGHE_RANGE_CLAMP 1
+
+// Commands that can have calibration tables: the two limits and the two
+// readings.
+#define MINGHE_CALIBRATION_COMMANDS 4
+
+// Model profile command bits, one per command letter - 'a' is bit 0.
+#define MINGHE_COMMAND_BIT(command) (1UL << ((command) - 'a'))
+#define MINGHE_ALL_COMMANDS 0x03FFFFFFUL
 
 #define MINGHE_LIMITING_FACTOR_OFF 0
 #define MINGHE_LIMITING_FACTOR_VOLTAGE 1
 #define MINGHE_LIMITING_FACTOR_CURRENT 2
 
-// Delay after reads in case the next command is a write.  The device cannot
-// handle rapid read-then-write behavior.  1ms is enough, normally, so use 5.
+// Default gap between frames.  The device cannot handle rapid read-then-write
+// behavior.  1ms is enough, normally, so use 5.  Measure the real figures for
+// your setup with MingHeGapCharacterizer and load them with setFrameGaps.
 #define MINGHE_POST_READ_DELAY_MS 5
 
 // To make request code more readable...
@@ -71,6 +153,148 @@
 #define MAMP_HOUR_TOLERANCE 100
 #define SECOND_TOLERANCE 2
 
+// Command descriptor flags.
+// The command can be read, and/or set.
+#define MINGHE_CMD_READ 0x01
+#define MINGHE_CMD_WRITE 0x02
+// After a set, read back and expect exactly the value written...
+#define MINGHE_CMD_VERIFY 0x04
+// ...or a value up to tolerance above it - for counters that keep running.
+#define MINGHE_CMD_CLIMBS 0x08
+// The value is on/off.
+#define MINGHE_CMD_BOOL 0x10
+// Part of the device setup, written back by applySnapshot.
+#define MINGHE_CMD_SETTING 0x20
+
+// Bytes it takes to hold every readable value, each at its width.
+#define MINGHE_SNAPSHOT_BYTES 35
+
+/**
+ * A value read from the device, and how the read went.  If status is not
+ * MINGHE_STATUS_OK, value is 0 and means nothing.
+ */
+struct MingHeReading {
+  uint32_t value;
+  uint8_t status;
+
+  bool ok() const { return status == MINGHE_STATUS_OK; }
+};
+
+/**
+ * Running counts of what has happened on the wire.  Attempts count every
+ * request sent, including retries; the error counts are per attempt.
+ */
+struct MingHeStats {
+  uint32_t transactions;
+  uint32_t attempts;
+  uint32_t timeouts;
+  uint32_t checksum_errors;
+  uint32_t wrong_device;
+  uint32_t bad_responses;
+  uint32_t device_errors;
+  // Transactions refused without sending because the unit was quarantined.
+  uint32_t quarantined;
+};
+
+/**
+ * Minimum quiet time, in microseconds, from the end of one response to the
+ * start of the next request, by [previous frame was a set][next is a set].
+ * So gap_us[0][1] is read-to-write.
+ */
+struct MingHeFrameGaps {
+  uint16_t gap_us[2][2];
+};
+
+/**
+ * When the last frame on a line ended, how long the device was still sending
+ * after that (its trailer - see MingHeProtocol::trailerLength), and whether it
+ * was a set.  Units sharing a line should share one of these, so that each
+ * waits out its frame gap after whichever unit spoke last, not just after
+ * itself - see setLineState.
+ */
+struct MingHeLineState {
+  uint32_t last_frame_end_us;
+  uint16_t last_frame_trailer_us;
+  bool last_frame_was_set;
+};
+
+/**
+ * Timing for one command letter, for commands that need something other than
+ * the defaults.  response_ms is the wait for the first byte of the reply, and
+ * settle_ms is extra quiet time after the transaction, on top of the frame gap,
+ * for commands the device is still busy with after it replies.  attempts and
+ * deadline_ms replace the retry policy's for this command, unless 0.
+ */
+struct MingHeCommandTiming {
+  char command;
+  uint16_t response_ms;
+  uint16_t settle_ms;
+  uint8_t attempts;
+  uint16_t deadline_ms;
+};
+
+/**
+ * What the driver knows about a command: what can be done with it, how wide
+ * its value is (1, 2 or 4 bytes), and how a set is checked.  The table of
+ * these lives in flash - see getCommandDescriptor.
+ */
+struct MingHeCommandDescriptor {
+  char command;
+  uint8_t flags;
+  uint8_t width;
+  uint8_t tolerance;
+};
+
+/**
+ * Every readable value on a device at one point in time, packed at each
+ * value's width in command table order.  valid has a bit set, by command
+ * index, for each value that was read.
+ */
+struct MingHeSnapshot {
+  uint8_t data[MINGHE_SNAPSHOT_BYTES];
+  uint32_t valid;
+};
+
+// Called with the new baud rate when a caller-owned stream needs to change.
+typedef void (*MingHeBaudRateCallback)(const uint32_t baud_rate);
+
+/**
+ * How hard to try before giving up on a transaction.  Each failed attempt backs
+ * off for backoff_ms, doubling each time, before the next.  No retry is started
+ * that would back off past deadline_ms, and reads are cut off at the deadline,
+ * so a transaction never takes longer than deadline_ms plus the time to send
+ * one request and one frame gap - whatever the line is doing.  The command
+ * timing table can give a command its own attempts and deadline.
+ *
+ * A deadline_ms of 0 means no deadline: each attempt is still cut off by the
+ * response timeout, so a transaction is bounded by attempts times that plus
+ * the backoffs.  An attempts of 0 is taken as 1.
+ */
+struct MingHeRetryPolicy {
+  uint8_t attempts;
+  uint16_t backoff_ms;
+  uint16_t deadline_ms;
+};
+
+#if MINGHE_ENABLE_MODEL_PROFILES
+/**
+ * What one model of converter takes.  The limits are in the usual hundredths,
+ * and set points are rounded down to a multiple of the step.  The temperature
+ * range covers both the shutdown and fan start temperatures.  commands has a
+ * MINGHE_COMMAND_BIT set for each command letter the model understands.
+ */
+struct MingHeModelProfile {
+  uint16_t model;
+  uint16_t max_voltage;
+  uint16_t max_current;
+  uint8_t voltage_step;
+  uint8_t current_step;
+  uint8_t min_temperature;
+  uint8_t max_temperature;
+  uint32_t commands;
+};
+#endif
+
 class MingHeBuckConverter {
 public:
   /**
@@ -80,6 +304,17 @@ public:
    */
   MingHeBuckConverter(const uint8_t tx_pin, const uint8_t rx_pin,
           const uint8_t device_id, const uint8_t start_baud);
+
+  /**
+   * Constructor for an already configured transport.  Anything that looks like
+   * a Stream works - a HardwareSerial port, a SoftwareSerial you set up
+   * yourself, or a MingHeEmulator.  The stream is not owned, and the baud rate
+   * is not touched - resetBaudrate calls the baud rate callback, if one is
+   * set, to have the owner change it.  Pass the baud index the stream and
+   * device start at.
+   */
+  MingHeBuckConverter(Stream *stream, const uint8_t device_id,
+          const uint8_t start_baud = MINGHE_BAUD_9600);
   ~MingHeBuckConverter();
 
   // Test the connection to see if it's alive.
@@ -89,85 +324,540 @@ public:
   void resetDeviceId(const uint16_t device_id);
   // Reset the baud rate
   void resetBaudrate(const uint8_t new_baud_rate_flag);
+  uint8_t getBaudIndex() const { return baud_index_; }
+  // How a caller-owned stream gets told to change baud rate.
+  void setBaudRateCallback(MingHeBaudRateCallback callback) {
+    baud_rate_callback_ = callback;
+  }
+  // Baud rate for a MINGHE_BAUD_ index, or 0 if the index is not valid.
+  static uint32_t baudRateFromIndex(const uint8_t baud_index);
+
+  /**
+   * The wire protocol (see MingHeProtocol.h).  ASCII unless set otherwise -
+   * pass a MingHeModbus for units that speak Modbus-RTU, or NULL to go back
+   * to ASCII.  The protocol object is not owned, and each converter needs its
+   * own.  Everything else (getters, setters, retries, snapshots) works the
+   * same either way, except that commands the protocol can't express fail
+   * with MINGHE_STATUS_UNSUPPORTED.
+   */
+  void setProtocol(MingHeProtocol *protocol);
+  MingHeProtocol *getProtocol() const { return protocol_; }
+
+#if MINGHE_ENABLE_RS485
+  /**
+   * RS-485 half-duplex support.  Give the pin wired to the transceiver's DE
+   * (and /RE, if tied together) and it is held high for exactly the length of
+   * each request frame, dropping as the last stop bit finishes.  It isn't
+   * raised while the device could still be talking: the frame gap runs from
+   * after the last response's CR LF, and starts again on any byte still
+   * coming in.  Pass MINGHE_NO_PIN to go back to full duplex.
+   */
+  void setTransceiverPin(const uint8_t driver_enable_pin);
+
+  /**
+   * If the receiver stays enabled while transmitting, each request comes back
+   * as an echo ahead of the response.  Turn this on and the echo is read back,
+   * checked, and thrown away - a mismatch means another node was talking.
+   */
+  void setEchoSuppression(const bool enabled);
+#endif
+
+#if MINGHE_ENABLE_LOW_POWER
+  /**
+   * Sleep the CPU (AVR idle mode) instead of spinning while waiting for the
+   * device.  Incoming bytes and the millis() timer wake it, so replies are
+   * picked up just as fast - it just stops burning power in between.  Off by
+   * default, as it relies on timer 0 running.  Does nothing off AVR.
+   */
+  void setLowPowerWait(const bool enabled);
+#endif
+
+  /**
+   * Frame gaps (see MingHeFrameGaps).  Either set one set of gaps for the
+   * current link, or point at a PROGMEM table with one entry per MINGHE_BAUD_
+   * index, and the right entry is picked up whenever the baud rate changes.
+   * Both default to MINGHE_POST_READ_DELAY_MS for everything.
+   */
+  void setFrameGaps(const MingHeFrameGaps &gaps);
+  /**
+   * Time frame gaps from the last frame on a shared line, rather than this
+   * unit's own last frame.  MingHeBus does this for the units added to it.
+   * NULL goes back to the unit's own.
+   */
+  void setLineState(MingHeLineState *line);
+  void setFrameGapTable(const MingHeFrameGaps *table);
+  const MingHeFrameGaps &getFrameGaps() const { return frame_gaps_; }
+
+#if MINGHE_ENABLE_STATS
+  // Link statistics since construction or the last reset.
+  const MingHeStats &getStats() const { return stats_; }
+  void resetStats(void);
+#endif
+
+  // Set the retry policy used by every get and set.  See MingHeRetryPolicy.
+  void setRetryPolicy(const uint8_t attempts, const uint16_t backoff_ms,
+          const uint16_t deadline_ms);
+  const MingHeRetryPolicy &getRetryPolicy() const { return retry_policy_; }
+
+  /**
+   * Per-command timing (see MingHeCommandTiming).  Point at a PROGMEM table of
+   * count entries to replace the built in one, which gives the memory and
+   * address commands extra time.  Commands not in the table use
+   * MINGHE_DEFAULT_RESPONSE_TIMEOUT_MS and the retry policy.  Keep the baud
+   * rate command at a single attempt - a retry at the old rate goes unheard.
+   */
+  void setCommandTimingTable(const MingHeCommandTiming *table, 
+          const uint8_t count);
+  // Look up the timing that applies to a command letter.
+  void getCommandTiming(const char command, MingHeCommandTiming *timing) const;
+
+  /**
+   * Status of the most recent transaction (one of the MINGHE_STATUS_ values).
+   * The plain getters return 0 on failure, which can be a perfectly good
+   * reading - check this to tell the two apart.  For setters, this is the
+   * status of the verify read if the set itself went through.
+   */
+  uint8_t getLastStatus() const { return last_status_; }
+
+  /**
+   * Dead unit handling.  After threshold transactions in a row fail on the
+   * wire (timeouts, bad frames - not device "err" replies), the unit is
+   * quarantined: gets and sets fail at once with MINGHE_STATUS_QUARANTINED
+   * instead of costing a full timeout each.  Once a probe is due, the next
+   * transaction goes out as a single attempt.  If it works, the unit is back;
+   * if not, the wait to the next probe doubles, up to max_probe_ms.
+   * A threshold of 0 turns this off.
+   */
+#if MINGHE_ENABLE_QUARANTINE
+  void setQuarantinePolicy(const uint8_t threshold, 
+          const uint32_t min_probe_ms, const uint32_t max_probe_ms);
+  bool isQuarantined() const { return quarantined_; }
+  // True if the unit is quarantined and due to be probed.
+  bool isProbeDue() const;
+  // Put the unit back in service, e.g. after it was power cycled.
+  void clearQuarantine();
+#else
+  // Compiled out - units are never quarantined.
+  void setQuarantinePolicy(const uint8_t /* threshold */,
+          const uint32_t /* min_probe_ms */,
+          const uint32_t /* max_probe_ms */) {}
+  bool isQuarantined() const { return false; }
+  bool isProbeDue() const { return false; }
+  void clearQuarantine() {}
+#endif
+
+  uint8_t getDeviceId() const { return device_id_; }
+
+#if MINGHE_ENABLE_MODEL_PROFILES
+  /**
+   * Model profiles (see MingHeModelProfile).  With one loaded, writes are
+   * checked before they go on the wire: a command the model doesn't have fails
+   * with MINGHE_STATUS_UNSUPPORTED, and a value it won't take is either
+   * refused with MINGHE_STATUS_OUT_OF_RANGE or clamped into range, per the
+   * range policy - rather than costing a round trip for an "err".  Switches,
+   * memory slots, the address and the baud rate are checked too, but never
+   * clamped.  No profile is loaded to start with, and nothing is checked.
+   *
+   * loadModelProfile reads the model and looks it up with findModelProfile.
+   * Returns false if the read failed or the model number makes no sense.
+   */
+  bool loadModelProfile(void);
+  void setModelProfile(const MingHeModelProfile &profile);
+  void clearModelProfile(void) { has_model_profile_ = false; }
+  // The profile in use, or NULL if there isn't one.
+  const MingHeModelProfile *getModelProfile() const {
+    return has_model_profile_ ? &model_profile_ : NULL;
+  }
+  // MINGHE_RANGE_REJECT (the default) or MINGHE_RANGE_CLAMP.
+  void setRangePolicy(const uint8_t policy) { range_policy_ = policy; }
+
+  /**
+   * The profile for a model number: the built in table's entry if there is
+   * one, otherwise worked out from the number - 6015 is 60V and 15A.  False if
+   * it can't be.
+   */
+  static bool findModelProfile(const uint16_t model,
+          MingHeModelProfile *profile);
+#endif
+
+#if MINGHE_ENABLE_CALIBRATION
+  /**
+   * Calibration tables (see MingHeCalibration) for the voltage and current
+   * limits, MINGHE_COMMAND_MAX_VOLTAGE and MINGHE_COMMAND_MAX_CURRENT, and the
+   * readings, MINGHE_COMMAND_VOLTAGE and MINGHE_COMMAND_CURRENT.  With one
+   * set, values going out are put through toDevice, and values coming back
+   * through toActual, on every path - the getters and setters, getReading and
+   * setValue, the non-blocking calls and snapshots - so the sketch only ever
+   * sees true values.  Limits are range checked after correction, as the
+   * device will see them.
+   *
+   * The table isn't copied, so has to stay put.  NULL clears it.  False for
+   * any other command.
+   */
+  bool setCalibration(const char command,
+          const MingHeCalibration *calibration);
+  const MingHeCalibration *getCalibration(const char command) const;
+#endif
+
+  // Read any value by command letter (MINGHE_COMMAND_*), with status.
+  MingHeReading getReading(const char command) {
+    return executeGetCommand(command);
+  }
+
+  // Set any value by command letter, without the verify read the named
+  // setters do.  Returns true on an "ok" from the device.
+  bool setValue(const char command, const uint32_t value) {
+    return executeSetCommand(command, value);
+  }
+
+  /**
+   * Set any value by command letter, then check it took, the way the command
+   * table says to: read back and compare, allow a counter to have climbed a
+   * little, or (for commands with nothing to read back) trust the "ok".
+   */
+  bool setVerified(const char command, const uint32_t value);
+
+  /**
+   * Non-blocking gets and sets.  beginGet or beginSet starts the transaction
+   * and returns at once - then call poll from loop() until it stops returning
+   * MINGHE_STATUS_PENDING.  The frame gap, sending the request, decoding the
+   * reply as it arrives, and any backoff and retries all happen a step at a
+   * time inside poll, so the sketch keeps running while the frame is on the
+   * wire.  On a HardwareSerial, the request goes into its interrupt driven
+   * transmit buffer in one go.  A SoftwareSerial still holds the CPU for every
+   * bit it sends.
+   *
+   * One transaction at a time.  Both return false if one is already under way
+   * (see isBusy), or the unit is quarantined.  The blocking getters and
+   * setters finish the one under way before starting their own.
+   */
+  bool beginGet(const char command);
+  bool beginSet(const char command, const uint32_t value);
+  // MINGHE_STATUS_PENDING until the transaction is done, then how it went.
+  uint8_t poll(void);
+  bool isBusy() const { return async_state_ != MINGHE_ASYNC_IDLE; }
+  // The value read and status of the last transaction, once poll is done.
+  MingHeReading getAsyncReading() const;
+  // The command of the last transaction - not the one you started, if a
+  // blocking call has finished that and run its own since.
+  char getAsyncCommand() const { return async_command_; }
+
+  /**
+   * Command table access.  Every command the device knows has a descriptor
+   * (see MingHeCommandDescriptor), at an index from 0 to getCommandCount() - 1.
+   * Returns false / -1 for a command letter not in the table.
+   */
+  static uint8_t getCommandCount();
+  static bool getCommandDescriptor(const char command, 
+          MingHeCommandDescriptor *descriptor);
+  static int8_t getCommandIndex(const char command);
+  static char getCommandAt(const uint8_t index);
+
+#if MINGHE_ENABLE_SNAPSHOT
+  /**
+   * Read every readable value into a snapshot.  Returns true if every read
+   * worked - values that failed are marked as such and left out of diffs and
+   * applies.  So are values the protocol can't read, but they don't count as
+   * failures.  Where the protocol can read a block of values in one frame
+   * (Modbus), those all come from a single transaction.
+   */
+  bool takeSnapshot(MingHeSnapshot *snapshot);
+
+  /**
+   * Bitmask (by command index) of the values that differ between two
+   * snapshots, including values that one has and the other doesn't.
+   */
+  static uint32_t diffSnapshots(const MingHeSnapshot &a, 
+          const MingHeSnapshot &b);
+
+  // A value from a snapshot, or 0 if it's not there.
+  static uint32_t getSnapshotValue(const MingHeSnapshot &snapshot, 
+          const char command);
+
+  /**
+   * Write the settings in a snapshot back to the device, in command table
+   * order - so the limits are in place before the output is switched.  Pass
+   * the device's current snapshot to only write what differs.  Counters and
+   * read-only values are never written.  Returns true if every write verified.
+   */
+  bool applySnapshot(const MingHeSnapshot &target, 
+          const MingHeSnapshot *current = NULL);
+#endif
 
   // All voltages/currents are passed in as an integer, per the docs.
   // Voltage and current are times 100: 100 = 1V/1A, 1500 = 15V/A
 
-  uint16_t getMachineModel();
-  uint16_t getMaxVoltage();
-  uint16_t getMaxCurrent();
+  // Get the machine model - typically 6015, which means 60V max, 15A max.
+  uint16_t getMachineModel() { 
+    return (uint16_t)readValue(MINGHE_COMMAND_MACHINE_MODEL);
+  }
+  uint16_t getMaxVoltage() {
+    return (uint16_t)readValue(MINGHE_COMMAND_MAX_VOLTAGE);
+  }
+  uint16_t getMaxCurrent() {
+    return (uint16_t)readValue(MINGHE_COMMAND_MAX_CURRENT);
+  }
 
   // These report the actual voltage and current at the time of the command.
-  uint16_t getVoltage();
-  uint16_t getCurrent();
-  bool getOutputEnabled();
-  uint8_t getLimitingFactor();
-  uint32_t getWatts();
-  uint32_t getmAmpHours();
-  uint32_t getPowerOnTime();
-  uint16_t getTemperature();
-  uint16_t getShutdownTemperature();
-  uint16_t getFanStartTemperature();
-  bool getFastVoltageChangeEnabled();
-  bool getBootOutputEnabled();
-  bool getBeeperEnabled();
-  uint16_t getCommunicationVersion();
-  
-  bool setMaxVoltage(const uint16_t volts_100);
-  bool setMaxCurrent(const uint16_t amps_100);
-  bool setOutputEnabled(const bool enabled);
-  bool setmAmpHours(const uint32_t mamp_hours);
-  bool setShutdownTemperature(const uint8_t degrees_c);
-  bool setFanStartTemperature(const uint8_t degrees_c);
-  bool setPowerOnTime(const uint32_t seconds);
+  uint16_t getVoltage() { return (uint16_t)readValue(MINGHE_COMMAND_VOLTAGE); }
+  uint16_t getCurrent() { return (uint16_t)readValue(MINGHE_COMMAND_CURRENT); }
+  bool getOutputEnabled() {
+    return (bool)readValue(MINGHE_COMMAND_OUTPUT_STATE);
+  }
+  // One of the MINGHE_LIMITING_FACTOR_ values.
+  uint8_t getLimitingFactor() {
+    return (uint8_t)readValue(MINGHE_COMMAND_LIMITING_FACTOR);
+  }
+  uint32_t getWatts() { return readValue(MINGHE_COMMAND_WATTS); }
+  uint32_t getmAmpHours() { return readValue(MINGHE_COMMAND_MAMP_HOURS); }
+  // Output on time, in seconds.
+  uint32_t getPowerOnTime() { return readValue(MINGHE_COMMAND_RUNTIME); }
+  uint16_t getTemperature() {
+    return (uint16_t)readValue(MINGHE_COMMAND_TEMPERATURE);
+  }
+  uint16_t getShutdownTemperature() {
+    return (uint16_t)readValue(MINGHE_COMMAND_SHUTDOWN_TEMPERATURE);
+  }
+  uint16_t getFanStartTemperature() {
+    return (uint16_t)readValue(MINGHE_COMMAND_FAN_TEMPERATURE);
+  }
+  bool getFastVoltageChangeEnabled() {
+    return (bool)readValue(MINGHE_COMMAND_FAST_VOLTAGE_CHANGE);
+  }
+  bool getBootOutputEnabled() {
+    return (bool)readValue(MINGHE_COMMAND_BOOT_OUTPUT_ENABLED);
+  }
+  bool getBeeperEnabled() {
+    return (bool)readValue(MINGHE_COMMAND_BEEPER_ENABLED);
+  }
+  // Probably 22.
+  uint16_t getCommunicationVersion() {
+    return (uint16_t)readValue(MINGHE_COMMAND_COMMUNICATION_VERSION);
+  }
+
+  // The setters all set, then verify the new value took (see setVerified).
+  // Calling code should respond properly if they return false.
+  bool setMaxVoltage(const uint16_t volts_100) {
+    return setVerified(MINGHE_COMMAND_MAX_VOLTAGE, volts_100);
+  }
+  bool setMaxCurrent(const uint16_t amps_100) {
+    return setVerified(MINGHE_COMMAND_MAX_CURRENT, amps_100);
+  }
+  bool setOutputEnabled(const bool enabled) {
+    return setVerified(MINGHE_COMMAND_OUTPUT_STATE, enabled);
+  }
+  /**
+   * Move the device, and this end, to another baud rate.  True if they're
+   * both on it after; false if the device refused or couldn't be found there.
+   * If the check at the new rate fails, the device is looked for at the old
+   * and new rates, and this end is left on whichever answers - getBaudIndex
+   * says which.
+   */
   bool setBaudRate(const uint8_t baud_rate_index);
-  bool setAddress(const uint8_t new_address);
-  bool setBootOutputEnabled(const bool enabled);
-  bool setBeeperEnabled(const bool enabled);
-  bool setFastVoltageChangeEnabled(const bool enabled);
 
-  bool storeToMemory(const uint8_t slot);
-  bool loadFromMemory(const uint8_t slot);
+#if MINGHE_ENABLE_CONFIG_SETTERS
+  // mAh climbs between the set and the read - some slack is allowed.
+  bool setmAmpHours(const uint32_t mamp_hours) {
+    return setVerified(MINGHE_COMMAND_MAMP_HOURS, mamp_hours);
+  }
+  bool setShutdownTemperature(const uint8_t degrees_c) {
+    return setVerified(MINGHE_COMMAND_SHUTDOWN_TEMPERATURE, degrees_c);
+  }
+  bool setFanStartTemperature(const uint8_t degrees_c) {
+    return setVerified(MINGHE_COMMAND_FAN_TEMPERATURE, degrees_c);
+  }
+  // As with mAh, a few seconds difference is allowed.
+  bool setPowerOnTime(const uint32_t seconds) {
+    return setVerified(MINGHE_COMMAND_RUNTIME, seconds);
+  }
+  // You'll need to call resetDeviceId after this.
+  bool setAddress(const uint8_t new_address) {
+    return setVerified(MINGHE_COMMAND_ADDRESS, new_address);
+  }
+  bool setBootOutputEnabled(const bool enabled) {
+    return setVerified(MINGHE_COMMAND_BOOT_OUTPUT_ENABLED, enabled);
+  }
+  bool setBeeperEnabled(const bool enabled) {
+    return setVerified(MINGHE_COMMAND_BEEPER_ENABLED, enabled);
+  }
+  bool setFastVoltageChangeEnabled(const bool enabled) {
+    return setVerified(MINGHE_COMMAND_FAST_VOLTAGE_CHANGE, enabled);
+  }
+#endif
+
+#if MINGHE_ENABLE_MEMORY
+  // Store the current voltage/current limits to a memory slot, or load them.
+  bool storeToMemory(const uint8_t slot) {
+    return setVerified(MINGHE_COMMAND_STORE_TO_MEMORY, slot);
+  }
+  bool loadFromMemory(const uint8_t slot) {
+    return setVerified(MINGHE_COMMAND_LOAD_FROM_MEMORY, slot);
+  }
+#endif
   
 private:
   /**
    * sendRequest transmits data to the device for execution.
    * @param set True if this is a set command (s), false for read (r).
    * @param command The command letter to use.
-   * @param value A null terminated string of the value sequence to send.
+   * @param value The value to send with a set.  Ignored for a read.
    */
-  void sendRequest(const bool set, const char command, const char *value);
+  void sendRequest(const bool set, const char command, const uint32_t value);
 
-  // Send a character, copy it to the checksum instance.
-  void sendSerialChar(const char c);
+#if MINGHE_ENABLE_RS485
+  // Take a byte of the echo of the request.
+  uint8_t takeEcho(const uint8_t c);
+#endif
+  // True until the first byte back has arrived.
+  bool waitingForStart(void) const;
 
-  /**
-   * Read a response from the serial bus.  Will spin until it sees a ':' at the 
-   * start.
-   * @param set True if this is reading a set (s), false for a read (r) byte.
-   * @param command The expected command byte.
-   * @param value A properly sized array for the response.
-   */
-  bool readResponse(const bool set, const char command, char *value);
+  // Sleep until the next interrupt (if low power waiting is on), or wait.
+  void idle(void);
+  void waitMs(const uint32_t wait_ms);
+
+  // Discard anything waiting in the receive buffer.
+  void drainInput(void);
+  // Switch this end to a baud rate, and check the device answers there.
+  bool probeBaudRate(const uint8_t baud_rate_index);
+
+  // Add an attempt to the stats.
+  void countAttempt(const uint8_t status);
 
-  bool checkForOk(void);
+  // Frame gap bookkeeping.
+  void markFrameEnd(const bool set, const uint16_t trailer_us = 0);
+  bool frameGapElapsed(const bool set) const;
+  void loadFrameGapsForBaud(void);
 
-  bool readResponseIntoBuffer(char *buffer, const byte buffer_length);
+  // Return true, with backoff_ms_ set, if another attempt should be made.
+  bool shouldRetry(const uint8_t status);
 
-  // Read a character off the software serial, or return 0 if the timeout is hit.
-  char readCharUntilTimeout(const uint32_t timeout_millis_value);
+  // Non-blocking transaction steps.  See poll.
+  bool beginAsync(const bool set, const char command, const uint32_t value);
+  uint8_t finishAttempt(const uint8_t status);
+  uint8_t finishPending(void);
 
-  void swallowNewlines(const uint32_t timeout_ms);
+#if MINGHE_ENABLE_MODEL_PROFILES
+  // Check a request against the model profile, clamping the value if that's
+  // the policy.  MINGHE_STATUS_OK if it can go out.
+  uint8_t checkRequest(const bool set, const char command,
+          uint32_t *value) const;
+#endif
 
-  uint32_t executeGetCommand(const char command);
+#if MINGHE_ENABLE_CALIBRATION
+  // Where a command's table pointer lives, or -1 if it can't have one.
+  static int8_t calibrationIndex(const char command);
+#endif
+  // A value from the device corrected, and a value for it made ready, by the
+  // command's calibration table.  Unchanged without one.
+  uint32_t fromDevice(const char command, const uint32_t value) const;
+  uint32_t toDevice(const char command, const uint32_t value) const;
+
+  // Start a transaction.  Returns false if the unit is quarantined and not due
+  // for a probe, in which case nothing should be sent.
+  bool beginTransaction(const char command);
+  // Record how a transaction went, for quarantine tracking.
+  void endTransaction(const uint8_t status);
+
+  MingHeReading executeGetCommand(const char command);
+  // Just the value - 0 on failure, see getLastStatus.
+  uint32_t readValue(const char command);
   bool executeSetCommand(const char command, const uint32_t value);
 
+  // Setup shared by the constructors.
+  void init();
+
   // SoftwareSerial interface - created on startup, deleted on destruction.
+  // NULL if the caller handed in their own stream.
   SoftwareSerial *swserial_;
-  MingHeBuckConverterChecksum checksum_;
+
+  // The stream all traffic goes over.  Either swserial_ or the caller's.
+  Stream *stream_;
+
+  // The protocol in use - ascii_protocol_, unless setProtocol says otherwise.
+  MingHeProtocol *protocol_;
+  MingHeAsciiProtocol ascii_protocol_;
 
   // Device ID (01-99).  Stored for later use.
   uint8_t device_id_;
+
+  // Current MINGHE_BAUD_ index of the link.
+  uint8_t baud_index_;
+  MingHeBaudRateCallback baud_rate_callback_;
+
+#if MINGHE_ENABLE_STATS
+  MingHeStats stats_;
+#endif
+
+#if MINGHE_ENABLE_RS485
+  // RS-485 settings, and the length, first byte and LRC of the request in
+  // flight so its echo can be recognised.  Then how much of the echo is in,
+  // junk skipped ahead of it, and what it adds up to.
+  uint8_t driver_enable_pin_;
+  bool echo_suppression_;
+  uint8_t echo_length_;
+  uint8_t echo_start_;
+  MingHeBuckConverterChecksum echo_checksum_;
+  uint8_t echo_received_;
+  uint8_t echo_junk_;
+  MingHeBuckConverterChecksum echo_received_checksum_;
+#endif
+
+#if MINGHE_ENABLE_LOW_POWER
+  bool low_power_wait_;
+#endif
+
+  MingHeFrameGaps frame_gaps_;
+  const MingHeFrameGaps *frame_gap_table_;
+  // The line's last frame - own_line_, unless the line is shared.
+  MingHeLineState own_line_;
+  MingHeLineState *line_;
+
+  MingHeRetryPolicy retry_policy_;
+  // When the current transaction started, and the timing that applies to it.
+  uint32_t transaction_start_ms_;
+  uint16_t response_timeout_ms_;
+  uint8_t transaction_attempts_;
+  uint16_t transaction_deadline_ms_;
+  uint16_t transaction_settle_ms_;
+  // Extra quiet time owed after the last frame.
+  uint16_t settle_ms_;
+
+  const MingHeCommandTiming *command_timing_table_;
+  uint8_t command_timing_count_;
+  uint8_t last_status_;
+
+  // The transaction under way: what it is, where it's at, and when it got
+  // there (or when the last byte of the reply arrived).
+  uint8_t async_state_;
+  bool async_set_;
+  char async_command_;
+  uint32_t async_value_;
+  uint8_t attempts_made_;
+  uint32_t state_start_ms_;
+  uint32_t backoff_ms_;
+  // Time the request takes on the wire, on top of the response timeout.
+  uint16_t transmit_ms_;
+
+#if MINGHE_ENABLE_MODEL_PROFILES
+  MingHeModelProfile model_profile_;
+  bool has_model_profile_;
+  uint8_t range_policy_;
+#endif
+
+#if MINGHE_ENABLE_CALIBRATION
+  // Limits, then readings.
+  const MingHeCalibration *calibration_[MINGHE_CALIBRATION_COMMANDS];
+#endif
+
+#if MINGHE_ENABLE_QUARANTINE
+  // Quarantine settings and state.
+  uint8_t quarantine_threshold_;
+  uint32_t min_probe_ms_, max_probe_ms_;
+  uint8_t consecutive_failures_;
+  bool quarantined_;
+  uint32_t probe_interval_ms_;
+  uint32_t quarantine_start_ms_;
+#endif
 };
 
 #endif // __MING_HE_BUCK_CONVERTER_H__
@@ -0,0 +1,73 @@
+/*
+ * Round-robin scheduling of several MingHe converters sharing one serial bus.
+ * See the header for details.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#include "MingHeBus.h"
+
+MingHeBus::MingHeBus() {
+  unit_count_ = 0;
+  cursor_ = 0;
+  line_.last_frame_end_us = micros();
+  line_.last_frame_trailer_us = 0;
+  line_.last_frame_was_set = false;
+}
+
+bool MingHeBus::addUnit(MingHeBuckConverter *unit) {
+  if (unit_count_ >= MINGHE_BUS_MAX_UNITS) {
+    return false;
+  }
+  units_[unit_count_++] = unit;
+  unit->setLineState(&line_);
+  return true;
+}
+
+MingHeBuckConverter *MingHeBus::getUnit(const uint8_t index) const {
+  if (index >= unit_count_) {
+    return NULL;
+  }
+  return units_[index];
+}
+
+MingHeBuckConverter *MingHeBus::findUnit(const uint8_t device_id) const {
+  for (uint8_t i = 0; i < unit_count_; i++) {
+    if (units_[i]->getDeviceId() == device_id) {
+      return units_[i];
+    }
+  }
+  return NULL;
+}
+
+uint8_t MingHeBus::getHealthyCount() const {
+  uint8_t healthy = 0;
+
+  for (uint8_t i = 0; i < unit_count_; i++) {
+    if (!units_[i]->isQuarantined()) {
+      healthy++;
+    }
+  }
+  return healthy;
+}
+
+// Walk once around the ring from the last unit handed out, taking the first
+// one that is either healthy or due a probe.
+MingHeBuckConverter *MingHeBus::next() {
+  for (uint8_t i = 0; i < unit_count_; i++) {
+    cursor_++;
+    if (cursor_ >= unit_count_) {
+      cursor_ = 0;
+    }
+    if (!units_[cursor_]->isQuarantined() || units_[cursor_]->isProbeDue()) {
+      return units_[cursor_];
+    }
+  }
+  return NULL;
+}
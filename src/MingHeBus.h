@@ -0,0 +1,63 @@
+/*
+ * Round-robin scheduling of several MingHe converters sharing one serial bus.
+ * Each unit is its own MingHeBuckConverter (one per address), all talking over
+ * the same Stream.  The bus hands them out in turn, skipping any unit that is
+ * quarantined and not yet due for a probe, so one dead converter doesn't stall
+ * polling of the rest.
+ *
+ * Units added to a bus share its line state, so the frame gap is timed from
+ * the last frame any of them saw.  Otherwise the next unit may start talking
+ * while the last one's reply is still trailing out.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#ifndef __MING_HE_BUS_H__
+#define __MING_HE_BUS_H__
+
+#include "MingHeBuckConverter.h"
+
+// Units per bus.  Each slot costs a pointer of SRAM.
+#define MINGHE_BUS_MAX_UNITS 16
+
+class MingHeBus {
+public:
+  MingHeBus();
+
+  // Add a unit to the rotation.  Returns false if the bus is full.
+  bool addUnit(MingHeBuckConverter *unit);
+
+  /**
+   * The next unit to poll, or NULL if every unit is quarantined and none is
+   * due for a probe.  A unit due for a probe is handed out like any other -
+   * whatever the caller does with it is the probe.
+   */
+  MingHeBuckConverter *next();
+
+  uint8_t getUnitCount() const { return unit_count_; }
+  MingHeBuckConverter *getUnit(const uint8_t index) const;
+  // Find a unit by device address, or NULL.
+  MingHeBuckConverter *findUnit(const uint8_t device_id) const;
+
+  // Number of units not in quarantine.
+  uint8_t getHealthyCount() const;
+
+  // For a converter that uses the line without being on the bus - a
+  // discovery scan, say - to share the line state.
+  MingHeLineState *getLineState() { return &line_; }
+
+private:
+  MingHeBuckConverter *units_[MINGHE_BUS_MAX_UNITS];
+  uint8_t unit_count_;
+  // Index of the unit handed out last.
+  uint8_t cursor_;
+  MingHeLineState line_;
+};
+
+#endif // __MING_HE_BUS_H__
@@ -0,0 +1,102 @@
+/*
+ * Calibration tables.  See MingHeCalibration.h.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#include "MingHeCalibration.h"
+
+// rise/run in 1/32768ths, rounded, or 0 if it won't fit in 16 bits.
+static uint16_t slope(const int32_t rise, const int32_t run) {
+  int32_t scaled = (rise * MINGHE_CALIBRATION_ONE + run / 2) / run;
+
+  return (scaled > 0xFFFF) ? 0 : (uint16_t)scaled;
+}
+
+bool MingHeCalibration::fromPoints(const MingHeCalibrationPoint *points,
+        const uint8_t points_count) {
+  MingHeCalibrationSegment built[MINGHE_CALIBRATION_SEGMENTS];
+  int32_t run, rise;
+
+  if ((points_count < 2) || (points_count > MINGHE_CALIBRATION_SEGMENTS + 1)) {
+    return false;
+  }
+  for (uint8_t i = 0; i < points_count - 1; i++) {
+    if ((points[i + 1].device > 0x7FFF) || (points[i + 1].actual > 0x7FFF)) {
+      return false;
+    }
+    run = (int32_t)points[i + 1].device - points[i].device;
+    rise = (int32_t)points[i + 1].actual - points[i].actual;
+    if ((run <= 0) || (rise <= 0)) {
+      return false;
+    }
+    built[i].device = points[i].device;
+    built[i].actual = points[i].actual;
+    built[i].gain = slope(rise, run);
+    built[i].inverse = slope(run, rise);
+    if (!built[i].gain || !built[i].inverse) {
+      return false;
+    }
+  }
+
+  count = points_count - 1;
+  memcpy(segments, built, count * sizeof(built[0]));
+  return true;
+}
+
+/*
+ * Take value from one side of the table to the other: from the start of the
+ * last segment that starts at or below it, at that segment's slope.  The
+ * distance is kept to 15 bits so the product fits in 32.
+ */
+static uint16_t convert(const int32_t value, const int32_t from_start,
+        const int32_t to_start, const uint16_t slope) {
+  int32_t distance = value - from_start, result;
+
+  if (distance > 0x7FFF) {
+    distance = 0x7FFF;
+  } else if (distance < -0x7FFF) {
+    distance = -0x7FFF;
+  }
+  result = to_start + ((distance * slope + MINGHE_CALIBRATION_ONE / 2) >>
+          MINGHE_CALIBRATION_SHIFT);
+
+  if (result < 0) {
+    return 0;
+  }
+  return (result > 0xFFFF) ? 0xFFFF : (uint16_t)result;
+}
+
+uint16_t MingHeCalibration::toActual(const uint16_t device) const {
+  uint8_t i;
+
+  if (!count) {
+    return device;
+  }
+  i = count - 1;
+  while (i && ((int32_t)device < segments[i].device)) {
+    i--;
+  }
+  return convert(device, segments[i].device, segments[i].actual,
+          segments[i].gain);
+}
+
+uint16_t MingHeCalibration::toDevice(const uint16_t actual) const {
+  uint8_t i;
+
+  if (!count) {
+    return actual;
+  }
+  i = count - 1;
+  while (i && ((int32_t)actual < segments[i].actual)) {
+    i--;
+  }
+  return convert(actual, segments[i].actual, segments[i].device,
+          segments[i].inverse);
+}
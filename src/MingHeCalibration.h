@@ -0,0 +1,79 @@
+/*
+ * Calibration tables: what a converter says (or is told) against what a
+ * reference meter shows.  Units are rarely more than a few percent off, but a
+ * few percent is 1.8V at 60V.
+ *
+ * A table is a gain and offset, or up to MINGHE_CALIBRATION_SEGMENTS straight
+ * segments through measured points.  Each segment keeps its start point and
+ * both slopes, worked out ahead of time in fixed point - 1/32768ths - so that
+ * correcting a value either way is a multiply, a shift and an add, with no
+ * floats and no divides.  Slopes have to be between 0.5 and 2, and values
+ * under 32768 counts, which is plenty for volts and amps in hundredths.
+ *
+ * Build tables on the device from measured points with fromPoints, or on a
+ * host with extras/calibrate.py, which fits them from a CSV of readings and
+ * writes them out as C initializers:
+ *
+ *   const MingHeCalibration calibration_7_voltage = {1, {
+ *     {0, -4, 32932, 32605},
+ *   }};
+ *
+ * See MingHeBuckConverter::setCalibration for where they are applied.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#ifndef __MING_HE_CALIBRATION_H__
+#define __MING_HE_CALIBRATION_H__
+
+#include <Arduino.h>
+
+#define MINGHE_CALIBRATION_SEGMENTS 4
+// A slope of 1, and the shift that goes with it.
+#define MINGHE_CALIBRATION_ONE 32768L
+#define MINGHE_CALIBRATION_SHIFT 15
+
+// A measured point: the device's value, and the reference meter's.  Both in
+// the device's counts - hundredths of a volt or amp.
+struct MingHeCalibrationPoint {
+  uint16_t device;
+  uint16_t actual;
+};
+
+struct MingHeCalibrationSegment {
+  // Where the segment starts, as the device has it and as it really is.
+  int16_t device;
+  int16_t actual;
+  // Actual counts per device count, and the other way, in 1/32768ths.
+  uint16_t gain;
+  uint16_t inverse;
+};
+
+struct MingHeCalibration {
+  // Segments in use, in order.  Each covers from its start to the next one's,
+  // and the first and last carry on past the ends.
+  uint8_t count;
+  MingHeCalibrationSegment segments[MINGHE_CALIBRATION_SEGMENTS];
+
+  /**
+   * Build the table through points, in increasing order, 2 to
+   * MINGHE_CALIBRATION_SEGMENTS + 1 of them.  Two points is a plain gain and
+   * offset.  False, with the table left alone, if the points go backwards or
+   * a slope is out of range.
+   */
+  bool fromPoints(const MingHeCalibrationPoint *points,
+          const uint8_t points_count);
+
+  // A device value (a reading, or a limit read back) corrected, and a true
+  // value turned into what to send the device for it.
+  uint16_t toActual(const uint16_t device) const;
+  uint16_t toDevice(const uint16_t actual) const;
+};
+
+#endif // __MING_HE_CALIBRATION_H__
@@ -0,0 +1,83 @@
+/*
+ * Build time feature switches for the MingHe driver.  Everything is on by
+ * default.  On a small part (ATtiny and friends) that only needs to set the
+ * limits and switch the output, turn off what you don't use and it is compiled
+ * out entirely - not just left unreferenced.
+ *
+ * The Arduino IDE doesn't pass a sketch's #defines on to libraries, so either
+ * edit the defaults here, or set them as build flags, e.g. with arduino-cli:
+ *
+ *   --build-property "compiler.cpp.extra_flags=-DMINGHE_ENABLE_STATS=0"
+ *
+ * extras/size_report.sh builds a sketch with a few combinations and prints
+ * the flash and RAM use of each.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#ifndef __MING_HE_CONFIG_H__
+#define __MING_HE_CONFIG_H__
+
+// storeToMemory and loadFromMemory.
+#ifndef MINGHE_ENABLE_MEMORY
+#define MINGHE_ENABLE_MEMORY 1
+#endif
+
+/*
+ * Setters for things that are normally set up once, on the bench: the
+ * temperature limits, beeper, boot output, fast voltage change, the mAh and
+ * power on time counters, and the device address.  The limit and output
+ * setters are always there.
+ */
+#ifndef MINGHE_ENABLE_CONFIG_SETTERS
+#define MINGHE_ENABLE_CONFIG_SETTERS 1
+#endif
+
+// Check the LRC of responses.  Without it, a corrupted reply is taken as is -
+// only turn this off on a short, clean link.
+#ifndef MINGHE_ENABLE_RX_CHECKSUM
+#define MINGHE_ENABLE_RX_CHECKSUM 1
+#endif
+
+// Snapshots: takeSnapshot, diffSnapshots, applySnapshot.
+#ifndef MINGHE_ENABLE_SNAPSHOT
+#define MINGHE_ENABLE_SNAPSHOT 1
+#endif
+
+// Link statistics (getStats).  MingHeLinkTuner needs them.
+#ifndef MINGHE_ENABLE_STATS
+#define MINGHE_ENABLE_STATS 1
+#endif
+
+// Quarantine of dead units.  With this off, isQuarantined is always false.
+#ifndef MINGHE_ENABLE_QUARANTINE
+#define MINGHE_ENABLE_QUARANTINE 1
+#endif
+
+// RS-485 transceiver pin and echo suppression.
+#ifndef MINGHE_ENABLE_RS485
+#define MINGHE_ENABLE_RS485 1
+#endif
+
+// Model profiles and the range checks that go with them (setModelProfile).
+#ifndef MINGHE_ENABLE_MODEL_PROFILES
+#define MINGHE_ENABLE_MODEL_PROFILES 1
+#endif
+
+// Calibration tables on the limits and readings (setCalibration).
+#ifndef MINGHE_ENABLE_CALIBRATION
+#define MINGHE_ENABLE_CALIBRATION 1
+#endif
+
+// Idle mode sleep while waiting on the device (setLowPowerWait).
+#ifndef MINGHE_ENABLE_LOW_POWER
+#define MINGHE_ENABLE_LOW_POWER 1
+#endif
+
+#endif // __MING_HE_CONFIG_H__
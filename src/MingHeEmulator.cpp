@@ -0,0 +1,690 @@
+/*
+ * Software emulation of a MingHe buck converter, with fault injection.  See the
+ * header for details.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#include "MingHeEmulator.h"
+#include "MingHeModbus.h"
+
+// What the emulated unit reports for its input supply, in volts * 100.
+#define MINGHE_EMULATOR_INPUT_VOLTAGE 2400
+
+MingHeEmulator::MingHeEmulator(const uint8_t device_id,
+        const uint16_t machine_model) {
+  memset(&profile_, 0, sizeof(profile_));
+  resetCounters();
+
+  rx_length_ = 0;
+  tx_head_ = tx_tail_ = tx_gate_ = 0;
+  tx_ready_us_ = tx_gate_us_ = 0;
+  stuck_err_remaining_ = 0;
+  deaf_remaining_ = 0;
+  echo_ = false;
+  modbus_ = false;
+  plant_ = NULL;
+  memset(&minimum_gaps_, 0, sizeof(minimum_gaps_));
+  last_response_start_us_ = last_response_end_us_ = 0;
+  last_was_set_ = false;
+  has_responded_ = false;
+  setBaudRate(9600);
+
+  // Power-on defaults, roughly what a unit out of the box reports.
+  device_id_ = device_id;
+  machine_model_ = machine_model;
+  max_voltage_ = 500;
+  max_current_ = 100;
+  output_enabled_ = false;
+  mamp_hours_ = 0;
+  power_on_time_ = 0;
+  temperature_ = 25;
+  shutdown_temperature_ = 80;
+  fan_start_temperature_ = 40;
+  fast_voltage_change_ = false;
+  boot_output_ = false;
+  beeper_ = true;
+  baud_index_ = MINGHE_BAUD_9600;
+  memset(memory_voltage_, 0, sizeof(memory_voltage_));
+  memset(memory_current_, 0, sizeof(memory_current_));
+}
+
+void MingHeEmulator::setFaultProfile(const MingHeFaultProfile &profile) {
+  profile_ = profile;
+  stuck_err_remaining_ = 0;
+  deaf_remaining_ = 0;
+}
+
+void MingHeEmulator::setBaudRate(const uint32_t baud_rate) {
+  line_baud_rate_ = baud_rate;
+  // 8N1 is 10 bits per character.
+  char_time_us_ = (uint16_t)(10000000UL / baud_rate);
+}
+
+void MingHeEmulator::setMinimumGaps(const MingHeFrameGaps &gaps) {
+  minimum_gaps_ = gaps;
+}
+
+void MingHeEmulator::resetCounters(void) {
+  memset(&counters_, 0, sizeof(counters_));
+}
+
+bool MingHeEmulator::roll(const uint16_t permille) {
+  if (!permille) {
+    return false;
+  }
+  return (random(1000) < permille);
+}
+
+// How many of limit bytes, starting at start_us, have been fully received by
+// now - a byte is only readable once its stop bit is in.
+uint8_t MingHeEmulator::pacedBytes(const uint32_t start_us, 
+        const uint8_t limit) {
+  uint32_t elapsed = micros() - start_us;
+
+  // Signed check handles the start time still being in the future.
+  if ((int32_t)elapsed < 0) {
+    return 0;
+  }
+  elapsed = elapsed / char_time_us_;
+  if (elapsed < limit) {
+    return (uint8_t)elapsed;
+  }
+  return limit;
+}
+
+/*
+ * Bytes come off the wire one character time apart, starting at tx_ready_us_.
+ * If a newer response was queued behind bytes the driver has not read yet, it
+ * starts at tx_gate_ and is held back until tx_gate_us_.  Anything queued but
+ * not yet "sent" is invisible to the driver.
+ */
+uint8_t MingHeEmulator::releasedBytes(void) {
+  uint8_t released;
+
+  if (tx_gate_ <= tx_head_) {
+    return pacedBytes(tx_ready_us_, tx_tail_ - tx_head_);
+  }
+
+  released = pacedBytes(tx_ready_us_, tx_gate_ - tx_head_);
+  if (released < tx_gate_ - tx_head_) {
+    return released;
+  }
+  return released + pacedBytes(tx_gate_us_, tx_tail_ - tx_gate_);
+}
+
+int MingHeEmulator::available(void) {
+  return releasedBytes();
+}
+
+int MingHeEmulator::peek(void) {
+  if (!releasedBytes()) {
+    return -1;
+  }
+  return tx_buffer_[tx_head_];
+}
+
+int MingHeEmulator::read(void) {
+  char c;
+
+  if (!releasedBytes()) {
+    return -1;
+  }
+  c = tx_buffer_[tx_head_++];
+  // The next byte is on the wire one character time later.
+  tx_ready_us_ += char_time_us_;
+
+  // Crossing into the newer response picks up its start time.
+  if (tx_head_ == tx_gate_) {
+    if ((int32_t)(tx_gate_us_ - tx_ready_us_) > 0) {
+      tx_ready_us_ = tx_gate_us_;
+    }
+    tx_gate_ = 0;
+  }
+
+  // Once drained, start again at the front of the buffer.
+  if (tx_head_ == tx_tail_) {
+    tx_head_ = tx_tail_ = tx_gate_ = 0;
+  }
+  return c;
+}
+
+void MingHeEmulator::flush(void) {
+  // Nothing is buffered on the way in.
+}
+
+size_t MingHeEmulator::write(uint8_t c) {
+  // A half-duplex bus with the receiver left on hears itself.
+  if (echo_ && (tx_tail_ < MINGHE_EMULATOR_TX_BUFFER)) {
+    if (tx_head_ == tx_tail_) {
+      tx_ready_us_ = micros();
+    }
+    tx_buffer_[tx_tail_++] = c;
+  }
+
+  // Modbus requests (reads and single register writes) are all 8 bytes.
+  if (modbus_) {
+    rx_buffer_[rx_length_++] = c;
+    if (rx_length_ == 8) {
+      processModbusRequest();
+      rx_length_ = 0;
+    }
+    return 1;
+  }
+
+  if (c == '\n') {
+    processRequest();
+    rx_length_ = 0;
+    return 1;
+  }
+
+  // Overlong requests are junk - keep the tail end so the next ':' resyncs.
+  if (rx_length_ >= MINGHE_EMULATOR_RX_BUFFER) {
+    rx_length_ = 0;
+  }
+  // A ':' always starts a new frame.
+  if (c == ':') {
+    rx_length_ = 0;
+  }
+  rx_buffer_[rx_length_++] = c;
+  return 1;
+}
+
+void MingHeEmulator::queueByte(const char c) {
+  if (roll(profile_.drop_permille)) {
+    counters_.dropped_bytes++;
+    return;
+  }
+  if (tx_tail_ < MINGHE_EMULATOR_TX_BUFFER) {
+    tx_buffer_[tx_tail_++] = c;
+  }
+}
+
+void MingHeEmulator::queueFrame(const uint8_t device_id, const char *body) {
+  char frame[MINGHE_EMULATOR_RX_BUFFER];
+  uint8_t length = 0;
+
+  frame[length++] = ':';
+  frame[length++] = '0' + (device_id / 10);
+  frame[length++] = '0' + (device_id % 10);
+  while (*body && (length < sizeof(frame) - 1)) {
+    frame[length++] = *body++;
+  }
+
+  checksum_.reset();
+  for (uint8_t i = 0; i < length; i++) {
+    checksum_.addOutputCharacter(frame[i]);
+  }
+  frame[length++] = checksum_.getChecksumCharacter();
+
+  // Flip one bit somewhere between the ':' and the LRC.  Any single bit flip
+  // moves the byte sum by a power of two, which is never a multiple of 26, so
+  // the frame is always rejected - but not always as a checksum error.  A flip
+  // that makes a body byte an uppercase letter has it taken for an early LRC
+  // (a bad response), and one in the address reads as another unit's frame.
+  if (roll(profile_.flip_permille)) {
+    frame[1 + random(length - 2)] ^= (1 << random(7));
+    counters_.flipped_frames++;
+  }
+
+  for (uint8_t i = 0; i < length; i++) {
+    queueByte(frame[i]);
+  }
+  queueByte('\r');
+  queueByte('\n');
+}
+
+/*
+ * A request is ":AAxC<value>L" - address, r or s, the command, an optional
+ * value, and the LRC.  Bad frames and frames for other addresses are silently
+ * ignored, like the real hardware does.
+ */
+void MingHeEmulator::processRequest(void) {
+  char body[14];
+  uint32_t value = 0;
+  uint8_t length = rx_length_;
+  bool set;
+  char command;
+
+  counters_.requests++;
+
+  // Tolerate a CR before the LF.
+  if (length && rx_buffer_[length - 1] == '\r') {
+    length--;
+  }
+
+  if (missed()) {
+    return;
+  }
+
+  // Minimum frame is ":01rzX".
+  if ((length < 6) || (rx_buffer_[0] != ':')) {
+    counters_.ignored_requests++;
+    return;
+  }
+
+  checksum_.reset();
+  for (uint8_t i = 0; i < length - 1; i++) {
+    checksum_.addOutputCharacter(rx_buffer_[i]);
+  }
+  if (rx_buffer_[length - 1] != checksum_.getChecksumCharacter()) {
+    counters_.ignored_requests++;
+    return;
+  }
+
+  if (!isdigit(rx_buffer_[1]) || !isdigit(rx_buffer_[2]) ||
+          ((rx_buffer_[1] - '0') * 10 + (rx_buffer_[2] - '0') != device_id_)) {
+    counters_.ignored_requests++;
+    return;
+  }
+
+  set = (rx_buffer_[3] == 's');
+  command = rx_buffer_[4];
+
+  if (tooSoon(set)) {
+    return;
+  }
+  for (uint8_t i = 5; i < length - 1; i++) {
+    value = (value * 10) + (rx_buffer_[i] - '0');
+  }
+
+  updatePlant();
+  scheduleResponse();
+
+  // Another unit on the bus chatters first.
+  if (roll(profile_.spurious_permille)) {
+    queueFrame((device_id_ % 99) + 1, "rv1234");
+    counters_.spurious_frames++;
+  }
+
+  if (stuckErr()) {
+    strcpy(body, "err");
+  } else if (set) {
+    strcpy(body, writeRegister(command, value) ? "ok" : "err");
+  } else if (readRegister(command, &value)) {
+    body[0] = 'r';
+    body[1] = command;
+    ultoa(value, body + 2, 10);
+  } else {
+    strcpy(body, "err");
+  }
+
+  if (body[0] == 'e') {
+    counters_.err_replies++;
+  }
+  counters_.responses++;
+  queueFrame(device_id_, body);
+  markResponseEnd();
+}
+
+/*
+ * If the line and the device disagree on baud rate, all the device sees is
+ * garbage.  And after a switch, it may not be listening again straight away.
+ */
+bool MingHeEmulator::missed(void) {
+  if (line_baud_rate_ != MingHeBuckConverter::baudRateFromIndex(baud_index_)) {
+    counters_.ignored_requests++;
+    return true;
+  }
+  if (deaf_remaining_) {
+    deaf_remaining_--;
+    counters_.ignored_requests++;
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Too soon after the last response - the device isn't listening yet.  The
+ * response may even still be going out, so the difference can be negative.
+ */
+bool MingHeEmulator::tooSoon(const bool set) {
+  if (has_responded_ && ((int32_t)(micros() - last_response_end_us_) < 
+          (int32_t)minimum_gaps_.gap_us[last_was_set_][set])) {
+    counters_.ignored_requests++;
+    counters_.gap_violations++;
+    return true;
+  }
+  last_was_set_ = set;
+  return false;
+}
+
+// Work out when the response starts going out on the wire, and make room for
+// it.
+void MingHeEmulator::scheduleResponse(void) {
+  uint32_t delay_ms;
+
+  if (roll(profile_.tail_permille)) {
+    delay_ms = profile_.tail_delay_ms;
+    counters_.tail_delays++;
+  } else {
+    delay_ms = profile_.min_delay_ms;
+    if (profile_.max_delay_ms > profile_.min_delay_ms) {
+      delay_ms += random(profile_.max_delay_ms - profile_.min_delay_ms + 1);
+    }
+  }
+  // Slide anything unread to the front to make room.
+  if (tx_head_) {
+    memmove(tx_buffer_, tx_buffer_ + tx_head_, tx_tail_ - tx_head_);
+    tx_tail_ -= tx_head_;
+    tx_gate_ = (tx_gate_ > tx_head_) ? (tx_gate_ - tx_head_) : 0;
+    tx_head_ = 0;
+  }
+
+  // If unread bytes are still queued, this response goes in behind them with
+  // its own start time.
+  if (tx_head_ == tx_tail_) {
+    tx_ready_us_ = micros() + (delay_ms * 1000);
+  } else {
+    tx_gate_ = tx_tail_;
+    tx_gate_us_ = micros() + (delay_ms * 1000);
+  }
+}
+
+// True if the device is stuck answering everything with an error.
+bool MingHeEmulator::stuckErr(void) {
+  if (!stuck_err_remaining_ && roll(profile_.stuck_err_permille)) {
+    stuck_err_remaining_ = profile_.stuck_err_frames;
+  }
+  if (stuck_err_remaining_) {
+    stuck_err_remaining_--;
+    return true;
+  }
+  return false;
+}
+
+// The last byte is on the wire a character time per queued byte after the
+// response starts going out.
+void MingHeEmulator::markResponseEnd(void) {
+  has_responded_ = true;
+  if (tx_gate_ > tx_head_) {
+    last_response_start_us_ = tx_gate_us_;
+    last_response_end_us_ = tx_gate_us_ + 
+            (uint32_t)(tx_tail_ - tx_gate_) * char_time_us_;
+  } else {
+    last_response_start_us_ = tx_ready_us_;
+    last_response_end_us_ = tx_ready_us_ + 
+            (uint32_t)(tx_tail_ - tx_head_) * char_time_us_;
+  }
+}
+
+bool MingHeEmulator::isTransmitting(void) const {
+  uint32_t now_us = micros();
+
+  return has_responded_ && ((int32_t)(now_us - last_response_start_us_) >= 0) &&
+          ((int32_t)(now_us - last_response_end_us_) < 0);
+}
+
+// Queue a Modbus frame, adding the CRC, and maybe flipping a bit - which the
+// CRC always catches.
+void MingHeEmulator::queueModbusFrame(uint8_t *frame, uint8_t length) {
+  uint16_t crc = 0xFFFF;
+
+  for (uint8_t i = 0; i < length; i++) {
+    crc = MingHeModbus::updateCrc(crc, frame[i]);
+  }
+  frame[length++] = crc & 0xFF;
+  frame[length++] = crc >> 8;
+
+  if (roll(profile_.flip_permille)) {
+    frame[random(length)] ^= (1 << random(8));
+    counters_.flipped_frames++;
+  }
+
+  for (uint8_t i = 0; i < length; i++) {
+    queueByte(frame[i]);
+  }
+}
+
+/*
+ * A Modbus request is the address, function (0x03 read, 0x06 write), register
+ * and count or value, and CRC.  Bad frames and other addresses are ignored.
+ * Requests the device can't carry out get an exception response: 0x01 for an
+ * unknown function, 0x02 for registers it doesn't have, 0x03 for a value it
+ * won't take, and 0x04 while it's stuck.
+ */
+void MingHeEmulator::processModbusRequest(void) {
+  uint8_t response[MINGHE_MODBUS_BLOCK_REGISTERS * 2 + 5];
+  uint8_t length = 0, function, reg, exception = 0;
+  uint16_t crc = 0xFFFF, data;
+  bool set, writable = false;
+  char command;
+
+  counters_.requests++;
+
+  if (missed()) {
+    return;
+  }
+
+  for (uint8_t i = 0; i < 8; i++) {
+    crc = MingHeModbus::updateCrc(crc, rx_buffer_[i]);
+  }
+  if (crc || ((uint8_t)rx_buffer_[0] != device_id_)) {
+    counters_.ignored_requests++;
+    return;
+  }
+
+  function = rx_buffer_[1];
+  set = (function == MINGHE_MODBUS_WRITE_REGISTER);
+  if (tooSoon(set)) {
+    return;
+  }
+  reg = rx_buffer_[2] ? MINGHE_MODBUS_NO_REGISTER : (uint8_t)rx_buffer_[3];
+  data = ((uint8_t)rx_buffer_[4] << 8) | (uint8_t)rx_buffer_[5];
+
+  updatePlant();
+  scheduleResponse();
+
+  // Another unit on the bus chatters first.
+  if (roll(profile_.spurious_permille)) {
+    response[0] = (device_id_ % 99) + 1;
+    response[1] = MINGHE_MODBUS_READ_REGISTERS;
+    response[2] = 2;
+    response[3] = 1234 >> 8;
+    response[4] = 1234 & 0xFF;
+    queueModbusFrame(response, 5);
+    counters_.spurious_frames++;
+  }
+
+  response[length++] = device_id_;
+  response[length++] = function;
+  command = MingHeModbus::commandForRegister(reg);
+  if (command) {
+    MingHeModbus::registerForCommand(command, &writable);
+  }
+
+  if (stuckErr()) {
+    exception = 0x04;
+  } else if (set) {
+    if (!writable) {
+      exception = 0x02;
+    } else if (!writeRegister(command, data)) {
+      exception = 0x03;
+    } else {
+      // A write is answered with the request itself.
+      for (uint8_t i = 2; i < 6; i++) {
+        response[length++] = rx_buffer_[i];
+      }
+    }
+  } else if (function != MINGHE_MODBUS_READ_REGISTERS) {
+    exception = 0x01;
+  } else if (!data || (reg >= MINGHE_MODBUS_BLOCK_REGISTERS) ||
+          (data > MINGHE_MODBUS_BLOCK_REGISTERS - reg)) {
+    exception = 0x02;
+  } else {
+    response[length++] = data * 2;
+    for (uint8_t i = 0; i < data; i++) {
+      uint16_t value = readModbusRegister(reg + i);
+      response[length++] = value >> 8;
+      response[length++] = value & 0xFF;
+    }
+  }
+
+  if (exception) {
+    response[1] |= MINGHE_MODBUS_EXCEPTION;
+    response[2] = exception;
+    length = 3;
+    counters_.err_replies++;
+  }
+  counters_.responses++;
+  queueModbusFrame(response, length);
+  markResponseEnd();
+}
+
+/*
+ * Run the plant up to now on the settings as they've been since the last
+ * request - they can only change with a request.  Then pick up what it put out
+ * for the counters, and whether it tripped.
+ */
+void MingHeEmulator::updatePlant(void) {
+  MingHePlantInput input;
+
+  if (!plant_) {
+    return;
+  }
+  input.max_voltage = max_voltage_;
+  input.max_current = max_current_;
+  input.output_enabled = output_enabled_;
+  input.fast_voltage_change = fast_voltage_change_;
+  input.fan_start_temperature = fan_start_temperature_;
+  input.shutdown_temperature = shutdown_temperature_;
+  plant_->update(input);
+
+  output_enabled_ = input.output_enabled;
+  mamp_hours_ += plant_->takeMampHours();
+  power_on_time_ += plant_->takeOnSeconds();
+}
+
+// Registers without a command letter are there, but don't do much.
+uint16_t MingHeEmulator::readModbusRegister(const uint8_t reg) {
+  char command = MingHeModbus::commandForRegister(reg);
+  uint32_t value = 0;
+
+  if (command) {
+    readRegister(command, &value);
+    // CV (0) or CC (1), rather than the limiting factor.
+    if (command == MINGHE_COMMAND_LIMITING_FACTOR) {
+      value = (value == MINGHE_LIMITING_FACTOR_CURRENT);
+    }
+    return value;
+  }
+  if (reg == 0x05) {
+    return MINGHE_EMULATOR_INPUT_VOLTAGE;
+  }
+  return 0;
+}
+
+bool MingHeEmulator::readRegister(const char command, uint32_t *value) {
+  if (plant_) {
+    switch (command) {
+      case MINGHE_COMMAND_VOLTAGE: *value = plant_->getVoltage(); return true;
+      case MINGHE_COMMAND_CURRENT: *value = plant_->getCurrent(); return true;
+      case MINGHE_COMMAND_WATTS: *value = plant_->getWatts(); return true;
+      case MINGHE_COMMAND_LIMITING_FACTOR:
+        *value = plant_->getLimitingFactor();
+        return true;
+      case MINGHE_COMMAND_TEMPERATURE:
+        *value = plant_->getTemperature();
+        return true;
+    }
+  }
+
+  switch (command) {
+    case MINGHE_COMMAND_MAX_VOLTAGE: *value = max_voltage_; break;
+    case MINGHE_COMMAND_MAX_CURRENT: *value = max_current_; break;
+    // No load connected: output sits at the voltage limit, no current flows.
+    case MINGHE_COMMAND_VOLTAGE: *value = output_enabled_ ? max_voltage_ : 0;
+      break;
+    case MINGHE_COMMAND_CURRENT: *value = 0; break;
+    case MINGHE_COMMAND_WATTS: *value = 0; break;
+    case MINGHE_COMMAND_OUTPUT_STATE: *value = output_enabled_; break;
+    case MINGHE_COMMAND_LIMITING_FACTOR:
+      *value = output_enabled_ ? MINGHE_LIMITING_FACTOR_VOLTAGE :
+              MINGHE_LIMITING_FACTOR_OFF;
+      break;
+    case MINGHE_COMMAND_MAMP_HOURS: *value = mamp_hours_; break;
+    case MINGHE_COMMAND_RUNTIME: *value = power_on_time_; break;
+    case MINGHE_COMMAND_TEMPERATURE: *value = temperature_; break;
+    case MINGHE_COMMAND_SHUTDOWN_TEMPERATURE: *value = shutdown_temperature_;
+      break;
+    case MINGHE_COMMAND_FAN_TEMPERATURE: *value = fan_start_temperature_; break;
+    case MINGHE_COMMAND_FAST_VOLTAGE_CHANGE: *value = fast_voltage_change_;
+      break;
+    case MINGHE_COMMAND_BOOT_OUTPUT_ENABLED: *value = boot_output_; break;
+    case MINGHE_COMMAND_BEEPER_ENABLED: *value = beeper_; break;
+    case MINGHE_COMMAND_MACHINE_MODEL: *value = machine_model_; break;
+    case MINGHE_COMMAND_COMMUNICATION_VERSION: *value = 22; break;
+    case MINGHE_COMMAND_BAUD_RATE: *value = baud_index_; break;
+    case MINGHE_COMMAND_ADDRESS: *value = device_id_; break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+/*
+ * Range checks follow the model number: a 6015 takes up to 60.00V and 15.00A.
+ * Out of range writes get an "err", as the real thing does.
+ */
+bool MingHeEmulator::writeRegister(const char command, const uint32_t value) {
+  switch (command) {
+    case MINGHE_COMMAND_MAX_VOLTAGE:
+      if (value > (machine_model_ / 100) * 100UL) {
+        return false;
+      }
+      max_voltage_ = value;
+      break;
+    case MINGHE_COMMAND_MAX_CURRENT:
+      if (value > (machine_model_ % 100) * 100UL) {
+        return false;
+      }
+      max_current_ = value;
+      break;
+    case MINGHE_COMMAND_OUTPUT_STATE: output_enabled_ = value; break;
+    case MINGHE_COMMAND_MAMP_HOURS: mamp_hours_ = value; break;
+    case MINGHE_COMMAND_RUNTIME: power_on_time_ = value; break;
+    case MINGHE_COMMAND_SHUTDOWN_TEMPERATURE: shutdown_temperature_ = value;
+      break;
+    case MINGHE_COMMAND_FAN_TEMPERATURE: fan_start_temperature_ = value; break;
+    case MINGHE_COMMAND_FAST_VOLTAGE_CHANGE: fast_voltage_change_ = value;
+      break;
+    case MINGHE_COMMAND_BOOT_OUTPUT_ENABLED: boot_output_ = value; break;
+    case MINGHE_COMMAND_BEEPER_ENABLED: beeper_ = value; break;
+    case MINGHE_COMMAND_BAUD_RATE:
+      if (value > MINGHE_BAUD_4800) {
+        return false;
+      }
+      baud_index_ = value;
+      deaf_remaining_ = profile_.deaf_after_baud_frames;
+      break;
+    case MINGHE_COMMAND_ADDRESS:
+      if ((value < 1) || (value > 99)) {
+        return false;
+      }
+      device_id_ = value;
+      break;
+    case MINGHE_COMMAND_STORE_TO_MEMORY:
+      if (value >= MINGHE_EMULATOR_MEMORY_SLOTS) {
+        return false;
+      }
+      memory_voltage_[value] = max_voltage_;
+      memory_current_[value] = max_current_;
+      break;
+    case MINGHE_COMMAND_LOAD_FROM_MEMORY:
+      if (value >= MINGHE_EMULATOR_MEMORY_SLOTS) {
+        return false;
+      }
+      max_voltage_ = memory_voltage_[value];
+      max_current_ = memory_current_[value];
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
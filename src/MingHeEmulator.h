@@ -0,0 +1,238 @@
+/*
+ * A software emulation of a MingHe buck converter, for exercising the driver
+ * without hardware on the bench.  It looks like a Stream, so you can hand it to
+ * the Stream constructor of MingHeBuckConverter and everything else works as if
+ * a real DPS6015 was on the other end of the wire.
+ *
+ * Beyond being a well behaved device, it can be told to misbehave in the ways a
+ * long, noisy serial run does: slow and jittery replies, bytes that never
+ * arrive, bit flips that spoil a frame, frames from some other address, a
+ * device that gets stuck replying "err" for a while, and one that misses the
+ * first few requests after a baud rate change.  See MingHeFaultProfile.
+ *
+ * Give it a MingHePlant (see MingHePlant.h) and the output it reports is
+ * driven by a model of a load, battery and heatsink, rather than sitting at
+ * the voltage limit with nothing drawn.
+ *
+ * Timing is done with micros(), and response bytes are released at the
+ * configured baud rate, so the driver sees roughly what it would see on a real
+ * line.  Nothing here is interrupt driven - the "device" does its work when the
+ * driver writes the trailing newline of a request (or, speaking Modbus, the
+ * last byte of one).
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#ifndef __MING_HE_EMULATOR_H__
+#define __MING_HE_EMULATOR_H__
+
+#include <Arduino.h>
+
+#include "MingHeBuckConverter.h"
+#include "MingHeChecksum.h"
+#include "MingHePlant.h"
+
+// Longest request the emulator will accept: ":01sa" + 10 digits + LRC + "\r\n"
+#define MINGHE_EMULATOR_RX_BUFFER 20
+// Room for a spurious frame, a real response, and some slop.
+#define MINGHE_EMULATOR_TX_BUFFER 48
+
+#define MINGHE_EMULATOR_MEMORY_SLOTS 10
+
+/**
+ * How badly the emulated line and device behave.  All probabilities are in
+ * parts per thousand, so 10 is 1%.  A zeroed profile is a perfect device that
+ * answers instantly (plus character time on the wire).
+ */
+struct MingHeFaultProfile {
+  // Response delay is uniform between min and max...
+  uint16_t min_delay_ms;
+  uint16_t max_delay_ms;
+  // ...except for tail_permille of responses, which take tail_delay_ms.
+  uint16_t tail_delay_ms;
+  uint16_t tail_permille;
+
+  // Chance of each transmitted response byte vanishing.
+  uint16_t drop_permille;
+  // Chance of a response having one bit flipped.  The frame is always
+  // rejected, usually as a checksum error.
+  uint16_t flip_permille;
+  // Chance of a well formed frame from another address preceding a response.
+  uint16_t spurious_permille;
+  // Chance of the device getting stuck replying "err" to the next
+  // stuck_err_frames requests, whatever they are.
+  uint16_t stuck_err_permille;
+  uint8_t stuck_err_frames;
+  // Requests the device misses after switching baud rate - the check that it
+  // switched going missing, as it can at a marginal rate.
+  uint8_t deaf_after_baud_frames;
+};
+
+// Counts of what the emulator actually did, for reporting with benchmarks.
+struct MingHeEmulatorCounters {
+  uint32_t requests;
+  uint32_t responses;
+  uint32_t ignored_requests;
+  uint32_t dropped_bytes;
+  uint32_t flipped_frames;
+  uint32_t spurious_frames;
+  uint32_t err_replies;
+  uint32_t tail_delays;
+  uint32_t gap_violations;
+};
+
+class MingHeEmulator : public Stream {
+public:
+  /**
+   * Constructor.  Pass in the device address to answer to and the machine
+   * model to report (6015 for the DPS6015).
+   */
+  MingHeEmulator(const uint8_t device_id, const uint16_t machine_model);
+
+  // Install a fault profile.  The profile is copied.
+  void setFaultProfile(const MingHeFaultProfile &profile);
+
+  /**
+   * Baud rate of the line, used to pace response bytes at 10 bits per
+   * character.  Requests are ignored unless this matches the device's own
+   * baud setting, which starts at 9600 and follows the baud rate command.
+   */
+  void setBaudRate(const uint32_t baud_rate);
+
+  /**
+   * Requests arriving sooner than this after the end of the previous response
+   * are ignored, the way a real unit drops a frame it isn't ready for.
+   * Defaults to no gap at all.
+   */
+  void setMinimumGaps(const MingHeFrameGaps &gaps);
+
+  // Echo every request byte back, like an RS-485 transceiver with the
+  // receiver left enabled.
+  void setEcho(const bool enabled) { echo_ = enabled; }
+
+  // Speak Modbus-RTU (see MingHeModbus.h) instead of the ASCII protocol.
+  void setModbus(const bool enabled) { modbus_ = enabled; rx_length_ = 0; }
+
+  /**
+   * Model the output with a plant - the measured values, limiting factor,
+   * temperature and counters all come from it, and it trips the output on
+   * over temperature.  Not owned.  NULL (the default) for no load at all.
+   */
+  void setPlant(MingHePlant *plant) { plant_ = plant; }
+  // Bring the plant up to now.  Done on every request - call it to look at
+  // the plant in between.
+  void updatePlant(void);
+
+  /**
+   * For sharing a line with other units (see MingHeRack): when the next
+   * unread response byte starts on the wire - only meaningful if there is
+   * one - and whether a response is going out right now.
+   */
+  uint32_t getNextByteUs(void) const { return tx_ready_us_; }
+  bool isTransmitting(void) const;
+
+  // Zero the counters.
+  void resetCounters(void);
+  const MingHeEmulatorCounters &getCounters(void) const { return counters_; }
+
+  // Direct access to the emulated device state, for setting up tests.
+  uint8_t getDeviceId(void) const { return device_id_; }
+  uint16_t getMaxVoltage(void) const { return max_voltage_; }
+  uint16_t getMaxCurrent(void) const { return max_current_; }
+  bool getOutputEnabled(void) const { return output_enabled_; }
+  void setMaxVoltage(const uint16_t volts_100) { max_voltage_ = volts_100; }
+  void setMaxCurrent(const uint16_t amps_100) { max_current_ = amps_100; }
+  void setTemperature(const uint8_t degrees_c) { temperature_ = degrees_c; }
+
+  // Stream interface - this is what the driver talks to.
+  virtual int available(void);
+  virtual int read(void);
+  virtual int peek(void);
+  virtual size_t write(uint8_t c);
+  virtual void flush(void);
+  using Print::write;
+
+private:
+  // Handle a complete request sitting in rx_buffer_.
+  void processRequest(void);
+  void processModbusRequest(void);
+
+  // Shared response handling: drop requests at the wrong baud or while deaf
+  // after a switch, or that come too soon, set when the response goes out,
+  // roll for a stuck device, and note when it's all out.
+  bool missed(void);
+  bool tooSoon(const bool set);
+  void scheduleResponse(void);
+  bool stuckErr(void);
+  void markResponseEnd(void);
+
+  // Value of a Modbus holding register.
+  uint16_t readModbusRegister(const uint8_t reg);
+
+  // Read or write a register.  Returns false for unknown commands.
+  bool readRegister(const char command, uint32_t *value);
+  bool writeRegister(const char command, const uint32_t value);
+
+  // Queue a complete frame (':' + address + body + LRC + CR LF).
+  void queueFrame(const uint8_t device_id, const char *body);
+  void queueByte(const char c);
+  // Queue a Modbus frame, adding the CRC.  frame needs room for it.
+  void queueModbusFrame(uint8_t *frame, uint8_t length);
+
+  // True with the given chance in a thousand.
+  bool roll(const uint16_t permille);
+
+  // Number of queued bytes that have made it "across the wire" by now.
+  uint8_t releasedBytes(void);
+  uint8_t pacedBytes(const uint32_t start_us, const uint8_t limit);
+
+  MingHeFaultProfile profile_;
+  MingHeEmulatorCounters counters_;
+  MingHeBuckConverterChecksum checksum_;
+
+  char rx_buffer_[MINGHE_EMULATOR_RX_BUFFER];
+  uint8_t rx_length_;
+
+  char tx_buffer_[MINGHE_EMULATOR_TX_BUFFER];
+  uint8_t tx_head_, tx_tail_;
+  // Time the byte at tx_head_ starts to be released, and per-byte time.
+  uint32_t tx_ready_us_;
+  // Start of a response queued behind unread bytes, and when it goes out.
+  uint8_t tx_gate_;
+  uint32_t tx_gate_us_;
+  uint16_t char_time_us_;
+  uint32_t line_baud_rate_;
+
+  uint8_t stuck_err_remaining_;
+  uint8_t deaf_remaining_;
+  bool echo_;
+  bool modbus_;
+  MingHePlant *plant_;
+
+  // Required quiet time, and when the last response started and finished
+  // going out.
+  MingHeFrameGaps minimum_gaps_;
+  uint32_t last_response_start_us_, last_response_end_us_;
+  bool last_was_set_;
+  bool has_responded_;
+
+  // Emulated device state.
+  uint8_t device_id_;
+  uint16_t machine_model_;
+  uint16_t max_voltage_, max_current_;
+  bool output_enabled_;
+  uint32_t mamp_hours_, power_on_time_;
+  uint8_t temperature_, shutdown_temperature_, fan_start_temperature_;
+  bool fast_voltage_change_, boot_output_, beeper_;
+  uint8_t baud_index_;
+  uint16_t memory_voltage_[MINGHE_EMULATOR_MEMORY_SLOTS];
+  uint16_t memory_current_[MINGHE_EMULATOR_MEMORY_SLOTS];
+};
+
+#endif // __MING_HE_EMULATOR_H__
@@ -0,0 +1,143 @@
+/*
+ * Filters for noisy readings.  See MingHeFilter.h.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#include "MingHeFilter.h"
+
+// Values are kept in 1/256ths.
+#define FRACTION_BITS 8
+#define HALF (1L << (FRACTION_BITS - 1))
+// Kalman gains are in 1/32768ths.
+#define GAIN_BITS 15
+#define GAIN_ONE (1L << GAIN_BITS)
+
+// Back to a whole value, rounded, and never below 0.
+static uint32_t whole(const int32_t value) {
+  return (value < 0) ? 0 : (uint32_t)(value + HALF) >> FRACTION_BITS;
+}
+
+// value * gain / 32768, taking the bits above bit 15 and those below it
+// separately, so a 31 bit value doesn't overflow.
+static int32_t applyGain(const int32_t value, const uint16_t gain) {
+  return (value >> GAIN_BITS) * (int32_t)gain +
+          (int32_t)(((uint32_t)value & (GAIN_ONE - 1)) * gain >> GAIN_BITS);
+}
+
+MingHeEmaFilter::MingHeEmaFilter(const uint8_t shift) {
+  shift_ = (shift > MINGHE_EMA_MAX_SHIFT) ? MINGHE_EMA_MAX_SHIFT : shift;
+  primed_ = false;
+  average_ = 0;
+}
+
+/*
+ * The step is rounded to nearest, the same either way - a plain shift rounds
+ * down, and leaves a rising average stuck up to a count short of the sample.
+ * Rounded, it stops within half a count, and comes out as the sample.
+ */
+uint32_t MingHeEmaFilter::update(const uint32_t sample) {
+  int32_t scaled = (int32_t)(sample << FRACTION_BITS);
+  int32_t step, half;
+
+  if (!primed_) {
+    average_ = scaled;
+    primed_ = true;
+    return whole(average_);
+  }
+  step = scaled - average_;
+  half = shift_ ? (1L << (shift_ - 1)) : 0;
+  if (step < 0) {
+    average_ -= (half - step) >> shift_;
+  } else {
+    average_ += (step + half) >> shift_;
+  }
+  return whole(average_);
+}
+
+MingHeMedianFilter::MingHeMedianFilter(const uint8_t size) {
+  size_ = size | 1;
+  if (size_ > MINGHE_MEDIAN_MAX_SIZE) {
+    size_ = MINGHE_MEDIAN_MAX_SIZE;
+  }
+  reset();
+}
+
+/*
+ * Keep the window sorted as it goes: take the oldest sample out, and put the
+ * new one in where it belongs.  Never more than a handful of moves.
+ */
+uint32_t MingHeMedianFilter::update(const uint32_t sample) {
+  uint8_t i;
+
+  if (count_ == size_) {
+    for (i = 0; sorted_[i] != samples_[next_]; i++) {
+    }
+    for (; i < count_ - 1; i++) {
+      sorted_[i] = sorted_[i + 1];
+    }
+    count_--;
+  }
+  for (i = count_; i && (sorted_[i - 1] > sample); i--) {
+    sorted_[i] = sorted_[i - 1];
+  }
+  sorted_[i] = sample;
+  count_++;
+
+  samples_[next_] = sample;
+  if (++next_ == size_) {
+    next_ = 0;
+  }
+  return sorted_[(count_ - 1) / 2];
+}
+
+MingHeKalmanFilter::MingHeKalmanFilter(const uint16_t process_noise,
+        const uint16_t measurement_noise) {
+  process_noise_ = (uint32_t)process_noise << FRACTION_BITS;
+  // Never 0, so the gain below never divides by 0.
+  measurement_noise_ = measurement_noise ?
+          (uint32_t)measurement_noise << FRACTION_BITS : 1;
+  primed_ = false;
+  estimate_ = 0;
+  variance_ = 0;
+}
+
+/*
+ * The gain is how far to move toward the sample: the estimate's variance over
+ * that plus the readings'.  Work it out with both scaled down to 16 bits, so
+ * it fits a 32 bit divide.
+ */
+uint32_t MingHeKalmanFilter::update(const uint32_t sample) {
+  int32_t scaled = (int32_t)(sample << FRACTION_BITS);
+  uint32_t variance, total;
+  uint16_t gain;
+
+  if (!primed_) {
+    estimate_ = scaled;
+    variance_ = measurement_noise_;
+    primed_ = true;
+    return sample;
+  }
+
+  // Unsure by that much more since the last sample.
+  variance = variance_ + process_noise_;
+  total = variance + measurement_noise_;
+  while (total > 0xFFFF) {
+    variance >>= 1;
+    total >>= 1;
+  }
+  gain = (variance << GAIN_BITS) / total;
+  if (gain >= GAIN_ONE) {
+    gain = GAIN_ONE - 1;
+  }
+
+  estimate_ += applyGain(scaled - estimate_, gain);
+  variance_ = applyGain(variance_ + process_noise_, GAIN_ONE - gain);
+  return whole(estimate_);
+}
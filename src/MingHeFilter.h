@@ -0,0 +1,118 @@
+/*
+ * Filters for noisy readings.  At 10mV and 10mA a reading jitters by a count
+ * or two from one frame to the next, and anything acting on every change
+ * ends up chasing noise.
+ *
+ * All of them take a sample at a time and hand back the filtered value, in
+ * fixed point with no floats, and keep a fixed few bytes of state - nothing
+ * grows with the number of samples.  Samples are whatever the reading is in -
+ * hundredths, mW, degrees - up to 8,388,607.
+ *
+ * - MingHeEmaFilter: exponential moving average.  Cheapest, and smooth, but
+ *   lags a step change and is pulled about by a single wild reading.
+ * - MingHeMedianFilter: median of the last few samples.  Throws out the odd
+ *   wild reading altogether and follows a step a few samples later, but
+ *   doesn't smooth steady jitter much.
+ * - MingHeKalmanFilter: a one value Kalman filter.  Smooths hard while the
+ *   readings agree with it and follows quickly when they don't, given some
+ *   idea of how noisy the readings are and how fast the real value moves.
+ *
+ * Filters keep state, so each channel needs its own.  See MingHeTelemetry for
+ * hooking them up to readings.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#ifndef __MING_HE_FILTER_H__
+#define __MING_HE_FILTER_H__
+
+#include <Arduino.h>
+
+// Longest median window.  Each slot costs 8 bytes of SRAM.
+#define MINGHE_MEDIAN_MAX_SIZE 7
+// Heaviest EMA smoothing: 1/256 of each new sample.
+#define MINGHE_EMA_MAX_SHIFT 8
+
+class MingHeFilter {
+public:
+  virtual ~MingHeFilter() {}
+
+  // Take a sample, and return the filtered value.  The first sample after a
+  // reset comes straight back.
+  virtual uint32_t update(const uint32_t sample) = 0;
+  // Forget the samples so far.
+  virtual void reset(void) = 0;
+};
+
+/**
+ * Each new sample counts for 1/2^shift of the average - shift 1 is half, 3
+ * an eighth.  A step change is most of the way there after 2^shift samples.
+ */
+class MingHeEmaFilter : public MingHeFilter {
+public:
+  MingHeEmaFilter(const uint8_t shift);
+
+  uint32_t update(const uint32_t sample);
+  void reset(void) { primed_ = false; }
+
+private:
+  uint8_t shift_;
+  bool primed_;
+  // In 1/256ths.
+  int32_t average_;
+};
+
+/**
+ * The median of the last size samples - odd, and up to MINGHE_MEDIAN_MAX_SIZE.
+ * Until size samples are in, the median of those there are.
+ */
+class MingHeMedianFilter : public MingHeFilter {
+public:
+  MingHeMedianFilter(const uint8_t size);
+
+  uint32_t update(const uint32_t sample);
+  void reset(void) { count_ = next_ = 0; }
+
+private:
+  uint8_t size_;
+  uint8_t count_;
+  // Samples in the order they came, with next_ the oldest once full, and the
+  // same samples in order.
+  uint32_t samples_[MINGHE_MEDIAN_MAX_SIZE];
+  uint32_t sorted_[MINGHE_MEDIAN_MAX_SIZE];
+  uint8_t next_;
+};
+
+/**
+ * Tracks a value that wanders, through readings that scatter about it.  Both
+ * are variances, in counts squared: measurement_noise is how far readings of
+ * a steady value spread (a jitter of +/-2 counts is about 2), process_noise
+ * how far the real value moves between samples when nothing is going on.
+ * The bigger measurement_noise is against process_noise, the harder it
+ * smooths - and the slower it follows.
+ */
+class MingHeKalmanFilter : public MingHeFilter {
+public:
+  MingHeKalmanFilter(const uint16_t process_noise,
+          const uint16_t measurement_noise);
+
+  uint32_t update(const uint32_t sample);
+  void reset(void) { primed_ = false; }
+
+private:
+  // Both in 1/256ths of a count squared.
+  uint32_t process_noise_, measurement_noise_;
+  bool primed_;
+  // The estimate, in 1/256ths, and how unsure of it it is, as a variance in
+  // 1/256ths of a count squared.
+  int32_t estimate_;
+  uint32_t variance_;
+};
+
+#endif // __MING_HE_FILTER_H__
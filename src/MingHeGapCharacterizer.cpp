@@ -0,0 +1,206 @@
+/*
+ * Inter-frame gap characterization.  See the header for details.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#include "MingHeGapCharacterizer.h"
+
+MingHeGapCharacterizer::MingHeGapCharacterizer(MingHeBuckConverter *converter) {
+  converter_ = converter;
+  setSearch(MINGHE_GAP_DEFAULT_TRIALS, MINGHE_GAP_DEFAULT_MAX_US,
+          MINGHE_GAP_DEFAULT_MARGIN_PERCENT);
+  probe_voltage_ = 0;
+}
+
+void MingHeGapCharacterizer::setSearch(const uint8_t trials, 
+        const uint16_t max_gap_us, const uint8_t margin_percent) {
+  trials_ = trials ? trials : 1;
+  max_gap_us_ = max_gap_us;
+  margin_percent_ = margin_percent;
+}
+
+/*
+ * Each pair starts after a long, safe pause, so only the transition under test
+ * runs at the candidate gap.  The gap table is set so every other transition is
+ * at the maximum too.
+ */
+bool MingHeGapCharacterizer::pairsSucceed(const bool from_set, 
+        const bool to_set, const uint16_t gap_us) {
+  MingHeFrameGaps gaps;
+  MingHeReading reading;
+
+  for (uint8_t from = 0; from < 2; from++) {
+    for (uint8_t to = 0; to < 2; to++) {
+      gaps.gap_us[from][to] = max_gap_us_;
+    }
+  }
+
+  for (uint8_t trial = 0; trial < trials_; trial++) {
+    gaps.gap_us[from_set][to_set] = max_gap_us_;
+    converter_->setFrameGaps(gaps);
+    converter_->clearQuarantine();
+
+    // The first frame of the pair.  A write probe is a plain set here - the
+    // verify read that setMaxVoltage does would be a frame in between.
+    if (from_set) {
+      converter_->setValue(MINGHE_COMMAND_MAX_VOLTAGE, probe_voltage_);
+      reading.status = converter_->getLastStatus();
+    } else {
+      reading = converter_->getReading(MINGHE_COMMAND_MACHINE_MODEL);
+    }
+    // If the lead-in frame failed at a safe gap, the line is the problem.
+    if (!reading.ok()) {
+      return false;
+    }
+
+    gaps.gap_us[from_set][to_set] = gap_us;
+    converter_->setFrameGaps(gaps);
+    if (to_set) {
+      if (!converter_->setValue(MINGHE_COMMAND_MAX_VOLTAGE, probe_voltage_)) {
+        return false;
+      }
+    } else if (!converter_->getReading(MINGHE_COMMAND_MACHINE_MODEL).ok()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool MingHeGapCharacterizer::searchGap(const bool from_set, const bool to_set,
+        uint16_t *gap_us) {
+  uint16_t low = 0, high = max_gap_us_, mid;
+  uint32_t with_margin;
+
+  *gap_us = max_gap_us_;
+  if (!pairsSucceed(from_set, to_set, high)) {
+    return false;
+  }
+  if (pairsSucceed(from_set, to_set, 0)) {
+    high = 0;
+  }
+
+  // Invariant: high works, low does not (or is untested and high is 0).
+  while ((high - low) > MINGHE_GAP_RESOLUTION_US) {
+    mid = low + ((high - low) / 2);
+    if (pairsSucceed(from_set, to_set, mid)) {
+      high = mid;
+    } else {
+      low = mid;
+    }
+  }
+
+  with_margin = high + ((uint32_t)high * margin_percent_) / 100;
+  *gap_us = (with_margin > 0xFFFF) ? 0xFFFF : (uint16_t)with_margin;
+  return true;
+}
+
+// Set every gap to the maximum, which is assumed to always be long enough.
+void MingHeGapCharacterizer::useSafeGaps() {
+  MingHeFrameGaps safe_gaps;
+
+  for (uint8_t from = 0; from < 2; from++) {
+    for (uint8_t to = 0; to < 2; to++) {
+      safe_gaps.gap_us[from][to] = max_gap_us_;
+    }
+  }
+  converter_->setFrameGaps(safe_gaps);
+}
+
+bool MingHeGapCharacterizer::characterize(MingHeFrameGaps *gaps) {
+  MingHeRetryPolicy saved_policy = converter_->getRetryPolicy();
+  MingHeFrameGaps saved_gaps = converter_->getFrameGaps();
+  MingHeReading reading;
+  bool success = true;
+
+
+  // A failure has to count - no retries, and a short deadline so failures
+  // cost little.  Start from gaps that are known to be long enough.
+  converter_->setRetryPolicy(1, 0, 250);
+  useSafeGaps();
+
+  reading = converter_->getReading(MINGHE_COMMAND_MAX_VOLTAGE);
+  if (!reading.ok()) {
+    converter_->setFrameGaps(saved_gaps);
+    converter_->setRetryPolicy(saved_policy.attempts, saved_policy.backoff_ms,
+            saved_policy.deadline_ms);
+    return false;
+  }
+  probe_voltage_ = (uint16_t)reading.value;
+
+  for (uint8_t from = 0; from < 2; from++) {
+    for (uint8_t to = 0; to < 2; to++) {
+      success &= searchGap(from, to, &gaps->gap_us[from][to]);
+    }
+  }
+
+  converter_->setFrameGaps(saved_gaps);
+  converter_->setRetryPolicy(saved_policy.attempts, saved_policy.backoff_ms,
+          saved_policy.deadline_ms);
+  converter_->clearQuarantine();
+  return success;
+}
+
+bool MingHeGapCharacterizer::characterizeBaudRates(
+        MingHeFrameGaps table[MINGHE_BAUD_COUNT], 
+        const uint8_t min_baud_index, const uint8_t max_baud_index) {
+  uint8_t original_baud_index = converter_->getBaudIndex();
+  MingHeFrameGaps saved_gaps = converter_->getFrameGaps();
+  uint32_t min_baud, max_baud, baud;
+  bool success = true;
+
+  min_baud = MingHeBuckConverter::baudRateFromIndex(min_baud_index);
+  max_baud = MingHeBuckConverter::baudRateFromIndex(max_baud_index);
+
+  for (uint8_t i = 0; i < MINGHE_BAUD_COUNT; i++) {
+    for (uint8_t from = 0; from < 2; from++) {
+      for (uint8_t to = 0; to < 2; to++) {
+        table[i].gap_us[from][to] = MINGHE_POST_READ_DELAY_MS * 1000U;
+      }
+    }
+
+    baud = MingHeBuckConverter::baudRateFromIndex(i);
+    if ((baud < min_baud) || (baud > max_baud)) {
+      continue;
+    }
+    // Switching rates at the gaps of the old rate may not be safe.
+    useSafeGaps();
+    if ((converter_->getBaudIndex() != i) && !converter_->setBaudRate(i)) {
+      success = false;
+      continue;
+    }
+    success &= characterize(&table[i]);
+  }
+
+  useSafeGaps();
+  if (converter_->getBaudIndex() != original_baud_index) {
+    converter_->setBaudRate(original_baud_index);
+  }
+  converter_->setFrameGaps(saved_gaps);
+  return success;
+}
+
+void MingHeGapCharacterizer::printTable(Print &out,
+        const MingHeFrameGaps table[MINGHE_BAUD_COUNT]) {
+  out.println(F("// {{read->read, read->write}, {write->read, write->write}}"));
+  out.println(F("const MingHeFrameGaps PROGMEM frame_gaps[8] = {"));
+  for (uint8_t i = 0; i < MINGHE_BAUD_COUNT; i++) {
+    out.print(F("  {{{"));
+    out.print(table[i].gap_us[0][0]);
+    out.print(F(", "));
+    out.print(table[i].gap_us[0][1]);
+    out.print(F("}, {"));
+    out.print(table[i].gap_us[1][0]);
+    out.print(F(", "));
+    out.print(table[i].gap_us[1][1]);
+    out.print(F("}}}, // "));
+    out.println(MingHeBuckConverter::baudRateFromIndex(i));
+  }
+  out.println(F("};"));
+}
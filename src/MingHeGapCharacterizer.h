@@ -0,0 +1,84 @@
+/*
+ * Measures the shortest reliable gap between frames for a converter, so the
+ * driver can stop paying a blanket MINGHE_POST_READ_DELAY_MS on every frame.
+ *
+ * For each kind of transition (read to read, read to write, write to read,
+ * write to write), it binary searches for the smallest gap where a run of
+ * back-to-back frame pairs all succeed.  Run it against real hardware, or the
+ * MingHeEmulator with setMinimumGaps to check the search itself.  The result
+ * is a MingHeFrameGaps for the current baud rate, or a table of them across
+ * baud rates, ready to print as a PROGMEM initializer and hand to
+ * setFrameGapTable.
+ *
+ * The write used for probing writes the current max voltage back to itself,
+ * so the device settings are left as they were found.  Characterizing several
+ * baud rates changes the device baud rate as it goes, and puts it back after.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#ifndef __MING_HE_GAP_CHARACTERIZER_H__
+#define __MING_HE_GAP_CHARACTERIZER_H__
+
+#include "MingHeBuckConverter.h"
+
+// Frame pairs that must all succeed for a gap to count as reliable.
+#define MINGHE_GAP_DEFAULT_TRIALS 10
+// Largest gap searched, and how fine the search goes.
+#define MINGHE_GAP_DEFAULT_MAX_US 20000
+#define MINGHE_GAP_RESOLUTION_US 100
+// Margin added on top of the measured minimum, in percent.
+#define MINGHE_GAP_DEFAULT_MARGIN_PERCENT 25
+
+#define MINGHE_BAUD_COUNT 8
+
+class MingHeGapCharacterizer {
+public:
+  MingHeGapCharacterizer(MingHeBuckConverter *converter);
+
+  // Trials per candidate gap, the largest gap to try, and the safety margin.
+  void setSearch(const uint8_t trials, const uint16_t max_gap_us,
+          const uint8_t margin_percent);
+
+  /**
+   * Characterize the current baud rate.  Returns false if even the largest
+   * gap was unreliable (or the device could not be read at all) - in that case
+   * the affected gaps are left at the maximum.
+   */
+  bool characterize(MingHeFrameGaps *gaps);
+
+  /**
+   * Characterize every baud rate from min to max (MINGHE_BAUD_ indexes, in
+   * speed order).  Entries outside the range, or at rates the device would not
+   * switch to, get the driver default.  Returns false if anything failed.
+   */
+  bool characterizeBaudRates(MingHeFrameGaps table[MINGHE_BAUD_COUNT],
+          const uint8_t min_baud_index, const uint8_t max_baud_index);
+
+  // Print a table as a PROGMEM initializer, ready to paste into a sketch.
+  static void printTable(Print &out, 
+          const MingHeFrameGaps table[MINGHE_BAUD_COUNT]);
+
+private:
+  // True if trials_ pairs of from-then-to frames all work at this gap.
+  bool pairsSucceed(const bool from_set, const bool to_set, 
+          const uint16_t gap_us);
+  void useSafeGaps();
+  // Binary search one transition.
+  bool searchGap(const bool from_set, const bool to_set, uint16_t *gap_us);
+
+  MingHeBuckConverter *converter_;
+  uint8_t trials_;
+  uint16_t max_gap_us_;
+  uint8_t margin_percent_;
+  // Value written back during write probes.
+  uint16_t probe_voltage_;
+};
+
+#endif // __MING_HE_GAP_CHARACTERIZER_H__
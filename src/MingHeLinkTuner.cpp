@@ -0,0 +1,120 @@
+/*
+ * Automatic baud rate management.  See the header for details.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#include "MingHeLinkTuner.h"
+
+#if MINGHE_ENABLE_STATS
+
+// The baud index table is in protocol order, not speed order.  This is the
+// speed order: 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200.
+const static uint8_t PROGMEM minghe_baud_speed_order[8] = {
+  MINGHE_BAUD_1200, MINGHE_BAUD_2400, MINGHE_BAUD_4800, MINGHE_BAUD_9600,
+  MINGHE_BAUD_19200, MINGHE_BAUD_38400, MINGHE_BAUD_57600, MINGHE_BAUD_115200
+};
+
+MingHeLinkTuner::MingHeLinkTuner(MingHeBuckConverter *converter, 
+        const uint8_t min_baud_index, const uint8_t max_baud_index) {
+  converter_ = converter;
+  min_rank_ = speedRank(min_baud_index);
+  max_rank_ = speedRank(max_baud_index);
+  setThresholds(MINGHE_TUNER_DEFAULT_WINDOW,
+          MINGHE_TUNER_DEFAULT_MAX_ERROR_PERMILLE);
+  last_error_permille_ = 0;
+  clean_windows_ = 0;
+  holdoff_windows_ = 1;
+  just_stepped_up_ = false;
+  startWindow();
+}
+
+void MingHeLinkTuner::setThresholds(const uint16_t window_attempts,
+        const uint16_t max_error_permille) {
+  window_attempts_ = window_attempts ? window_attempts : 1;
+  max_error_permille_ = max_error_permille;
+}
+
+uint8_t MingHeLinkTuner::speedRank(const uint8_t baud_index) {
+  for (uint8_t i = 0; i < sizeof(minghe_baud_speed_order); i++) {
+    if (pgm_read_byte_near(minghe_baud_speed_order + i) == baud_index) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+uint8_t MingHeLinkTuner::baudIndexAtRank(const uint8_t rank) {
+  return pgm_read_byte_near(minghe_baud_speed_order + rank);
+}
+
+void MingHeLinkTuner::startWindow() {
+  const MingHeStats &stats = converter_->getStats();
+
+  window_start_attempts_ = stats.attempts;
+  window_start_errors_ = stats.timeouts + stats.checksum_errors;
+}
+
+// If the change can't be confirmed, the converter looks for the device and
+// stays on whichever rate it answers at - so go by where it ended up.
+bool MingHeLinkTuner::moveTo(const uint8_t rank) {
+  converter_->setBaudRate(baudIndexAtRank(rank));
+
+  // The switch itself makes some noise - don't count it against the new rate.
+  startWindow();
+  return converter_->getBaudIndex() == baudIndexAtRank(rank);
+}
+
+bool MingHeLinkTuner::update() {
+  const MingHeStats &stats = converter_->getStats();
+  uint32_t attempts, errors;
+  uint8_t rank;
+
+  attempts = stats.attempts - window_start_attempts_;
+  if (attempts < window_attempts_) {
+    return false;
+  }
+  errors = (stats.timeouts + stats.checksum_errors) - window_start_errors_;
+  last_error_permille_ = (uint16_t)((errors * 1000) / attempts);
+  startWindow();
+
+  rank = speedRank(converter_->getBaudIndex());
+
+  if (last_error_permille_ > max_error_permille_) {
+    clean_windows_ = 0;
+    // A faster rate that fails straight away: wait longer before the next try.
+    if (just_stepped_up_ && (holdoff_windows_ < MINGHE_TUNER_MAX_HOLDOFF)) {
+      holdoff_windows_ <<= 1;
+    }
+    just_stepped_up_ = false;
+    if (rank > min_rank_) {
+      return moveTo(rank - 1);
+    }
+    return false;
+  }
+
+  just_stepped_up_ = false;
+  // Only a spotless window counts towards stepping up.
+  if (errors) {
+    clean_windows_ = 0;
+    return false;
+  }
+  if (++clean_windows_ < holdoff_windows_) {
+    return false;
+  }
+  clean_windows_ = 0;
+
+  if (rank < max_rank_) {
+    just_stepped_up_ = moveTo(rank + 1);
+    return just_stepped_up_;
+  }
+  return false;
+}
+
+#endif // MINGHE_ENABLE_STATS
@@ -0,0 +1,93 @@
+/*
+ * Automatic baud rate management.  Watches the timeout and checksum error rate
+ * in a converter's stats, and moves the device and this end up to the next
+ * faster baud rate when the link has been clean for a while, or down to the
+ * next slower one when errors climb.  The aim is to sit at the fastest rate
+ * the cable and the noise allow, without anyone picking it by hand.
+ *
+ * A step up that immediately has to be undone is a sign the faster rate is
+ * marginal, so each failed step up doubles the number of clean windows needed
+ * before trying again.
+ *
+ * Only use this with one converter per link - changing the baud rate of one
+ * unit on a shared bus cuts off all the others.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#ifndef __MING_HE_LINK_TUNER_H__
+#define __MING_HE_LINK_TUNER_H__
+
+#include "MingHeBuckConverter.h"
+
+// The tuner works off the link statistics.
+#if MINGHE_ENABLE_STATS
+
+// Attempts per evaluation window.
+#define MINGHE_TUNER_DEFAULT_WINDOW 200
+// Step down if more than this many per thousand attempts fail.
+#define MINGHE_TUNER_DEFAULT_MAX_ERROR_PERMILLE 20
+// Longest wait, in clean windows, before another try at a faster rate.
+#define MINGHE_TUNER_MAX_HOLDOFF 64
+
+class MingHeLinkTuner {
+public:
+  /**
+   * Tune the link to converter.  The tuner never goes above max_baud_index
+   * or below min_baud_index (both MINGHE_BAUD_ values).  SoftwareSerial on a
+   * 16MHz AVR is not happy much past 57600, so that's a sensible ceiling.
+   */
+  MingHeLinkTuner(MingHeBuckConverter *converter, 
+          const uint8_t min_baud_index, const uint8_t max_baud_index);
+
+  // Attempts per window, and the error rate that triggers a step down.
+  void setThresholds(const uint16_t window_attempts,
+          const uint16_t max_error_permille);
+
+  /**
+   * Call regularly, e.g. from loop().  Once a window's worth of attempts has
+   * gone by, decides whether to step up, step down, or stay.  Returns true if
+   * the baud rate changed.
+   */
+  bool update();
+
+  // Error rate of the last full window, in parts per thousand.
+  uint16_t getLastErrorPermille() const { return last_error_permille_; }
+
+private:
+  // Position of a MINGHE_BAUD_ index in speed order, and back again.
+  static uint8_t speedRank(const uint8_t baud_index);
+  static uint8_t baudIndexAtRank(const uint8_t rank);
+
+  // Move to the given rank.  Returns true if the device followed.
+  bool moveTo(const uint8_t rank);
+
+  // Pick up the converter's stats as the start of a new window.
+  void startWindow();
+
+  MingHeBuckConverter *converter_;
+  uint8_t min_rank_, max_rank_;
+  uint16_t window_attempts_;
+  uint16_t max_error_permille_;
+
+  // Stats at the start of the current window.
+  uint32_t window_start_attempts_;
+  uint32_t window_start_errors_;
+
+  uint16_t last_error_permille_;
+  // Clean windows in a row, and how many are needed before stepping up.
+  uint8_t clean_windows_;
+  uint8_t holdoff_windows_;
+  // Set right after a step up, so a bad next window counts against it.
+  bool just_stepped_up_;
+};
+
+#endif // MINGHE_ENABLE_STATS
+
+#endif // __MING_HE_LINK_TUNER_H__
@@ -0,0 +1,249 @@
+/*
+ * Modbus-RTU protocol.  See MingHeModbus.h.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#include "MingHeBuckConverter.h"
+#include "MingHeModbus.h"
+
+struct MingHeModbusRegister {
+  char command;
+  uint8_t reg;
+  uint8_t writable;
+};
+
+const static MingHeModbusRegister PROGMEM minghe_modbus_registers[] = {
+  {MINGHE_COMMAND_MAX_VOLTAGE, 0x00, 1},
+  {MINGHE_COMMAND_MAX_CURRENT, 0x01, 1},
+  {MINGHE_COMMAND_VOLTAGE, 0x02, 0},
+  {MINGHE_COMMAND_CURRENT, 0x03, 0},
+  {MINGHE_COMMAND_WATTS, 0x04, 0},
+  {MINGHE_COMMAND_LIMITING_FACTOR, MINGHE_MODBUS_REGISTER_CV_CC, 0},
+  {MINGHE_COMMAND_OUTPUT_STATE, MINGHE_MODBUS_REGISTER_OUTPUT, 1},
+  {MINGHE_COMMAND_MACHINE_MODEL, 0x0B, 0},
+  {MINGHE_COMMAND_COMMUNICATION_VERSION, 0x0C, 0},
+};
+
+#define MINGHE_MODBUS_REGISTER_COUNT \
+  (sizeof(minghe_modbus_registers) / sizeof(MingHeModbusRegister))
+
+MingHeModbus::MingHeModbus() {
+  received_ = 0;
+  value_ = 0;
+  block_valid_ = false;
+}
+
+uint8_t MingHeModbus::registerForCommand(const char command, bool *writable) {
+  for (uint8_t i = 0; i < MINGHE_MODBUS_REGISTER_COUNT; i++) {
+    if ((char)pgm_read_byte_near(&minghe_modbus_registers[i].command) ==
+            command) {
+      if (writable) {
+        *writable = pgm_read_byte_near(&minghe_modbus_registers[i].writable);
+      }
+      return pgm_read_byte_near(&minghe_modbus_registers[i].reg);
+    }
+  }
+  return MINGHE_MODBUS_NO_REGISTER;
+}
+
+char MingHeModbus::commandForRegister(const uint8_t reg) {
+  for (uint8_t i = 0; i < MINGHE_MODBUS_REGISTER_COUNT; i++) {
+    if (pgm_read_byte_near(&minghe_modbus_registers[i].reg) == reg) {
+      return (char)pgm_read_byte_near(&minghe_modbus_registers[i].command);
+    }
+  }
+  return 0;
+}
+
+uint16_t MingHeModbus::updateCrc(uint16_t crc, const uint8_t c) {
+  crc ^= c;
+  for (uint8_t bit = 0; bit < 8; bit++) {
+    if (crc & 1) {
+      crc = (crc >> 1) ^ 0xA001;
+    } else {
+      crc >>= 1;
+    }
+  }
+  return crc;
+}
+
+// CV/CC is 0/1 on the wire, but the limiting factor is 1/2.
+uint32_t MingHeModbus::toValue(const char command, const uint16_t raw) {
+  if (command == MINGHE_COMMAND_LIMITING_FACTOR) {
+    return raw ? MINGHE_LIMITING_FACTOR_CURRENT :
+            MINGHE_LIMITING_FACTOR_VOLTAGE;
+  }
+  return raw;
+}
+
+// Registers are 16 bits - anything bigger can't be written.
+bool MingHeModbus::supports(const bool set, const char command,
+        const uint32_t value) const {
+  bool writable;
+
+  if (command == MINGHE_COMMAND_READ_ALL) {
+    return !set;
+  }
+  if (registerForCommand(command, &writable) == MINGHE_MODBUS_NO_REGISTER) {
+    return false;
+  }
+  return !set || (writable && (value <= 0xFFFF));
+}
+
+/*
+ * Address, function, register, then the register count for a read or the
+ * value for a write, all big endian.  Then the CRC, little endian.
+ */
+uint8_t MingHeModbus::buildRequest(uint8_t *frame, const uint8_t device_id,
+        const bool set, const char command, const uint32_t value) {
+  uint16_t crc = 0xFFFF, data;
+  uint8_t length = 0;
+
+  if (command == MINGHE_COMMAND_READ_ALL) {
+    register_ = 0;
+    data = MINGHE_MODBUS_BLOCK_REGISTERS;
+    block_valid_ = false;
+  } else {
+    register_ = registerForCommand(command);
+    data = set ? (uint16_t)value : 1;
+  }
+  function_ = set ? MINGHE_MODBUS_WRITE_REGISTER :
+          MINGHE_MODBUS_READ_REGISTERS;
+
+  frame[length++] = device_id;
+  frame[length++] = function_;
+  frame[length++] = 0;
+  frame[length++] = register_;
+  frame[length++] = data >> 8;
+  frame[length++] = data & 0xFF;
+  for (uint8_t i = 0; i < length; i++) {
+    crc = updateCrc(crc, frame[i]);
+  }
+  frame[length++] = crc & 0xFF;
+  frame[length++] = crc >> 8;
+
+  // Ready for the response.  A write comes straight back; a read's length is
+  // in its third byte.
+  device_id_ = device_id;
+  command_ = command;
+  written_ = data;
+  received_ = 0;
+  expected_ = set ? 8 : 0xFF;
+  crc_ = 0xFFFF;
+  exception_ = false;
+  value_ = 0;
+  return length;
+}
+
+/*
+ * As with the ASCII protocol, there's no buffering - the CRC runs as bytes
+ * arrive, register values are picked up as they go past, and the length is
+ * known from the header.
+ */
+uint8_t MingHeModbus::decodeByte(const uint8_t c) {
+  uint8_t data_index, expected;
+
+  crc_ = updateCrc(crc_, c);
+  received_++;
+
+  switch (received_) {
+    case 1:
+      if (c != device_id_) {
+        return MINGHE_STATUS_WRONG_DEVICE;
+      }
+      return MINGHE_STATUS_PENDING;
+
+    case 2:
+      // An exception is the function code with the top bit set, then a
+      // reason code, then the CRC.
+      if (c == (function_ | MINGHE_MODBUS_EXCEPTION)) {
+        exception_ = true;
+        expected_ = 5;
+      } else if (c != function_) {
+        return MINGHE_STATUS_BAD_RESPONSE;
+      }
+      return MINGHE_STATUS_PENDING;
+
+    case 3:
+      if (!exception_ && (function_ == MINGHE_MODBUS_READ_REGISTERS)) {
+        // Byte count - two per register asked for.
+        if (c != ((command_ == MINGHE_COMMAND_READ_ALL) ?
+                MINGHE_MODBUS_BLOCK_REGISTERS * 2 : 2)) {
+          return MINGHE_STATUS_BAD_RESPONSE;
+        }
+        expected_ = c + 5;
+        return MINGHE_STATUS_PENDING;
+      }
+      break;
+  }
+
+  if (received_ < expected_ - 1) {
+    if (exception_) {
+      return MINGHE_STATUS_PENDING;
+    }
+    if (function_ == MINGHE_MODBUS_WRITE_REGISTER) {
+      // The register and value written come back - they should match.
+      switch (received_) {
+        case 3: expected = 0; break;
+        case 4: expected = register_; break;
+        case 5: expected = written_ >> 8; break;
+        default: expected = written_ & 0xFF; break;
+      }
+      if (c != expected) {
+        return MINGHE_STATUS_BAD_RESPONSE;
+      }
+      return MINGHE_STATUS_PENDING;
+    }
+
+    // Register values, high byte first.
+    data_index = received_ - 4;
+    value_ = (data_index & 1) ? (value_ | c) : ((uint32_t)c << 8);
+    if ((command_ == MINGHE_COMMAND_READ_ALL) && (data_index & 1)) {
+      block_[data_index / 2] = value_;
+    }
+    return MINGHE_STATUS_PENDING;
+  }
+  if (received_ < expected_) {
+    return MINGHE_STATUS_PENDING;
+  }
+
+  if (crc_) {
+    return MINGHE_STATUS_CHECKSUM;
+  }
+  if (exception_) {
+    return MINGHE_STATUS_DEVICE_ERROR;
+  }
+  if (command_ == MINGHE_COMMAND_READ_ALL) {
+    block_valid_ = true;
+    value_ = 0;
+  } else if (function_ == MINGHE_MODBUS_WRITE_REGISTER) {
+    value_ = 0;
+  } else {
+    value_ = toValue(command_, value_);
+  }
+  return MINGHE_STATUS_OK;
+}
+
+bool MingHeModbus::getBlockValue(const char command, uint32_t *value) const {
+  uint8_t reg = registerForCommand(command);
+
+  if (!block_valid_ || (reg >= MINGHE_MODBUS_BLOCK_REGISTERS)) {
+    return false;
+  }
+  // With the output state in the same block, an idle output can be told
+  // apart from CV.
+  if ((command == MINGHE_COMMAND_LIMITING_FACTOR) &&
+          !block_[MINGHE_MODBUS_REGISTER_OUTPUT]) {
+    *value = MINGHE_LIMITING_FACTOR_OFF;
+    return true;
+  }
+  *value = toValue(command, block_[reg]);
+  return true;
+}
@@ -0,0 +1,105 @@
+/*
+ * Modbus-RTU protocol for the MingHe/DPS units that speak it instead of the
+ * ASCII protocol.  Hand one to MingHeBuckConverter::setProtocol and the usual
+ * getters and setters work as before, one register each.  The difference is
+ * MINGHE_COMMAND_READ_ALL (and so takeSnapshot): the set points, output
+ * voltage, current, power, limiting mode, output state, model and version all
+ * come back in one read of holding registers 0x00-0x0C.
+ *
+ * Register map, all 16 bits, in the same units as the ASCII protocol:
+ *
+ *   0x00 voltage limit (u)      0x07 protection state
+ *   0x01 current limit (i)      0x08 CV/CC (c)
+ *   0x02 output voltage (v)     0x09 output on/off (o)
+ *   0x03 output current (j)     0x0A backlight
+ *   0x04 output power (w)       0x0B model (z)
+ *   0x05 input voltage          0x0C version (r)
+ *   0x06 key lock
+ *
+ * The device only reports CV (0) or CC (1) - the limiting factor comes back
+ * as MINGHE_LIMITING_FACTOR_VOLTAGE or _CURRENT, and as _OFF with the output
+ * off if read along with the output state in a block.  Everything else the
+ * ASCII protocol has (temperatures, counters, memories, baud rate, address)
+ * is unsupported here.
+ *
+ * Reads use function 0x03, writes 0x06.  Responses are sized from their
+ * header, so the end of a frame is known without waiting out the 3.5
+ * character silence.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#ifndef __MING_HE_MODBUS_H__
+#define __MING_HE_MODBUS_H__
+
+#include "MingHeProtocol.h"
+
+#define MINGHE_MODBUS_READ_REGISTERS 0x03
+#define MINGHE_MODBUS_WRITE_REGISTER 0x06
+// Set on the function code of an exception response.
+#define MINGHE_MODBUS_EXCEPTION 0x80
+
+#define MINGHE_MODBUS_REGISTER_CV_CC 0x08
+#define MINGHE_MODBUS_REGISTER_OUTPUT 0x09
+// Registers 0x00 up to this are read by MINGHE_COMMAND_READ_ALL.
+#define MINGHE_MODBUS_BLOCK_REGISTERS 13
+// No register for a command.
+#define MINGHE_MODBUS_NO_REGISTER 0xFF
+
+class MingHeModbus : public MingHeProtocol {
+public:
+  MingHeModbus();
+
+  virtual bool supports(const bool set, const char command,
+          const uint32_t value) const;
+  virtual uint8_t buildRequest(uint8_t *frame, const uint8_t device_id,
+          const bool set, const char command, const uint32_t value);
+  virtual uint8_t decodeByte(const uint8_t c);
+  virtual bool awaitingStart(void) const { return !received_; }
+  virtual uint32_t getValue(void) const { return value_; }
+  virtual bool getBlockValue(const char command, uint32_t *value) const;
+
+  /**
+   * The register behind a command letter, and whether it can be written.
+   * MINGHE_MODBUS_NO_REGISTER if there isn't one.  Shared with the emulator.
+   */
+  static uint8_t registerForCommand(const char command, bool *writable = NULL);
+  // The other way round - 0 if no command maps to the register.
+  static char commandForRegister(const uint8_t reg);
+
+  // Modbus CRC-16 (polynomial 0xA001, starting at 0xFFFF).  It goes on the
+  // wire low byte first, and running it over a whole frame, CRC included,
+  // leaves 0.
+  static uint16_t updateCrc(uint16_t crc, const uint8_t c);
+
+private:
+  // The register value as the converter reports it.
+  static uint32_t toValue(const char command, const uint16_t raw);
+
+  // The request the response is for.
+  uint8_t device_id_;
+  uint8_t function_;
+  uint8_t register_;
+  uint16_t written_;
+  char command_;
+
+  // Bytes in so far, bytes expected in all, and the CRC so far.
+  uint8_t received_;
+  uint8_t expected_;
+  uint16_t crc_;
+  // Set if the response is an exception.
+  bool exception_;
+
+  uint32_t value_;
+  // Registers from the last block read, and whether it worked.
+  uint16_t block_[MINGHE_MODBUS_BLOCK_REGISTERS];
+  bool block_valid_;
+};
+
+#endif // __MING_HE_MODBUS_H__
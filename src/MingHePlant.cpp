@@ -0,0 +1,279 @@
+/*
+ * Electrical and thermal model for the emulator.  See MingHePlant.h.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#include "MingHeBuckConverter.h"
+#include "MingHePlant.h"
+
+// A 25C room, 5% of the output lost as heat, 2C/W still air and 0.8C/W with
+// the fan, and a minute to heat up.
+#define PLANT_DEFAULT_AMBIENT_C 25
+#define PLANT_DEFAULT_LOSS_PERCENT 5
+#define PLANT_DEFAULT_RISE_PER_WATT 20
+#define PLANT_DEFAULT_FAN_RISE_PER_WATT 8
+#define PLANT_DEFAULT_TIME_CONSTANT_S 60
+
+// Heating is capped this far above ambient, in millidegrees, which keeps the
+// integer maths in range.
+#define PLANT_MAX_RISE_MDEG 150000UL
+
+#define UDEG_PER_DEG 1000000L
+
+MingHePlant::MingHePlant() {
+  MingHeThermal thermal = {PLANT_DEFAULT_AMBIENT_C, PLANT_DEFAULT_LOSS_PERCENT,
+      PLANT_DEFAULT_RISE_PER_WATT, PLANT_DEFAULT_FAN_RISE_PER_WATT,
+      PLANT_DEFAULT_TIME_CONSTANT_S};
+
+  setOpenLoad();
+  memset(&battery_, 0, sizeof(battery_));
+  charge_mas_ = charge_rem_ = 0;
+  setSlew(0, 0);
+  setThermal(thermal);
+  temperature_udeg_ = thermal.ambient_c * UDEG_PER_DEG;
+  fan_on_ = false;
+  time_scale_ = 1;
+  last_update_us_ = micros();
+  ramp_uv_ = ramp_ua_ = 0;
+  voltage_mv_ = current_ma_ = 0;
+  limiting_factor_ = MINGHE_LIMITING_FACTOR_OFF;
+  delivered_mas_ = delivered_rem_ = 0;
+  on_ms_ = 0;
+}
+
+void MingHePlant::setOpenLoad(void) {
+  load_ = MINGHE_LOAD_OPEN;
+}
+
+// A dead short is 1 milliohm, to keep the divisions sane.
+void MingHePlant::setResistiveLoad(const uint32_t resistance_mohm) {
+  load_ = MINGHE_LOAD_RESISTOR;
+  resistance_mohm_ = resistance_mohm ? resistance_mohm : 1;
+}
+
+void MingHePlant::setBatteryLoad(const MingHeBattery &battery) {
+  load_ = MINGHE_LOAD_BATTERY;
+  battery_ = battery;
+  if (!battery_.resistance_mohm) {
+    battery_.resistance_mohm = 1;
+  }
+  if (battery_.soc_permille > 1000) {
+    battery_.soc_permille = 1000;
+  }
+  // mAh to mA seconds is 3600 - do the permille in the same go.
+  charge_mas_ = ((uint32_t)battery_.capacity_mah * 36UL *
+          battery_.soc_permille) / 10;
+  charge_rem_ = 0;
+}
+
+void MingHePlant::setSlew(const uint16_t voltage_per_s,
+        const uint16_t current_per_s) {
+  voltage_slew_ = voltage_per_s;
+  current_slew_ = current_per_s;
+}
+
+void MingHePlant::setThermal(const MingHeThermal &thermal) {
+  thermal_ = thermal;
+}
+
+uint32_t MingHePlant::getWatts(void) const {
+  return (voltage_mv_ * current_ma_) / 1000;
+}
+
+uint8_t MingHePlant::getTemperature(void) const {
+  if (temperature_udeg_ <= 0) {
+    return 0;
+  }
+  return (temperature_udeg_ + (UDEG_PER_DEG / 2)) / UDEG_PER_DEG;
+}
+
+uint16_t MingHePlant::getSocPermille(void) const {
+  if ((load_ != MINGHE_LOAD_BATTERY) || !battery_.capacity_mah) {
+    return 0;
+  }
+  return ((charge_mas_ / 36) * 10) / battery_.capacity_mah;
+}
+
+// Charge over capacity, in mA seconds per mAh, goes up to 3600 - fine enough
+// for a millivolt at a time.
+uint32_t MingHePlant::batteryVoltage(void) const {
+  uint32_t span_mv = (uint32_t)(battery_.full_voltage -
+          battery_.empty_voltage) * 10;
+
+  if (!battery_.capacity_mah) {
+    return (uint32_t)battery_.empty_voltage * 10;
+  }
+  return (uint32_t)battery_.empty_voltage * 10 +
+          (span_mv * (charge_mas_ / battery_.capacity_mah)) / 3600;
+}
+
+uint32_t MingHePlant::takeMampHours(void) {
+  uint32_t mamp_hours = delivered_mas_ / 3600;
+
+  delivered_mas_ -= mamp_hours * 3600;
+  return mamp_hours;
+}
+
+uint32_t MingHePlant::takeOnSeconds(void) {
+  uint32_t seconds = on_ms_ / 1000;
+
+  on_ms_ -= seconds * 1000;
+  return seconds;
+}
+
+// Whole milliseconds only, so nothing is lost to rounding between calls.
+void MingHePlant::update(MingHePlantInput &input) {
+  uint32_t elapsed_ms = (micros() - last_update_us_) / 1000;
+
+  last_update_us_ += elapsed_ms * 1000;
+  step(elapsed_ms * time_scale_, input);
+}
+
+void MingHePlant::step(uint32_t simulated_ms, MingHePlantInput &input) {
+  uint16_t dt_ms;
+
+  while (simulated_ms) {
+    dt_ms = (simulated_ms > MINGHE_PLANT_STEP_MS) ? MINGHE_PLANT_STEP_MS :
+            simulated_ms;
+    stepOnce(dt_ms, input);
+    simulated_ms -= dt_ms;
+  }
+}
+
+// Move a limit (in micro units) towards its target by no more than the slew
+// allows.  The slew is in hundredths per second, which is 10 micro units per
+// millisecond.
+static uint32_t slewTowards(const uint32_t now, const uint32_t target,
+        const uint16_t slew, const uint16_t dt_ms) {
+  uint32_t limit = (uint32_t)slew * 10 * dt_ms;
+
+  if (!slew) {
+    return target;
+  }
+  if (target > now) {
+    return ((target - now) > limit) ? (now + limit) : target;
+  }
+  return ((now - target) > limit) ? (now - limit) : target;
+}
+
+/*
+ * CV until the load wants more than the current limit, then CC.  A CC voltage
+ * is always below the voltage limit, so the products stay in range.
+ */
+void MingHePlant::solve(const uint32_t limit_mv, const uint32_t limit_ma) {
+  uint32_t open_mv, want_ma;
+
+  limiting_factor_ = MINGHE_LIMITING_FACTOR_VOLTAGE;
+  switch (load_) {
+    case MINGHE_LOAD_RESISTOR:
+      want_ma = (limit_mv * 1000) / resistance_mohm_;
+      if (want_ma > limit_ma) {
+        current_ma_ = limit_ma;
+        voltage_mv_ = (limit_ma * resistance_mohm_) / 1000;
+        limiting_factor_ = MINGHE_LIMITING_FACTOR_CURRENT;
+      } else {
+        current_ma_ = want_ma;
+        voltage_mv_ = limit_mv;
+      }
+      break;
+
+    case MINGHE_LOAD_BATTERY:
+      // Nothing flows into a battery that's already above the limit.
+      open_mv = batteryVoltage();
+      if (limit_mv <= open_mv) {
+        current_ma_ = 0;
+        voltage_mv_ = open_mv;
+        break;
+      }
+      want_ma = ((limit_mv - open_mv) * 1000) / battery_.resistance_mohm;
+      if (want_ma > limit_ma) {
+        current_ma_ = limit_ma;
+        voltage_mv_ = open_mv +
+                (limit_ma * battery_.resistance_mohm) / 1000;
+        limiting_factor_ = MINGHE_LIMITING_FACTOR_CURRENT;
+      } else {
+        current_ma_ = want_ma;
+        voltage_mv_ = limit_mv;
+      }
+      break;
+
+    default:
+      current_ma_ = 0;
+      voltage_mv_ = limit_mv;
+      break;
+  }
+}
+
+void MingHePlant::stepOnce(const uint16_t dt_ms, MingHePlantInput &input) {
+  uint32_t rise_mdeg, capacity_mas;
+  int32_t target_udeg;
+  uint16_t rise_per_watt;
+
+  if (input.output_enabled) {
+    // Fast voltage change skips the voltage ramp.
+    ramp_uv_ = slewTowards(ramp_uv_, input.max_voltage * 10000UL,
+            input.fast_voltage_change ? 0 : voltage_slew_, dt_ms);
+    ramp_ua_ = slewTowards(ramp_ua_, input.max_current * 10000UL,
+            current_slew_, dt_ms);
+    solve(ramp_uv_ / 1000, ramp_ua_ / 1000);
+    on_ms_ += dt_ms;
+  } else {
+    // Soft start from nothing next time.
+    ramp_uv_ = ramp_ua_ = 0;
+    current_ma_ = 0;
+    voltage_mv_ = (load_ == MINGHE_LOAD_BATTERY) ? batteryVoltage() : 0;
+    limiting_factor_ = MINGHE_LIMITING_FACTOR_OFF;
+  }
+
+  if (current_ma_) {
+    delivered_rem_ += current_ma_ * dt_ms;
+    delivered_mas_ += delivered_rem_ / 1000;
+    delivered_rem_ %= 1000;
+
+    if (load_ == MINGHE_LOAD_BATTERY) {
+      capacity_mas = battery_.capacity_mah * 3600UL;
+      charge_rem_ += current_ma_ * dt_ms;
+      charge_mas_ += charge_rem_ / 1000;
+      charge_rem_ %= 1000;
+      if (charge_mas_ >= capacity_mas) {
+        charge_mas_ = capacity_mas;
+        charge_rem_ = 0;
+      }
+    }
+  }
+
+  // Heat.  Loss in mW times tenths of a degree per watt is tenths of a
+  // millidegree.
+  fan_on_ = (temperature_udeg_ >=
+          (int32_t)input.fan_start_temperature * UDEG_PER_DEG);
+  rise_per_watt = fan_on_ ? thermal_.fan_rise_per_watt :
+          thermal_.rise_per_watt;
+  rise_mdeg = (getWatts() * thermal_.loss_percent) / 100;
+  if (rise_per_watt &&
+          (rise_mdeg > (PLANT_MAX_RISE_MDEG * 10) / rise_per_watt)) {
+    rise_mdeg = PLANT_MAX_RISE_MDEG;
+  } else {
+    rise_mdeg = (rise_mdeg * rise_per_watt) / 10;
+  }
+  target_udeg = (int32_t)thermal_.ambient_c * UDEG_PER_DEG +
+          (int32_t)rise_mdeg * 1000;
+  if (!thermal_.time_constant_s) {
+    temperature_udeg_ = target_udeg;
+  } else {
+    temperature_udeg_ += ((target_udeg - temperature_udeg_) /
+            (int32_t)thermal_.time_constant_s) * dt_ms / 1000;
+  }
+
+  // Over temperature protection.
+  if (input.output_enabled && (temperature_udeg_ >=
+          (int32_t)input.shutdown_temperature * UDEG_PER_DEG)) {
+    input.output_enabled = false;
+  }
+}
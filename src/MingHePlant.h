@@ -0,0 +1,176 @@
+/*
+ * A simple electrical and thermal model of what's on the output of an
+ * emulated converter, for running charging, MPPT or sequencing logic against
+ * MingHeEmulator without hardware.  Hand one to MingHeEmulator::setPlant and
+ * the output voltage, current, power, limiting factor and temperature the
+ * driver reads come from here, instead of an unloaded output at the limit.
+ *
+ * The load is open, a resistor, or a battery with an internal resistance and
+ * a state of charge that follows the current put in.  The converter behaves
+ * as a CV/CC supply: it holds the voltage limit until the load would draw more
+ * than the current limit, then holds the current, and the limiting factor
+ * follows.  It can't sink current, so a battery above the voltage limit just
+ * sits there.  Limits can slew rather than jump (unless fast voltage change is
+ * on), starting from zero each time the output is switched on.
+ *
+ * The heatsink is a single thermal mass: a share of the output power is lost
+ * as heat, the temperature heads for ambient plus loss times thermal
+ * resistance with the given time constant, and the fan (from the fan start
+ * temperature) lowers the thermal resistance.  At the shutdown temperature the
+ * output trips off, as on the real thing.
+ *
+ * Everything is integer - millivolts, milliamps, milliohms and millionths of a
+ * degree - so it's cheap enough on an AVR.  Simulated time runs at
+ * setTimeScale times real time, so a two hour charge can run in a minute, or
+ * can be stepped by hand with step.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#ifndef __MING_HE_PLANT_H__
+#define __MING_HE_PLANT_H__
+
+#include <Arduino.h>
+
+#define MINGHE_LOAD_OPEN 0
+#define MINGHE_LOAD_RESISTOR 1
+#define MINGHE_LOAD_BATTERY 2
+
+// Longest simulated step taken at once.  Longer stretches are split up, so the
+// battery and heatsink see the current change as they go.
+#define MINGHE_PLANT_STEP_MS 10
+
+/**
+ * A battery.  Open circuit voltage runs in a straight line from empty to full
+ * with the state of charge.  Voltages are volts * 100, as everywhere else.
+ */
+struct MingHeBattery {
+  uint16_t empty_voltage;
+  uint16_t full_voltage;
+  uint16_t capacity_mah;
+  uint16_t resistance_mohm;
+  // State of charge to start at, per thousand.
+  uint16_t soc_permille;
+};
+
+/**
+ * The heatsink.  loss_percent of the output power turns into heat.  With that
+ * loss held, the temperature settles at ambient plus the loss times the
+ * thermal resistance (tenths of a degree per watt, without and with the fan),
+ * getting most of the way there in time_constant_s.
+ */
+struct MingHeThermal {
+  uint8_t ambient_c;
+  uint8_t loss_percent;
+  uint16_t rise_per_watt;
+  uint16_t fan_rise_per_watt;
+  uint16_t time_constant_s;
+};
+
+/**
+ * The converter's side of things, as the emulator has it set up.  Limits are
+ * volts and amps * 100.  The plant clears output_enabled if it trips on
+ * temperature.
+ */
+struct MingHePlantInput {
+  uint16_t max_voltage;
+  uint16_t max_current;
+  bool output_enabled;
+  bool fast_voltage_change;
+  uint8_t fan_start_temperature;
+  uint8_t shutdown_temperature;
+};
+
+class MingHePlant {
+public:
+  // Open load, no slew, 25C ambient, and simulated time at real time.
+  MingHePlant();
+
+  // The load.  Each replaces whatever was there.
+  void setOpenLoad(void);
+  void setResistiveLoad(const uint32_t resistance_mohm);
+  void setBatteryLoad(const MingHeBattery &battery);
+
+  /**
+   * How fast the voltage and current limits move, in volts and amps * 100 per
+   * simulated second.  0 (the default) is instant.
+   */
+  void setSlew(const uint16_t voltage_per_s, const uint16_t current_per_s);
+
+  void setThermal(const MingHeThermal &thermal);
+
+  // Simulated milliseconds per real one.  1 is real time.
+  void setTimeScale(const uint16_t scale) { time_scale_ = scale; }
+
+  /**
+   * Bring the model up to now, in real time times the time scale.  The
+   * emulator does this on every request.
+   */
+  void update(MingHePlantInput &input);
+
+  // Run the model on by simulated_ms, regardless of the clock.
+  void step(uint32_t simulated_ms, MingHePlantInput &input);
+
+  // What the converter measures, in the units the protocol uses - volts and
+  // amps * 100, milliwatts, and whole degrees.
+  uint16_t getVoltage(void) const { return voltage_mv_ / 10; }
+  uint16_t getCurrent(void) const { return current_ma_ / 10; }
+  uint32_t getWatts(void) const;
+  // One of the MINGHE_LIMITING_FACTOR_ values.
+  uint8_t getLimitingFactor(void) const { return limiting_factor_; }
+  uint8_t getTemperature(void) const;
+  bool isFanOn(void) const { return fan_on_; }
+
+  // State of charge of the battery, per thousand.
+  uint16_t getSocPermille(void) const;
+
+  /**
+   * Whole mAh put out and whole seconds with the output on since the last
+   * call, for the emulator's counters.  Anything left over carries on.
+   */
+  uint32_t takeMampHours(void);
+  uint32_t takeOnSeconds(void);
+
+private:
+  // One step of no more than MINGHE_PLANT_STEP_MS.
+  void stepOnce(const uint16_t dt_ms, MingHePlantInput &input);
+  // Work out the output from the limits as they are right now.
+  void solve(const uint32_t limit_mv, const uint32_t limit_ma);
+  // Open circuit voltage of the battery, in mV.
+  uint32_t batteryVoltage(void) const;
+
+  uint8_t load_;
+  uint32_t resistance_mohm_;
+  MingHeBattery battery_;
+  // Charge in the battery, in mA seconds and the mA ms over.
+  uint32_t charge_mas_;
+  uint32_t charge_rem_;
+
+  uint16_t voltage_slew_, current_slew_;
+  // Where the limits have got to on their way, in uV and uA.
+  uint32_t ramp_uv_, ramp_ua_;
+
+  MingHeThermal thermal_;
+  // Heatsink temperature, in millionths of a degree.
+  int32_t temperature_udeg_;
+  bool fan_on_;
+
+  uint16_t time_scale_;
+  uint32_t last_update_us_;
+
+  uint32_t voltage_mv_, current_ma_;
+  uint8_t limiting_factor_;
+
+  // Output for the counters, not yet handed over.
+  uint32_t delivered_mas_;
+  uint32_t delivered_rem_;
+  uint32_t on_ms_;
+};
+
+#endif // __MING_HE_PLANT_H__
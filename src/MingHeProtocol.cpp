@@ -0,0 +1,226 @@
+/*
+ * The ASCII protocol.  See MingHeProtocol.h.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#include "MingHeBuckConverter.h"
+#include "MingHeProtocol.h"
+
+// Response checksum tracking, unless it's compiled out.
+#if MINGHE_ENABLE_RX_CHECKSUM
+#define RX_CHECKSUM_RESET() checksum_.reset()
+#define RX_CHECKSUM_ADD(c) checksum_.addOutputCharacter(c)
+#else
+#define RX_CHECKSUM_RESET()
+#define RX_CHECKSUM_ADD(c)
+#endif
+
+// Where the decoder is in the frame.
+#define DECODE_START 0
+#define DECODE_ADDRESS_HIGH 1
+#define DECODE_ADDRESS_LOW 2
+#define DECODE_BODY 3
+
+// Which of the three possible replies the body still matches.
+#define DECODE_MATCH_VALUE 0x01
+#define DECODE_MATCH_OK 0x02
+#define DECODE_MATCH_ERR 0x04
+
+const char PROGMEM response_ok[] = "ok";
+const char PROGMEM response_err[] = "err";
+
+MingHeAsciiProtocol::MingHeAsciiProtocol() {
+  phase_ = DECODE_START;
+  value_ = 0;
+}
+
+// Anything but a block read - the device answers "err" to letters it doesn't
+// know.
+bool MingHeAsciiProtocol::supports(const bool /* set */, const char command,
+        const uint32_t /* value */) const {
+  return command != MINGHE_COMMAND_READ_ALL;
+}
+
+/*
+ * For a set, the value goes out in decimal after the prefix and command, built
+ * straight into the frame rather than pulling in ultoa for it.
+ */
+uint8_t MingHeAsciiProtocol::buildRequest(uint8_t *frame,
+        const uint8_t device_id, const bool set, const char command,
+        const uint32_t value) {
+  char digits[MINGHE_MAX_VALUE_DIGITS];
+  uint8_t length = 0, digit_count = 0;
+  uint32_t remaining = value;
+
+  frame[length++] = ':';
+
+  // Device ID is always 2 characters.
+  frame[length++] = '0' + (device_id / 10);
+  frame[length++] = '0' + (device_id % 10);
+
+  // If a set command, the command prefix is s, otherwise read with r.
+  frame[length++] = set ? 's' : 'r';
+
+  frame[length++] = command;
+
+  // Digits come out least significant first - stack them up, then add them
+  // in the right order.
+  if (set) {
+    do {
+      digits[digit_count++] = '0' + (remaining % 10);
+      remaining /= 10;
+    } while (remaining);
+    while (digit_count) {
+      frame[length++] = digits[--digit_count];
+    }
+  }
+
+  // The checksum - this is not included in value as it's dependent on the
+  // device ID.
+  checksum_.reset();
+  for (uint8_t i = 0; i < length; i++) {
+    checksum_.addOutputCharacter(frame[i]);
+  }
+  frame[length++] = checksum_.getChecksumCharacter();
+  frame[length++] = '\n';
+
+  // Ready for the response.
+  device_id_ = device_id;
+  set_ = set;
+  command_ = command;
+  phase_ = DECODE_START;
+  length_ = 0;
+  matches_ = DECODE_MATCH_ERR | (set ? DECODE_MATCH_OK : DECODE_MATCH_VALUE);
+  value_ = 0;
+  return length;
+}
+
+bool MingHeAsciiProtocol::awaitingStart(void) const {
+  return phase_ == DECODE_START;
+}
+
+/*
+ * Decode a response, straight off the wire, a byte at a time.  There's no
+ * buffering - each byte is checked against what is expected next as it
+ * arrives, and the value digits are added into the result as they come.
+ *
+ * A reply to a read is "r", the command letter, and the value in decimal.  A
+ * reply to a set is "ok".  Either can be "err" instead.  All sit between the
+ * ':' and address, and the LRC character (the only upper case letter), so
+ * whatever the body turns out to be, it is read through to the LRC before it's
+ * judged - a bit flip in the body is rejected, usually as a checksum error,
+ * rather than taken as a strange reply.  One in the address digits is caught
+ * there, as a wrong device.
+ */
+uint8_t MingHeAsciiProtocol::decodeByte(const uint8_t c) {
+  switch (phase_) {
+    case DECODE_START:
+      // Trailing newlines from the last response may still be ahead of the
+      // frame.  Skip to the ':', but if enough junk is read, something is
+      // wrong, and the read has failed.
+      if (c != ':') {
+        if (++length_ >= MINGHE_MAX_JUNK_CHARACTERS) {
+          return MINGHE_STATUS_BAD_RESPONSE;
+        }
+        return MINGHE_STATUS_PENDING;
+      }
+      RX_CHECKSUM_RESET();
+      RX_CHECKSUM_ADD(c);
+      phase_ = DECODE_ADDRESS_HIGH;
+      return MINGHE_STATUS_PENDING;
+
+    // Next two bytes are the device ID.  If it does not match, the reply is
+    // not from this unit - fail.
+    case DECODE_ADDRESS_HIGH:
+      RX_CHECKSUM_ADD(c);
+      if (!isdigit(c)) {
+        return MINGHE_STATUS_WRONG_DEVICE;
+      }
+      address_ = (uint8_t)(c - '0') * 10;
+      phase_ = DECODE_ADDRESS_LOW;
+      return MINGHE_STATUS_PENDING;
+
+    case DECODE_ADDRESS_LOW:
+      RX_CHECKSUM_ADD(c);
+      if (!isdigit(c) || ((uint8_t)(address_ + (c - '0')) != device_id_)) {
+        return MINGHE_STATUS_WRONG_DEVICE;
+      }
+      phase_ = DECODE_BODY;
+      length_ = 0;
+      return MINGHE_STATUS_PENDING;
+  }
+
+  // The body, up to the LRC.
+  if (isupper(c)) {
+    return finishDecode(c);
+  }
+  // Longer than anything the device sends.
+  if (++length_ > MINGHE_MAX_RESPONSE_BODY) {
+    return MINGHE_STATUS_BAD_RESPONSE;
+  }
+  RX_CHECKSUM_ADD(c);
+
+  if ((length_ > 3) ||
+          (c != (uint8_t)pgm_read_byte_near(response_err + length_ - 1))) {
+    matches_ &= ~DECODE_MATCH_ERR;
+  }
+  if ((length_ > 2) ||
+          (c != (uint8_t)pgm_read_byte_near(response_ok + length_ - 1))) {
+    matches_ &= ~DECODE_MATCH_OK;
+  }
+  if (!(matches_ & DECODE_MATCH_VALUE)) {
+    return MINGHE_STATUS_PENDING;
+  }
+  if (length_ == 1) {
+    if (c != 'r') {
+      matches_ &= ~DECODE_MATCH_VALUE;
+    }
+  } else if (length_ == 2) {
+    if (c != (uint8_t)command_) {
+      matches_ &= ~DECODE_MATCH_VALUE;
+    }
+  } else if (!isdigit(c) || (length_ > MINGHE_MAX_VALUE_DIGITS + 2) ||
+          (value_ > (0xFFFFFFFFUL - (c - '0')) / 10)) {
+    // Not a number, or more than fits in a uint32.
+    matches_ &= ~DECODE_MATCH_VALUE;
+  } else {
+    value_ = (value_ * 10) + (c - '0');
+  }
+  return MINGHE_STATUS_PENDING;
+}
+
+/*
+ * The trailing newline isn't waited for - it's skipped as junk ahead of the
+ * next response's ':'.  The driver still allows for its time on the wire
+ * before the next request (see trailerLength).
+ */
+uint8_t MingHeAsciiProtocol::finishDecode(const char lrc) {
+#if MINGHE_ENABLE_RX_CHECKSUM
+  if (lrc != checksum_.getChecksumCharacter()) {
+    return MINGHE_STATUS_CHECKSUM;
+  }
+#else
+  (void)lrc;
+#endif
+
+  // A well formed "err" means the device understood, and said no.
+  if ((matches_ & DECODE_MATCH_ERR) && (length_ == 3)) {
+    return MINGHE_STATUS_DEVICE_ERROR;
+  }
+  if ((matches_ & DECODE_MATCH_OK) && (length_ == 2)) {
+    return MINGHE_STATUS_OK;
+  }
+  // "r", the command, and at least one digit.
+  if ((matches_ & DECODE_MATCH_VALUE) && (length_ >= 3)) {
+    return MINGHE_STATUS_OK;
+  }
+  // Not for the command sent, or garbage.
+  return MINGHE_STATUS_BAD_RESPONSE;
+}
@@ -0,0 +1,113 @@
+/*
+ * Wire protocols for talking to MingHe converters.  MingHeBuckConverter does
+ * the timing, retries and bookkeeping, and hands the framing of requests and
+ * the decoding of responses to one of these.  The original ASCII protocol
+ * (":01rv...") is built in and used unless told otherwise.  MingHeModbus has
+ * the Modbus-RTU protocol spoken by some newer units.
+ *
+ * A protocol object holds the state of the response being decoded, so each
+ * converter needs its own.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#ifndef __MING_HE_PROTOCOL_H__
+#define __MING_HE_PROTOCOL_H__
+
+#include <Arduino.h>
+
+#include "MingHeChecksum.h"
+
+class MingHeProtocol {
+public:
+  virtual ~MingHeProtocol() {}
+
+  /**
+   * True if this protocol can send the request at all.  Commands it has no
+   * way to express fail with MINGHE_STATUS_UNSUPPORTED, and nothing is sent.
+   */
+  virtual bool supports(const bool set, const char command,
+          const uint32_t value) const = 0;
+
+  /**
+   * Build a request into frame, which has room for MINGHE_MAX_REQUEST_LENGTH
+   * bytes, and get ready to decode the response to it.  Returns the length.
+   */
+  virtual uint8_t buildRequest(uint8_t *frame, const uint8_t device_id,
+          const bool set, const char command, const uint32_t value) = 0;
+
+  /**
+   * Take the next byte of the response.  Returns MINGHE_STATUS_PENDING until
+   * the frame is complete or has gone wrong, then one of the MINGHE_STATUS_
+   * values.
+   */
+  virtual uint8_t decodeByte(const uint8_t c) = 0;
+
+  // True until the response proper has started, so the wait for it gets the
+  // response timeout rather than the inter-character one.
+  virtual bool awaitingStart(void) const = 0;
+
+  // The value from the last response decoded OK.
+  virtual uint32_t getValue(void) const = 0;
+
+  // Bytes the device sends after the byte that completes a response, which
+  // are still on the wire when it is decoded.
+  virtual uint8_t trailerLength(void) const { return 0; }
+
+  /**
+   * After a successful get of MINGHE_COMMAND_READ_ALL, the value of one of
+   * the commands the block covered.  False if it wasn't in the block, or
+   * this protocol can't read blocks.
+   */
+  virtual bool getBlockValue(const char /* command */,
+          uint32_t * /* value */) const {
+    return false;
+  }
+};
+
+/**
+ * The ASCII protocol: ':', the two digit address, 'r' or 's', the command
+ * letter, the value in decimal for a set, an LRC letter and a newline.  See
+ * MingHeChecksum.h for the LRC.
+ */
+class MingHeAsciiProtocol : public MingHeProtocol {
+public:
+  MingHeAsciiProtocol();
+
+  virtual bool supports(const bool set, const char command,
+          const uint32_t value) const;
+  virtual uint8_t buildRequest(uint8_t *frame, const uint8_t device_id,
+          const bool set, const char command, const uint32_t value);
+  virtual uint8_t decodeByte(const uint8_t c);
+  virtual bool awaitingStart(void) const;
+  virtual uint32_t getValue(void) const { return value_; }
+  // The CR LF after the LRC.
+  virtual uint8_t trailerLength(void) const { return 2; }
+
+private:
+  // The LRC is in - check it, and work out what the body was.
+  uint8_t finishDecode(const char lrc);
+
+  MingHeBuckConverterChecksum checksum_;
+
+  // The request the response is for.
+  uint8_t device_id_;
+  bool set_;
+  char command_;
+
+  // Where the decoder is in the frame, bytes into that part (or junk skipped
+  // ahead of the ':'), which replies the body still matches, and the value.
+  uint8_t phase_;
+  uint8_t length_;
+  uint8_t matches_;
+  uint8_t address_;
+  uint32_t value_;
+};
+
+#endif // __MING_HE_PROTOCOL_H__
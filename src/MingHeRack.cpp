@@ -0,0 +1,146 @@
+/*
+ * Several emulated converters sharing one line.  See MingHeRack.h.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#include "MingHeRack.h"
+
+MingHeRack::MingHeRack() {
+  unit_count_ = 0;
+  head_ = count_ = 0;
+  echo_ = false;
+  char_time_us_ = (uint16_t)(10000000UL / 9600);
+  resetCounters();
+}
+
+bool MingHeRack::addUnit(MingHeEmulator *unit) {
+  if (unit_count_ >= MINGHE_RACK_MAX_UNITS) {
+    return false;
+  }
+  units_[unit_count_++] = unit;
+  return true;
+}
+
+MingHeEmulator *MingHeRack::getUnit(const uint8_t index) const {
+  if (index >= unit_count_) {
+    return NULL;
+  }
+  return units_[index];
+}
+
+void MingHeRack::setBaudRate(const uint32_t baud_rate) {
+  char_time_us_ = (uint16_t)(10000000UL / baud_rate);
+  for (uint8_t i = 0; i < unit_count_; i++) {
+    units_[i]->setBaudRate(baud_rate);
+  }
+}
+
+void MingHeRack::resetCounters(void) {
+  memset(&counters_, 0, sizeof(counters_));
+}
+
+void MingHeRack::queueByte(const uint8_t c) {
+  if (count_ >= MINGHE_RACK_BUFFER) {
+    counters_.overflows++;
+    return;
+  }
+  buffer_[(head_ + count_) % MINGHE_RACK_BUFFER] = c;
+  count_++;
+}
+
+/*
+ * Take the earliest byte on the line once it's complete, along with any byte
+ * from another unit that started within a character time of it.  Anything
+ * that overlaps has started by the time the first is complete, so it has been
+ * released by its unit.
+ */
+void MingHeRack::pump(void) {
+  uint32_t now_us, first_us, unit_us;
+  int8_t first;
+  uint8_t c;
+
+  for (;;) {
+    now_us = micros();
+    first = -1;
+    first_us = 0;
+    for (uint8_t i = 0; i < unit_count_; i++) {
+      if (!units_[i]->available()) {
+        continue;
+      }
+      unit_us = units_[i]->getNextByteUs();
+      if ((first < 0) || ((int32_t)(unit_us - first_us) < 0)) {
+        first = i;
+        first_us = unit_us;
+      }
+    }
+    if ((first < 0) || ((int32_t)(now_us - first_us) < char_time_us_)) {
+      return;
+    }
+
+    c = units_[first]->read();
+    for (uint8_t i = 0; i < unit_count_; i++) {
+      if ((i == first) || !units_[i]->available()) {
+        continue;
+      }
+      if ((int32_t)(units_[i]->getNextByteUs() - first_us) < char_time_us_) {
+        c &= units_[i]->read();
+        counters_.collided_bytes++;
+      }
+    }
+    queueByte(c);
+  }
+}
+
+int MingHeRack::available(void) {
+  pump();
+  return count_;
+}
+
+int MingHeRack::peek(void) {
+  pump();
+  if (!count_) {
+    return -1;
+  }
+  return buffer_[head_];
+}
+
+int MingHeRack::read(void) {
+  uint8_t c;
+
+  pump();
+  if (!count_) {
+    return -1;
+  }
+  c = buffer_[head_];
+  head_ = (head_ + 1) % MINGHE_RACK_BUFFER;
+  count_--;
+  return c;
+}
+
+/*
+ * Talking over a unit garbles the byte for everyone.  Inverting it is enough
+ * to break the frame it's in.
+ */
+size_t MingHeRack::write(uint8_t c) {
+  for (uint8_t i = 0; i < unit_count_; i++) {
+    if (units_[i]->isTransmitting()) {
+      c = ~c;
+      counters_.collided_requests++;
+      break;
+    }
+  }
+  for (uint8_t i = 0; i < unit_count_; i++) {
+    units_[i]->write(c);
+  }
+  if (echo_) {
+    queueByte(c);
+  }
+  return 1;
+}
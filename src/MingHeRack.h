@@ -0,0 +1,94 @@
+/*
+ * A rack of emulated converters on one half-duplex line, for scaling tests of
+ * bus scheduling, discovery scans and whole-rack operations without a rack of
+ * hardware.  It looks like a Stream: hand it to every MingHeBuckConverter (or
+ * a MingHeBus full of them) in place of the serial port, and add a
+ * MingHeEmulator for each address that should answer.
+ *
+ * Every unit hears every request, and ignores the ones that aren't for it.
+ * Their replies share the line, each at its own emulated timing - give units
+ * their own fault profiles for slow or flaky ones.  A unit that answers late,
+ * after the master has given up and moved on, lands on top of the next
+ * unit's reply.  Where two units' bytes overlap on the wire, what comes out is
+ * the two ANDed together (the way a line driven low by either reads), and the
+ * frame is all but certain to fail its checksum.  Likewise, a request sent
+ * while a unit is still talking reaches the units garbled.
+ *
+ * Bytes are handed over once their stop bit is done, in the order they went
+ * on the wire, whichever unit they came from.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#ifndef __MING_HE_RACK_H__
+#define __MING_HE_RACK_H__
+
+#include <Arduino.h>
+
+#include "MingHeEmulator.h"
+
+// Units per rack.  Each slot costs a pointer of SRAM - the emulators cost a
+// lot more.
+#define MINGHE_RACK_MAX_UNITS 32
+// Bytes off the line not yet read by the driver.
+#define MINGHE_RACK_BUFFER 64
+
+// What happened on the shared line, on top of each unit's own counters.
+struct MingHeRackCounters {
+  // Reply bytes that went on the wire while another unit was sending.
+  uint32_t collided_bytes;
+  // Request bytes sent while a unit was still replying.
+  uint32_t collided_requests;
+  // Bytes lost because the driver didn't read them in time.
+  uint32_t overflows;
+};
+
+class MingHeRack : public Stream {
+public:
+  MingHeRack();
+
+  // Add a unit to the line.  Not owned.  Returns false if the rack is full.
+  bool addUnit(MingHeEmulator *unit);
+  uint8_t getUnitCount(void) const { return unit_count_; }
+  MingHeEmulator *getUnit(const uint8_t index) const;
+
+  // Line speed, passed on to every unit.
+  void setBaudRate(const uint32_t baud_rate);
+
+  // Hear our own requests, as with an RS-485 transceiver's receiver left on.
+  void setEcho(const bool enabled) { echo_ = enabled; }
+
+  void resetCounters(void);
+  const MingHeRackCounters &getCounters(void) const { return counters_; }
+
+  // Stream interface.
+  virtual int available(void);
+  virtual int read(void);
+  virtual int peek(void);
+  virtual size_t write(uint8_t c);
+  virtual void flush(void) {}
+  using Print::write;
+
+private:
+  // Move whatever has finished crossing the line into the buffer.
+  void pump(void);
+  void queueByte(const uint8_t c);
+
+  MingHeEmulator *units_[MINGHE_RACK_MAX_UNITS];
+  uint8_t unit_count_;
+
+  uint8_t buffer_[MINGHE_RACK_BUFFER];
+  uint8_t head_, count_;
+
+  uint16_t char_time_us_;
+  bool echo_;
+  MingHeRackCounters counters_;
+};
+
+#endif // __MING_HE_RACK_H__
@@ -0,0 +1,193 @@
+/*
+ * Internal resistance from a current step.  See MingHeResistance.h.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#include "MingHeResistance.h"
+
+// Phases of a measurement: reading the limit, the frames, putting the limit
+// back, and over.
+#define PHASE_READ_LIMIT 0
+#define PHASE_FRAME(frame) ((frame) + 1)
+#define PHASE_RESTORE (MINGHE_RESISTANCE_FRAMES + 1)
+#define PHASE_OVER (MINGHE_RESISTANCE_FRAMES + 2)
+
+MingHeResistanceMeter::MingHeResistanceMeter(MingHeBuckConverter *converter) {
+  converter_ = converter;
+  memset(&result_, 0, sizeof(result_));
+  settle_ms_ = 0;
+  restore_ = true;
+  state_ = MINGHE_RESISTANCE_IDLE;
+  outcome_ = MINGHE_RESISTANCE_DONE;
+  phase_ = PHASE_OVER;
+  in_flight_ = false;
+  last_status_ = MINGHE_STATUS_OK;
+}
+
+bool MingHeResistanceMeter::start(const uint16_t step_current,
+        const bool restore) {
+  if (state_ == MINGHE_RESISTANCE_RUNNING) {
+    return false;
+  }
+  memset(&result_, 0, sizeof(result_));
+  result_.limit_after = step_current;
+  restore_ = restore;
+  state_ = MINGHE_RESISTANCE_RUNNING;
+  outcome_ = MINGHE_RESISTANCE_DONE;
+  phase_ = PHASE_READ_LIMIT;
+  in_flight_ = false;
+  last_status_ = MINGHE_STATUS_OK;
+  return true;
+}
+
+char MingHeResistanceMeter::getCommand(const uint8_t phase) const {
+  switch (phase) {
+    case PHASE_FRAME(MINGHE_RESISTANCE_VOLTAGE_BEFORE):
+    case PHASE_FRAME(MINGHE_RESISTANCE_VOLTAGE_AFTER):
+      return MINGHE_COMMAND_VOLTAGE;
+    case PHASE_FRAME(MINGHE_RESISTANCE_CURRENT_BEFORE):
+    case PHASE_FRAME(MINGHE_RESISTANCE_CURRENT_AFTER):
+      return MINGHE_COMMAND_CURRENT;
+    default:
+      return MINGHE_COMMAND_MAX_CURRENT;
+  }
+}
+
+// The first problem is the one reported, even if putting the limit back goes
+// wrong too.
+void MingHeResistanceMeter::end(const uint8_t outcome) {
+  if (outcome_ == MINGHE_RESISTANCE_DONE) {
+    outcome_ = outcome;
+  }
+  if (restore_ && (phase_ >= PHASE_FRAME(MINGHE_RESISTANCE_STEP)) &&
+          (phase_ < PHASE_RESTORE)) {
+    phase_ = PHASE_RESTORE;
+    return;
+  }
+  phase_ = PHASE_OVER;
+  state_ = outcome_;
+}
+
+void MingHeResistanceMeter::calculate(void) {
+  uint32_t step_us = frame_end_us_[MINGHE_RESISTANCE_STEP];
+
+  result_.delta_voltage = (int16_t)(result_.voltage_after -
+          result_.voltage_before);
+  result_.delta_current = (int16_t)(result_.current_after -
+          result_.current_before);
+  if (result_.delta_current) {
+    result_.resistance_mohm = (int32_t)result_.delta_voltage * 1000 /
+            result_.delta_current;
+  }
+  for (uint8_t i = 0; i < MINGHE_RESISTANCE_FRAMES; i++) {
+    result_.frame_us[i] = (int32_t)(frame_end_us_[i] - step_us);
+  }
+}
+
+/*
+ * Frames after the first go out as soon as the one before is done, so only
+ * the first waits for someone else's transaction.  Another transaction still
+ * going when a later frame is due - one started while settling - means the
+ * frames can't be back to back.
+ */
+void MingHeResistanceMeter::startFrame(void) {
+  char command = getCommand(phase_);
+  bool started;
+
+  if (converter_->isBusy()) {
+    if ((phase_ == PHASE_READ_LIMIT) || (phase_ == PHASE_RESTORE)) {
+      return;
+    }
+    end(MINGHE_RESISTANCE_INTERRUPTED);
+    return;
+  }
+  if ((phase_ == PHASE_FRAME(MINGHE_RESISTANCE_VOLTAGE_AFTER)) &&
+          ((millis() - result_.step_ms) < settle_ms_)) {
+    return;
+  }
+
+  if (phase_ == PHASE_FRAME(MINGHE_RESISTANCE_STEP)) {
+    started = converter_->beginSet(command, result_.limit_after);
+  } else if (phase_ == PHASE_RESTORE) {
+    started = converter_->beginSet(command, result_.limit_before);
+  } else {
+    started = converter_->beginGet(command);
+  }
+  if (!started) {
+    last_status_ = converter_->getLastStatus();
+    end(MINGHE_RESISTANCE_FAILED);
+    return;
+  }
+  in_flight_ = true;
+}
+
+void MingHeResistanceMeter::finishFrame(void) {
+  uint32_t now_us = micros();
+  MingHeReading reading = converter_->getAsyncReading();
+
+  // A blocking call finished the frame and ran its own.
+  if (converter_->getAsyncCommand() != getCommand(phase_)) {
+    end(MINGHE_RESISTANCE_INTERRUPTED);
+    return;
+  }
+  if (!reading.ok()) {
+    last_status_ = reading.status;
+    end(MINGHE_RESISTANCE_FAILED);
+    return;
+  }
+
+  if ((phase_ >= PHASE_FRAME(0)) && (phase_ < PHASE_RESTORE)) {
+    frame_end_us_[phase_ - PHASE_FRAME(0)] = now_us;
+  }
+  switch (phase_) {
+    case PHASE_READ_LIMIT:
+      result_.limit_before = reading.value;
+      break;
+    case PHASE_FRAME(MINGHE_RESISTANCE_VOLTAGE_BEFORE):
+      result_.voltage_before = reading.value;
+      break;
+    case PHASE_FRAME(MINGHE_RESISTANCE_CURRENT_BEFORE):
+      result_.current_before = reading.value;
+      break;
+    case PHASE_FRAME(MINGHE_RESISTANCE_STEP):
+      result_.step_ms = millis();
+      break;
+    case PHASE_FRAME(MINGHE_RESISTANCE_VOLTAGE_AFTER):
+      result_.voltage_after = reading.value;
+      break;
+    case PHASE_FRAME(MINGHE_RESISTANCE_CURRENT_AFTER):
+      result_.current_after = reading.value;
+      calculate();
+      end(result_.delta_current ? MINGHE_RESISTANCE_DONE :
+              MINGHE_RESISTANCE_NO_STEP);
+      return;
+    case PHASE_RESTORE:
+      end(MINGHE_RESISTANCE_DONE);
+      return;
+  }
+  phase_++;
+}
+
+uint8_t MingHeResistanceMeter::poll(void) {
+  if (state_ != MINGHE_RESISTANCE_RUNNING) {
+    return state_;
+  }
+  if (in_flight_) {
+    if (converter_->poll() == MINGHE_STATUS_PENDING) {
+      return state_;
+    }
+    in_flight_ = false;
+    finishFrame();
+  }
+  if (state_ == MINGHE_RESISTANCE_RUNNING) {
+    startFrame();
+  }
+  return state_;
+}
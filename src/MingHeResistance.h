@@ -0,0 +1,140 @@
+/*
+ * Battery internal resistance from a current step.  Charging in CC, the meter
+ * reads the voltage and current, steps the current limit, and reads them
+ * again: the resistance is the change in voltage over the change in current.
+ * The battery's voltage starts to drift back as soon as the current changes,
+ * so the readings either side of the step are only useful if they're close
+ * to it - the blocking calls, with a verify read after the set and a frame
+ * gap on top of each, leave them too far apart.
+ *
+ * So it all goes out on the non-blocking engine, one frame straight after the
+ * other at the converter's frame gap (measure the real gaps with
+ * MingHeGapCharacterizer, or they're the safe defaults), with no verify read
+ * after the step.  Call poll from loop() until it's done.  When each frame
+ * finished is kept, relative to the step, so the result says how far apart
+ * the readings really were.
+ *
+ *   voltage, current, step, [settle], voltage, current, [restore]
+ *
+ * The current limit is read first, and by default put back after, so the step
+ * is a short pulse in the charge.  The converter has to be current limited
+ * for the step to change the current: in CV, nothing moves and the result is
+ * MINGHE_RESISTANCE_NO_STEP.  Readings are in 10mV and 10mA, so the step has
+ * to be large enough to move the voltage a good few counts - an amp or more
+ * for a battery of a hundred or two milliohms.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#ifndef __MING_HE_RESISTANCE_H__
+#define __MING_HE_RESISTANCE_H__
+
+#include "MingHeBuckConverter.h"
+
+// Frames of a measurement, for MingHeResistanceResult::frame_us.
+#define MINGHE_RESISTANCE_VOLTAGE_BEFORE 0
+#define MINGHE_RESISTANCE_CURRENT_BEFORE 1
+#define MINGHE_RESISTANCE_STEP 2
+#define MINGHE_RESISTANCE_VOLTAGE_AFTER 3
+#define MINGHE_RESISTANCE_CURRENT_AFTER 4
+#define MINGHE_RESISTANCE_FRAMES 5
+
+// Where the meter is at.
+#define MINGHE_RESISTANCE_IDLE 0
+#define MINGHE_RESISTANCE_RUNNING 1
+#define MINGHE_RESISTANCE_DONE 2
+// A transaction failed - see getLastStatus.
+#define MINGHE_RESISTANCE_FAILED 3
+// The current didn't change across the step, so there's nothing to divide by.
+#define MINGHE_RESISTANCE_NO_STEP 4
+// A blocking call on the converter took over partway through, so the frames
+// weren't back to back.
+#define MINGHE_RESISTANCE_INTERRUPTED 5
+
+struct MingHeResistanceResult {
+  // Volts and amps * 100, either side of the step.
+  uint16_t voltage_before;
+  uint16_t current_before;
+  uint16_t voltage_after;
+  uint16_t current_after;
+  // The current limit the step went from and to.
+  uint16_t limit_before;
+  uint16_t limit_after;
+  // After less before.
+  int16_t delta_voltage;
+  int16_t delta_current;
+  // delta_voltage / delta_current.  Negative if the voltage moved the wrong
+  // way - something other than the step moved it.
+  int32_t resistance_mohm;
+  // When each frame's reply came in, in us after the step's.  The before
+  // frames are negative.
+  int32_t frame_us[MINGHE_RESISTANCE_FRAMES];
+  // millis() when the step's reply came in.
+  uint32_t step_ms;
+};
+
+class MingHeResistanceMeter {
+public:
+  MingHeResistanceMeter(MingHeBuckConverter *converter);
+
+  /**
+   * Start a measurement, stepping the current limit to step_current (amps *
+   * 100).  If restore is set, the limit goes back to where it was after.
+   * False if a measurement is already running.  If something else has a
+   * transaction going on the converter, the first frame waits for it.
+   */
+  bool start(const uint16_t step_current, const bool restore);
+
+  /**
+   * Time to leave between the step and the readings after it, for the
+   * converter to slew to the new current.  0 (the default) reads straight
+   * away.
+   */
+  void setSettle(const uint16_t settle_ms) { settle_ms_ = settle_ms; }
+
+  /**
+   * Move the measurement along.  Returns MINGHE_RESISTANCE_RUNNING until it's
+   * over, then how it ended.  If the step went out, the limit is put back
+   * (when asked for) however it ended.
+   */
+  uint8_t poll(void);
+  uint8_t getState(void) const { return state_; }
+  bool isRunning(void) const { return state_ == MINGHE_RESISTANCE_RUNNING; }
+
+  // The last measurement, filled in once it's MINGHE_RESISTANCE_DONE.
+  const MingHeResistanceResult &getResult(void) const { return result_; }
+  // Status of the transaction that failed, if one did.
+  uint8_t getLastStatus(void) const { return last_status_; }
+
+private:
+  // What's sent for each phase.
+  char getCommand(const uint8_t phase) const;
+  // Start the next frame, if it can go.
+  void startFrame(void);
+  void finishFrame(void);
+  // Stop with outcome, putting the limit back first if that's wanted.
+  void end(const uint8_t outcome);
+  void calculate(void);
+
+  MingHeBuckConverter *converter_;
+  MingHeResistanceResult result_;
+  uint16_t settle_ms_;
+  bool restore_;
+
+  uint8_t state_;
+  // How it's going to end, while the limit's put back.
+  uint8_t outcome_;
+  uint8_t phase_;
+  bool in_flight_;
+  // micros() of each frame's reply.
+  uint32_t frame_end_us_[MINGHE_RESISTANCE_FRAMES];
+  uint8_t last_status_;
+};
+
+#endif // __MING_HE_RESISTANCE_H__
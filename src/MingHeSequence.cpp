@@ -0,0 +1,301 @@
+/*
+ * Load profile player.  See MingHeSequence.h.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#include "MingHeSequence.h"
+
+MingHeSequencePlayer::MingHeSequencePlayer(MingHeBuckConverter *converter) {
+  converter_ = converter;
+  steps_ = NULL;
+  progmem_ = true;
+  state_ = MINGHE_SEQUENCE_IDLE;
+  index_ = 0;
+  in_flight_ = waiting_ = false;
+  poll_interval_ms_ = MINGHE_SEQUENCE_DEFAULT_POLL_MS;
+  loop_count_ = 0;
+  last_status_ = MINGHE_STATUS_OK;
+  steps_played_ = max_late_ms_ = 0;
+}
+
+void MingHeSequencePlayer::start(const MingHeSequenceStep *steps) {
+  begin(steps, true);
+}
+
+void MingHeSequencePlayer::startFromRam(const MingHeSequenceStep *steps) {
+  begin(steps, false);
+}
+
+void MingHeSequencePlayer::begin(const MingHeSequenceStep *steps,
+        const bool progmem) {
+  stop();
+  steps_ = steps;
+  progmem_ = progmem;
+  state_ = MINGHE_SEQUENCE_RUNNING;
+  index_ = 0;
+  base_ms_ = millis();
+  loop_count_ = 0;
+  last_status_ = MINGHE_STATUS_OK;
+  steps_played_ = max_late_ms_ = 0;
+}
+
+// Let a transaction under way finish - the converter is no use until then -
+// but take nothing more from the table.
+void MingHeSequencePlayer::stop(void) {
+  if (in_flight_) {
+    while (converter_->poll() == MINGHE_STATUS_PENDING) {
+    }
+    in_flight_ = false;
+  }
+  waiting_ = false;
+  if (state_ == MINGHE_SEQUENCE_RUNNING) {
+    state_ = MINGHE_SEQUENCE_IDLE;
+  }
+}
+
+void MingHeSequencePlayer::loadStep(const uint16_t index,
+        MingHeSequenceStep *step) const {
+  if (progmem_) {
+    memcpy_P(step, &steps_[index], sizeof(*step));
+  } else {
+    *step = steps_[index];
+  }
+}
+
+void MingHeSequencePlayer::markLate(const uint32_t due_ms) {
+  uint32_t late_ms = millis() - due_ms;
+
+  if (late_ms > max_late_ms_) {
+    max_late_ms_ = (late_ms > 0xFFFF) ? 0xFFFF : late_ms;
+  }
+}
+
+bool MingHeSequencePlayer::startTransaction(const MingHeSequenceStep &step) {
+  bool started;
+
+  if (step.op == MINGHE_SEQ_SET) {
+    started = converter_->beginSet(step.command, step.value);
+  } else {
+    started = converter_->beginGet(step.command);
+  }
+  if (!started) {
+    last_status_ = converter_->getLastStatus();
+    state_ = MINGHE_SEQUENCE_FAILED;
+    return false;
+  }
+  in_flight_ = true;
+  return true;
+}
+
+/*
+ * A set is done once it's acknowledged, and the next step is timed from when
+ * this one was due.  A wait is done once its condition holds, and the next
+ * step is timed from then.
+ */
+void MingHeSequencePlayer::finishTransaction(const MingHeSequenceStep &step) {
+  MingHeReading reading = converter_->getAsyncReading();
+  bool met;
+
+  if (!reading.ok()) {
+    last_status_ = reading.status;
+    state_ = MINGHE_SEQUENCE_FAILED;
+    return;
+  }
+  if (step.op == MINGHE_SEQ_SET) {
+    index_++;
+    return;
+  }
+
+  switch (step.op) {
+    case MINGHE_SEQ_WAIT_ABOVE: met = (reading.value >= step.value); break;
+    case MINGHE_SEQ_WAIT_BELOW: met = (reading.value <= step.value); break;
+    default: met = (reading.value == step.value); break;
+  }
+  if (met) {
+    waiting_ = false;
+    base_ms_ = millis();
+    index_++;
+  } else if (step.extra &&
+          ((millis() - wait_start_ms_) >= step.extra * 100UL)) {
+    waiting_ = false;
+    state_ = MINGHE_SEQUENCE_TIMED_OUT;
+  }
+}
+
+// The first time round, a counting loop takes a slot and goes back.  Each
+// time after, it counts down, and when it runs out it frees the slot and
+// falls through - so a loop inside it starts afresh next time.
+bool MingHeSequencePlayer::takeLoop(const MingHeSequenceStep &step) {
+  uint8_t slot;
+
+  // Back to an earlier step - to itself, or forward, it would never end.
+  if (step.value >= index_) {
+    return false;
+  }
+  if (!step.extra) {
+    index_ = step.value;
+    return true;
+  }
+
+  for (slot = 0; slot < loop_count_; slot++) {
+    if (loop_step_[slot] == index_) {
+      break;
+    }
+  }
+  if (slot == loop_count_) {
+    if (loop_count_ >= MINGHE_SEQUENCE_MAX_LOOPS) {
+      return false;
+    }
+    loop_step_[slot] = index_;
+    loop_left_[slot] = step.extra;
+    loop_count_++;
+  }
+
+  if (--loop_left_[slot]) {
+    index_ = step.value;
+    return true;
+  }
+  // Done - the last slot moves into this one.
+  loop_count_--;
+  loop_step_[slot] = loop_step_[loop_count_];
+  loop_left_[slot] = loop_left_[loop_count_];
+  index_++;
+  return true;
+}
+
+uint8_t MingHeSequencePlayer::poll(void) {
+  MingHeSequenceStep step;
+  uint32_t due_ms;
+
+  if (state_ != MINGHE_SEQUENCE_RUNNING) {
+    return state_;
+  }
+
+  if (in_flight_) {
+    if (converter_->poll() == MINGHE_STATUS_PENDING) {
+      return state_;
+    }
+    in_flight_ = false;
+    loadStep(index_, &step);
+    finishTransaction(step);
+    if (state_ != MINGHE_SEQUENCE_RUNNING) {
+      return state_;
+    }
+  }
+
+  // Run every step that's due and needs no frame, up to one that does.  A
+  // loop ends the pass, so a table that loops with no delay can't lock up.
+  for (;;) {
+    loadStep(index_, &step);
+    due_ms = base_ms_ + step.delay_ms;
+
+    if (waiting_) {
+      if ((millis() - last_check_ms_) < poll_interval_ms_) {
+        return state_;
+      }
+    } else if ((int32_t)(millis() - due_ms) < 0) {
+      return state_;
+    }
+
+    switch (step.op) {
+      case MINGHE_SEQ_END:
+        state_ = MINGHE_SEQUENCE_DONE;
+        return state_;
+
+      case MINGHE_SEQ_PAUSE:
+        base_ms_ = due_ms;
+        index_++;
+        continue;
+
+      case MINGHE_SEQ_LOOP:
+        base_ms_ = due_ms;
+        if (!takeLoop(step)) {
+          state_ = MINGHE_SEQUENCE_BAD_TABLE;
+        }
+        return state_;
+
+      case MINGHE_SEQ_SET:
+      case MINGHE_SEQ_WAIT_ABOVE:
+      case MINGHE_SEQ_WAIT_BELOW:
+      case MINGHE_SEQ_WAIT_EQUAL:
+        break;
+
+      default:
+        // Not an op - don't guess at what to send.
+        state_ = MINGHE_SEQUENCE_BAD_TABLE;
+        return state_;
+    }
+
+    // Something else is using the converter.  Come back when it's done.
+    if (converter_->isBusy()) {
+      return state_;
+    }
+    if (step.op == MINGHE_SEQ_SET) {
+      markLate(due_ms);
+      base_ms_ = due_ms;
+      steps_played_++;
+    } else if (!waiting_) {
+      markLate(due_ms);
+      waiting_ = true;
+      wait_start_ms_ = millis();
+      steps_played_++;
+    }
+    if (waiting_) {
+      last_check_ms_ = millis();
+    }
+    startTransaction(step);
+    return state_;
+  }
+}
+
+static uint16_t readWord(const uint8_t *bytes) {
+  return bytes[0] | ((uint16_t)bytes[1] << 8);
+}
+
+uint16_t MingHeSequencePlayer::readSequence(Stream &in,
+        MingHeSequenceStep *steps, const uint16_t max_steps) {
+  uint8_t header[MINGHE_SEQUENCE_HEADER_BYTES];
+  uint8_t bytes[MINGHE_SEQUENCE_STEP_BYTES];
+  uint16_t count;
+
+  if (in.readBytes((char *)header, MINGHE_SEQUENCE_HEADER_BYTES) !=
+          MINGHE_SEQUENCE_HEADER_BYTES) {
+    return 0;
+  }
+  if ((header[0] != 'M') || (header[1] != 'H') || (header[2] != 'S') ||
+          (header[3] != 'Q') || (header[4] != MINGHE_SEQUENCE_VERSION)) {
+    return 0;
+  }
+  count = readWord(&header[5]);
+  if (!count || (count > max_steps)) {
+    return 0;
+  }
+
+  for (uint16_t i = 0; i < count; i++) {
+    if (in.readBytes((char *)bytes, MINGHE_SEQUENCE_STEP_BYTES) !=
+            MINGHE_SEQUENCE_STEP_BYTES) {
+      return 0;
+    }
+    steps[i].delay_ms = readWord(&bytes[0]);
+    steps[i].op = bytes[2];
+    steps[i].command = bytes[3];
+    steps[i].value = readWord(&bytes[4]);
+    steps[i].extra = readWord(&bytes[6]);
+    if ((steps[i].op > MINGHE_SEQ_LOOP) ||
+            ((steps[i].op == MINGHE_SEQ_LOOP) && (steps[i].value >= i))) {
+      return 0;
+    }
+  }
+  // Whatever the file says, the table ends here.
+  if (steps[count - 1].op != MINGHE_SEQ_END) {
+    return 0;
+  }
+  return count;
+}
@@ -0,0 +1,189 @@
+/*
+ * Plays a load profile - a table of timed steps that set limits, switch the
+ * output, wait for a reading to reach some value, and loop - on a converter,
+ * without blocking.  Call poll from loop() and the steps go out on the
+ * non-blocking engine as they come due.
+ *
+ * Step times are offsets from when the step before was due, not from when it
+ * finished, so a slow frame makes one step late rather than pushing back
+ * every step after it.  The schedule only moves when a wait's condition is
+ * met, since nothing can be known about the timing before that.  How late
+ * steps went out is kept - see getMaxLateMs - and is down to the link, and
+ * whatever else the sketch does between polls.
+ *
+ * Tables are usually in flash:
+ *
+ *   const MingHeSequenceStep PROGMEM profile[] = {
+ *     MINGHE_STEP_SET(0, MINGHE_COMMAND_MAX_CURRENT, 200),
+ *     MINGHE_STEP_SET(0, MINGHE_COMMAND_MAX_VOLTAGE, 1200),
+ *     MINGHE_STEP_OUTPUT(0, true),
+ *     MINGHE_STEP_WAIT_BELOW(0, MINGHE_COMMAND_CURRENT, 10, 600),
+ *     MINGHE_STEP_OUTPUT(1000, false),
+ *     MINGHE_STEP_END
+ *   };
+ *
+ * The same steps can be kept in a file (an SD card, or sent down a serial
+ * port from a host), and read into RAM with readSequence.  The file is a
+ * header - "MHSQ", a version byte and the step count, little endian - then 8
+ * bytes a step: delay_ms, op, command, value and extra, each little endian.
+ * extras/sequence_compiler.py builds them, and PROGMEM tables, from profiles
+ * written as CSV or JSON.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#ifndef __MING_HE_SEQUENCE_H__
+#define __MING_HE_SEQUENCE_H__
+
+#include "MingHeBuckConverter.h"
+
+// Step operations.
+// Nothing - the end of the table.
+#define MINGHE_SEQ_END 0
+// Set command to value.
+#define MINGHE_SEQ_SET 1
+// Nothing, for spacing out steps more than 65s apart.
+#define MINGHE_SEQ_PAUSE 2
+// Read command every poll interval until it's at or above value, at or below
+// it, or equal to it.  extra is the timeout, in tenths of a second - 0 for
+// none.
+#define MINGHE_SEQ_WAIT_ABOVE 3
+#define MINGHE_SEQ_WAIT_BELOW 4
+#define MINGHE_SEQ_WAIT_EQUAL 5
+// Go back to step value, extra times - 0 for ever.
+#define MINGHE_SEQ_LOOP 6
+
+// Nested loops that can be counting at once.
+#define MINGHE_SEQUENCE_MAX_LOOPS 4
+// How often a wait reads its value, unless setPollInterval says otherwise.
+#define MINGHE_SEQUENCE_DEFAULT_POLL_MS 100
+
+// Bytes in a step, and in the file header, and the file format version.
+#define MINGHE_SEQUENCE_STEP_BYTES 8
+#define MINGHE_SEQUENCE_HEADER_BYTES 7
+#define MINGHE_SEQUENCE_VERSION 1
+
+// Where the player is at.
+#define MINGHE_SEQUENCE_IDLE 0
+#define MINGHE_SEQUENCE_RUNNING 1
+#define MINGHE_SEQUENCE_DONE 2
+// A step's transaction failed - see getLastStatus.
+#define MINGHE_SEQUENCE_FAILED 3
+// A wait ran out of time.
+#define MINGHE_SEQUENCE_TIMED_OUT 4
+// The table is broken: a loop that doesn't go back, loops nested too deep, or
+// a step that isn't one of the ops.
+#define MINGHE_SEQUENCE_BAD_TABLE 5
+
+struct MingHeSequenceStep {
+  // Time after the step before was due, or after a wait was satisfied.
+  uint16_t delay_ms;
+  uint8_t op;
+  char command;
+  uint16_t value;
+  // Wait timeout or loop count.
+  uint16_t extra;
+};
+
+// Table entries.
+#define MINGHE_STEP_SET(delay_ms, command, value) \
+    {delay_ms, MINGHE_SEQ_SET, command, value, 0}
+#define MINGHE_STEP_OUTPUT(delay_ms, enabled) \
+    {delay_ms, MINGHE_SEQ_SET, MINGHE_COMMAND_OUTPUT_STATE, enabled, 0}
+#define MINGHE_STEP_PAUSE(delay_ms) {delay_ms, MINGHE_SEQ_PAUSE, 0, 0, 0}
+#define MINGHE_STEP_WAIT_ABOVE(delay_ms, command, value, timeout_ds) \
+    {delay_ms, MINGHE_SEQ_WAIT_ABOVE, command, value, timeout_ds}
+#define MINGHE_STEP_WAIT_BELOW(delay_ms, command, value, timeout_ds) \
+    {delay_ms, MINGHE_SEQ_WAIT_BELOW, command, value, timeout_ds}
+#define MINGHE_STEP_WAIT_EQUAL(delay_ms, command, value, timeout_ds) \
+    {delay_ms, MINGHE_SEQ_WAIT_EQUAL, command, value, timeout_ds}
+#define MINGHE_STEP_LOOP(delay_ms, to_step, times) \
+    {delay_ms, MINGHE_SEQ_LOOP, 0, to_step, times}
+#define MINGHE_STEP_END {0, MINGHE_SEQ_END, 0, 0, 0}
+
+class MingHeSequencePlayer {
+public:
+  MingHeSequencePlayer(MingHeBuckConverter *converter);
+
+  /**
+   * Start playing a table, from flash or from RAM.  The table has to stay put
+   * until the player is done with it.  The first step is due delay_ms from
+   * now.
+   */
+  void start(const MingHeSequenceStep *steps);
+  void startFromRam(const MingHeSequenceStep *steps);
+  void stop(void);
+
+  /**
+   * Move the sequence along: finish the transaction under way, and start the
+   * next step if it's due.  Returns MINGHE_SEQUENCE_RUNNING until it's over,
+   * then how it ended.  If something else has a transaction going on the
+   * converter, the step waits for it.
+   */
+  uint8_t poll(void);
+  uint8_t getState(void) const { return state_; }
+  bool isRunning(void) const { return state_ == MINGHE_SEQUENCE_RUNNING; }
+
+  // How often waits read their value.
+  void setPollInterval(const uint16_t interval_ms) {
+    poll_interval_ms_ = interval_ms;
+  }
+
+  // The step playing (or that it ended on), and the transaction status if it
+  // failed.
+  uint16_t getStepIndex(void) const { return index_; }
+  uint8_t getLastStatus(void) const { return last_status_; }
+
+  // Steps that went out, and the latest any did, in ms after it was due.
+  uint16_t getStepsPlayed(void) const { return steps_played_; }
+  uint16_t getMaxLateMs(void) const { return max_late_ms_; }
+
+  /**
+   * Read a sequence file into steps.  Returns the number of steps, or 0 if
+   * the header is wrong, the file is short, it won't fit in max_steps, or a
+   * step is broken - an unknown op, or a loop that doesn't go back.
+   */
+  static uint16_t readSequence(Stream &in, MingHeSequenceStep *steps,
+          const uint16_t max_steps);
+
+private:
+  void loadStep(const uint16_t index, MingHeSequenceStep *step) const;
+  void begin(const MingHeSequenceStep *steps, const bool progmem);
+  // Start the transaction for a step.  False if it couldn't go out.
+  bool startTransaction(const MingHeSequenceStep &step);
+  void finishTransaction(const MingHeSequenceStep &step);
+  // Take a loop step.  False if the table is broken.
+  bool takeLoop(const MingHeSequenceStep &step);
+  void markLate(const uint32_t due_ms);
+
+  MingHeBuckConverter *converter_;
+  const MingHeSequenceStep *steps_;
+  bool progmem_;
+
+  uint8_t state_;
+  uint16_t index_;
+  // When the step at index_ counts its delay from.
+  uint32_t base_ms_;
+  bool in_flight_;
+  // A wait under way: when it started, and when it last read.
+  bool waiting_;
+  uint32_t wait_start_ms_, last_check_ms_;
+  uint16_t poll_interval_ms_;
+
+  // Counting loops: the step each is at, and the goes it has left.
+  uint16_t loop_step_[MINGHE_SEQUENCE_MAX_LOOPS];
+  uint16_t loop_left_[MINGHE_SEQUENCE_MAX_LOOPS];
+  uint8_t loop_count_;
+
+  uint8_t last_status_;
+  uint16_t steps_played_;
+  uint16_t max_late_ms_;
+};
+
+#endif // __MING_HE_SEQUENCE_H__
@@ -0,0 +1,295 @@
+/*
+ * Non-blocking telemetry.  See MingHeTelemetry.h.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#include "MingHeTelemetry.h"
+
+// By channel number.
+static const char minghe_telemetry_commands[MINGHE_TELEMETRY_CHANNELS]
+        PROGMEM = {
+  MINGHE_COMMAND_VOLTAGE,
+  MINGHE_COMMAND_CURRENT,
+  MINGHE_COMMAND_WATTS,
+  MINGHE_COMMAND_TEMPERATURE,
+  MINGHE_COMMAND_LIMITING_FACTOR,
+  MINGHE_COMMAND_OUTPUT_STATE,
+};
+
+MingHeTelemetry::MingHeTelemetry(MingHeBuckConverter *converter) {
+  converter_ = converter;
+  enabled_ = MINGHE_TELEMETRY_DEFAULT_CHANNELS;
+  interval_ms_ = MINGHE_TELEMETRY_DEFAULT_INTERVAL_MS;
+  in_flight_ = false;
+  for (uint8_t i = 0; i < MINGHE_TELEMETRY_CHANNELS; i++) {
+    channels_[i].filter = NULL;
+    channels_[i].stats = NULL;
+  }
+  for (uint8_t i = 0; i < MINGHE_EVENT_COUNT; i++) {
+    callbacks_[i] = NULL;
+  }
+  setpoints_c_[0] = setpoints_c_[1] = 0;
+  hysteresis_c_ = MINGHE_DEFAULT_TEMPERATURE_HYSTERESIS;
+  reset();
+}
+
+char MingHeTelemetry::getCommand(const uint8_t channel) {
+  if (channel >= MINGHE_TELEMETRY_CHANNELS) {
+    return 0;
+  }
+  return pgm_read_byte(minghe_telemetry_commands + channel);
+}
+
+void MingHeTelemetry::setFilter(const uint8_t channel, MingHeFilter *filter) {
+  if (channel >= MINGHE_TELEMETRY_CHANNELS) {
+    return;
+  }
+  channels_[channel].filter = filter;
+  if (filter) {
+    filter->reset();
+  }
+}
+
+void MingHeTelemetry::addStats(const uint8_t channel,
+        MingHeWindowStats *stats) {
+  if (channel >= MINGHE_TELEMETRY_CHANNELS) {
+    return;
+  }
+  stats->setNext(channels_[channel].stats);
+  channels_[channel].stats = stats;
+}
+
+void MingHeTelemetry::clearStats(const uint8_t channel) {
+  if (channel < MINGHE_TELEMETRY_CHANNELS) {
+    channels_[channel].stats = NULL;
+  }
+}
+
+// A read under way is let finish - the converter is no use until then - and
+// thrown away.
+void MingHeTelemetry::reset(void) {
+  if (in_flight_) {
+    while (converter_->poll() == MINGHE_STATUS_PENDING) {
+    }
+    in_flight_ = false;
+  }
+  for (uint8_t i = 0; i < MINGHE_TELEMETRY_CHANNELS; i++) {
+    channels_[i].raw = channels_[i].value = channels_[i].sample_ms = 0;
+    if (channels_[i].filter) {
+      channels_[i].filter->reset();
+    }
+    for (MingHeWindowStats *stats = channels_[i].stats; stats;
+            stats = stats->getNext()) {
+      stats->reset();
+    }
+  }
+  sampled_ = 0;
+  over_ = 0;
+  channel_ = 0;
+  round_start_ms_ = millis();
+  last_status_ = MINGHE_STATUS_OK;
+  failed_reads_ = 0;
+}
+
+uint32_t MingHeTelemetry::getRaw(const uint8_t channel) const {
+  return (channel < MINGHE_TELEMETRY_CHANNELS) ? channels_[channel].raw : 0;
+}
+
+uint32_t MingHeTelemetry::getValue(const uint8_t channel) const {
+  return (channel < MINGHE_TELEMETRY_CHANNELS) ? channels_[channel].value : 0;
+}
+
+uint32_t MingHeTelemetry::getSampleMs(const uint8_t channel) const {
+  return (channel < MINGHE_TELEMETRY_CHANNELS) ?
+          channels_[channel].sample_ms : 0;
+}
+
+void MingHeTelemetry::setCallback(const uint8_t type,
+        MingHeTelemetryCallback callback) {
+  if (type < MINGHE_EVENT_COUNT) {
+    callbacks_[type] = callback;
+  }
+}
+
+// Where the temperature stands against the new setpoints is taken as it is,
+// not as a change.
+void MingHeTelemetry::setTemperatureSetpoints(const uint8_t fan_start_c,
+        const uint8_t shutdown_c) {
+  setpoints_c_[0] = fan_start_c;
+  setpoints_c_[1] = shutdown_c;
+  over_ = 0;
+  if (hasSample(MINGHE_TELEMETRY_TEMPERATURE)) {
+    checkEvents(MINGHE_TELEMETRY_TEMPERATURE, true, 0,
+            channels_[MINGHE_TELEMETRY_TEMPERATURE].value);
+  }
+}
+
+bool MingHeTelemetry::loadTemperatureSetpoints(void) {
+  MingHeReading fan_start, shutdown;
+
+  // Take the read under way first, or the blocking reads would finish it and
+  // it would be lost.
+  if (in_flight_) {
+    while (converter_->poll() == MINGHE_STATUS_PENDING) {
+    }
+    in_flight_ = false;
+    takeSample();
+  }
+  fan_start = converter_->getReading(MINGHE_COMMAND_FAN_TEMPERATURE);
+  shutdown = converter_->getReading(MINGHE_COMMAND_SHUTDOWN_TEMPERATURE);
+  if (!fan_start.ok() || !shutdown.ok()) {
+    return false;
+  }
+  setTemperatureSetpoints(fan_start.value, shutdown.value);
+  return true;
+}
+
+void MingHeTelemetry::fire(const uint8_t type, const uint8_t from,
+        const uint8_t to, const uint32_t value) {
+  MingHeTelemetryEvent event;
+
+  if (!callbacks_[type]) {
+    return;
+  }
+  event.converter = converter_;
+  event.type = type;
+  event.from = from;
+  event.to = to;
+  event.value = value;
+  event.ms = millis();
+  callbacks_[type](event);
+}
+
+// Over at the setpoint, and back under once it's more than the hysteresis
+// below it.
+void MingHeTelemetry::checkSetpoint(const uint8_t type,
+        const uint8_t setpoint_c, const bool first, const uint32_t value) {
+  uint8_t bit = 1 << type;
+
+  if (!setpoint_c) {
+    return;
+  }
+  if (!(over_ & bit) && (value >= setpoint_c)) {
+    over_ |= bit;
+    if (!first) {
+      fire(type, 0, 1, value);
+    }
+  } else if ((over_ & bit) && (value + hysteresis_c_ < setpoint_c)) {
+    over_ &= ~bit;
+    if (!first) {
+      fire(type, 1, 0, value);
+    }
+  }
+}
+
+void MingHeTelemetry::checkEvents(const uint8_t channel, const bool first,
+        const uint32_t before, const uint32_t value) {
+  switch (channel) {
+    case MINGHE_TELEMETRY_LIMITING_FACTOR:
+      if (!first && (value != before)) {
+        fire(MINGHE_EVENT_LIMITING_FACTOR, before, value, value);
+      }
+      break;
+
+    case MINGHE_TELEMETRY_OUTPUT_STATE:
+      if (!first && (value != before)) {
+        fire(MINGHE_EVENT_OUTPUT_STATE, before, value, value);
+      }
+      break;
+
+    case MINGHE_TELEMETRY_TEMPERATURE:
+      checkSetpoint(MINGHE_EVENT_FAN_TEMPERATURE, setpoints_c_[0], first,
+              value);
+      checkSetpoint(MINGHE_EVENT_SHUTDOWN_TEMPERATURE, setpoints_c_[1], first,
+              value);
+      break;
+  }
+}
+
+bool MingHeTelemetry::takeSample(void) {
+  MingHeReading reading = converter_->getAsyncReading();
+  uint8_t index = channel_++;
+  Channel &channel = channels_[index];
+  bool first = !hasSample(index);
+  uint32_t before = channel.value;
+
+  // A blocking call finished the read and ran its own, and this is its
+  // reading.  Leave the channel until next round.
+  if (converter_->getAsyncCommand() != getCommand(index)) {
+    return false;
+  }
+  if (!reading.ok()) {
+    last_status_ = reading.status;
+    failed_reads_++;
+    return false;
+  }
+  channel.raw = reading.value;
+  channel.value = channel.filter ?
+          channel.filter->update(reading.value) : reading.value;
+  channel.sample_ms = millis();
+  for (MingHeWindowStats *stats = channel.stats; stats;
+          stats = stats->getNext()) {
+    stats->add(reading.value);
+  }
+  sampled_ |= MINGHE_TELEMETRY_BIT(index);
+  checkEvents(index, first, before, channel.value);
+  return true;
+}
+
+/*
+ * Rounds start an interval apart, timed from when the last one was due so
+ * they don't drift - unless reading is so far behind that a whole interval
+ * has been missed, when the schedule starts again from now.
+ */
+void MingHeTelemetry::startRead(void) {
+  while ((channel_ < MINGHE_TELEMETRY_CHANNELS) &&
+          !(enabled_ & MINGHE_TELEMETRY_BIT(channel_))) {
+    channel_++;
+  }
+  if (channel_ >= MINGHE_TELEMETRY_CHANNELS) {
+    if (!enabled_ || ((millis() - round_start_ms_) < interval_ms_)) {
+      return;
+    }
+    round_start_ms_ += interval_ms_;
+    if ((millis() - round_start_ms_) >= interval_ms_) {
+      round_start_ms_ = millis();
+    }
+    channel_ = 0;
+    startRead();
+    return;
+  }
+
+  // Something else is using the converter.  Come back when it's done.
+  if (converter_->isBusy()) {
+    return;
+  }
+  if (!converter_->beginGet(getCommand(channel_))) {
+    // Quarantined, most likely.  Skip it this round.
+    last_status_ = converter_->getLastStatus();
+    failed_reads_++;
+    channel_++;
+    return;
+  }
+  in_flight_ = true;
+}
+
+bool MingHeTelemetry::poll(void) {
+  bool sampled = false;
+
+  if (in_flight_) {
+    if (converter_->poll() == MINGHE_STATUS_PENDING) {
+      return false;
+    }
+    in_flight_ = false;
+    sampled = takeSample();
+  }
+  startRead();
+  return sampled;
+}
@@ -0,0 +1,198 @@
+/*
+ * Keeps a converter's readings up to date without blocking.  Call poll from
+ * loop(), and once an interval each channel asked for is read, one frame at a
+ * time, on the non-blocking engine.  The latest of each is kept as read, and
+ * as passed through the channel's filter if it has one (see MingHeFilter.h),
+ * so a controller can act on the filtered value rather than every count of
+ * jitter.  Readings can also be fed to rolling windows (see
+ * MingHeWindowStats.h) for a summary of the last so many seconds.
+ *
+ * Changes worth acting on - the unit going from CV to CC, the output
+ * tripping off, the temperature passing the fan start or shutdown setpoint -
+ * are picked out of the readings and handed to callbacks, once each time
+ * they happen, so the sketch doesn't have to read those values itself to
+ * watch for them.
+ *
+ * If something else has a transaction going on the converter, the next read
+ * waits for it, so a telemetry loop and a sequence player or the blocking
+ * calls can share a unit.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#ifndef __MING_HE_TELEMETRY_H__
+#define __MING_HE_TELEMETRY_H__
+
+#include "MingHeBuckConverter.h"
+#include "MingHeFilter.h"
+#include "MingHeWindowStats.h"
+
+// Channels, in the order they're read.
+#define MINGHE_TELEMETRY_VOLTAGE 0
+#define MINGHE_TELEMETRY_CURRENT 1
+#define MINGHE_TELEMETRY_WATTS 2
+#define MINGHE_TELEMETRY_TEMPERATURE 3
+#define MINGHE_TELEMETRY_LIMITING_FACTOR 4
+#define MINGHE_TELEMETRY_OUTPUT_STATE 5
+#define MINGHE_TELEMETRY_CHANNELS 6
+
+#define MINGHE_TELEMETRY_BIT(channel) (1 << (channel))
+#define MINGHE_TELEMETRY_ALL_CHANNELS 0x3F
+
+// Read the voltage and current every half second, unless told otherwise.
+#define MINGHE_TELEMETRY_DEFAULT_CHANNELS \
+    (MINGHE_TELEMETRY_BIT(MINGHE_TELEMETRY_VOLTAGE) | \
+     MINGHE_TELEMETRY_BIT(MINGHE_TELEMETRY_CURRENT))
+#define MINGHE_TELEMETRY_DEFAULT_INTERVAL_MS 500
+
+// Events.  from and to are the limiting factors, or output states, before and
+// after.  For the temperatures, they're 1 for at or over the setpoint and 0
+// for under it.
+#define MINGHE_EVENT_LIMITING_FACTOR 0
+#define MINGHE_EVENT_OUTPUT_STATE 1
+#define MINGHE_EVENT_FAN_TEMPERATURE 2
+#define MINGHE_EVENT_SHUTDOWN_TEMPERATURE 3
+#define MINGHE_EVENT_COUNT 4
+
+// Degrees under a setpoint the temperature has to drop to count as back
+// under it, so a reading sitting on the setpoint doesn't fire every time.
+#define MINGHE_DEFAULT_TEMPERATURE_HYSTERESIS 2
+
+struct MingHeTelemetryEvent {
+  MingHeBuckConverter *converter;
+  uint8_t type;
+  uint8_t from;
+  uint8_t to;
+  // The reading that showed it, and the millis() it came in at.
+  uint32_t value;
+  uint32_t ms;
+};
+
+typedef void (*MingHeTelemetryCallback)(const MingHeTelemetryEvent &event);
+
+class MingHeTelemetry {
+public:
+  MingHeTelemetry(MingHeBuckConverter *converter);
+
+  // Which channels to read (MINGHE_TELEMETRY_BIT of each), and how often.
+  // An interval shorter than the reads take means reading flat out.
+  void setChannels(const uint8_t channels) { enabled_ = channels; }
+  uint8_t getChannels(void) const { return enabled_; }
+  void setInterval(const uint16_t interval_ms) { interval_ms_ = interval_ms; }
+
+  /**
+   * A filter for a channel's values, or NULL for none.  The filter isn't
+   * owned, and keeps state, so don't share one between channels.  It's reset
+   * whenever it's set.
+   */
+  void setFilter(const uint8_t channel, MingHeFilter *filter);
+
+  /**
+   * Feed a channel's readings, as read rather than filtered, to a rolling
+   * window - as many windows per channel as you like, a minute and an hour
+   * say.  The window isn't owned, and can only be on one channel.
+   * clearStats takes them all off a channel.
+   */
+  void addStats(const uint8_t channel, MingHeWindowStats *stats);
+  void clearStats(const uint8_t channel);
+
+  /**
+   * Call callback (NULL for none) when an event of a type happens.  Events
+   * come out of the readings, so the channel has to be read: the limiting
+   * factor, output state or temperature.  They're taken from the filtered
+   * value if the channel has a filter.  The first reading only sets where
+   * things stand - it takes a change after it for an event.
+   */
+  void setCallback(const uint8_t type, MingHeTelemetryCallback callback);
+
+  /**
+   * The fan start and shutdown setpoints, in C - 0 for no events for that
+   * one.  loadTemperatureSetpoints reads them from the unit, blocking, and
+   * returns false if either read failed.  Call it again after changing them.
+   */
+  void setTemperatureSetpoints(const uint8_t fan_start_c,
+          const uint8_t shutdown_c);
+  bool loadTemperatureSetpoints(void);
+  void setTemperatureHysteresis(const uint8_t degrees_c) {
+    hysteresis_c_ = degrees_c;
+  }
+
+  /**
+   * Move things along: finish the read under way, and start the next one if
+   * it's due.  Returns true if a channel has a new sample.  A failed read
+   * leaves the channel's last sample where it is - see getLastStatus.
+   */
+  bool poll(void);
+
+  // Forget every sample, and reset the filters and windows.  The next round
+  // starts now.
+  void reset(void);
+
+  // True once a channel has a sample.
+  bool hasSample(const uint8_t channel) const {
+    return (sampled_ & MINGHE_TELEMETRY_BIT(channel)) != 0;
+  }
+  // A channel's last sample as read, and filtered (the same, with no filter),
+  // and the millis() it came in at.
+  uint32_t getRaw(const uint8_t channel) const;
+  uint32_t getValue(const uint8_t channel) const;
+  uint32_t getSampleMs(const uint8_t channel) const;
+
+  // The last failed read's status, and how many have failed.
+  uint8_t getLastStatus(void) const { return last_status_; }
+  uint16_t getFailedReads(void) const { return failed_reads_; }
+
+  // The command letter a channel reads.
+  static char getCommand(const uint8_t channel);
+
+private:
+  struct Channel {
+    uint32_t raw;
+    uint32_t value;
+    uint32_t sample_ms;
+    MingHeFilter *filter;
+    MingHeWindowStats *stats;
+  };
+
+  // Take the reading that just finished.  True if it was good.
+  bool takeSample(void);
+  // Start the next read in the round, if it's time.
+  void startRead(void);
+  // Fire whatever events a new value on a channel makes.
+  void checkEvents(const uint8_t channel, const bool first,
+          const uint32_t before, const uint32_t value);
+  void checkSetpoint(const uint8_t type, const uint8_t setpoint_c,
+          const bool first, const uint32_t value);
+  void fire(const uint8_t type, const uint8_t from, const uint8_t to,
+          const uint32_t value);
+
+  MingHeBuckConverter *converter_;
+  Channel channels_[MINGHE_TELEMETRY_CHANNELS];
+  uint8_t enabled_;
+  uint8_t sampled_;
+  uint16_t interval_ms_;
+
+  // The channel being read, or next to be, this round, and when the round
+  // started.  Past the last channel, the round is over.
+  uint8_t channel_;
+  uint32_t round_start_ms_;
+  bool in_flight_;
+
+  uint8_t last_status_;
+  uint16_t failed_reads_;
+
+  MingHeTelemetryCallback callbacks_[MINGHE_EVENT_COUNT];
+  // Fan start and shutdown.
+  uint8_t setpoints_c_[2];
+  uint8_t hysteresis_c_;
+  // MINGHE_EVENT_ bits of the temperature setpoints at or over.
+  uint8_t over_;
+};
+
+#endif // __MING_HE_TELEMETRY_H__
@@ -0,0 +1,175 @@
+/*
+ * Rolling window statistics.  See MingHeWindowStats.h.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#include "MingHeWindowStats.h"
+
+// Square roots come out in 1/16ths from squares in 1/256ths.
+#define SQUARE_FRACTION (MINGHE_WINDOW_FRACTION * MINGHE_WINDOW_FRACTION)
+
+MingHeWindowStats::MingHeWindowStats(const uint32_t window_ms) {
+  next_ = NULL;
+  setWindow(window_ms);
+}
+
+void MingHeWindowStats::setWindow(const uint32_t window_ms) {
+  bucket_ms_ = window_ms / MINGHE_WINDOW_BUCKETS;
+  if (!bucket_ms_) {
+    bucket_ms_ = 1;
+  }
+  reset();
+}
+
+void MingHeWindowStats::reset(void) {
+  for (uint8_t i = 0; i < MINGHE_WINDOW_BUCKETS; i++) {
+    buckets_[i].count = 0;
+  }
+  current_ = 0;
+  bucket_start_ms_ = millis();
+}
+
+void MingHeWindowStats::advance(void) {
+  uint32_t now_ms = millis();
+
+  // Gone quiet for a whole window - start again.
+  if ((now_ms - bucket_start_ms_) >= bucket_ms_ * MINGHE_WINDOW_BUCKETS) {
+    reset();
+    return;
+  }
+  while ((now_ms - bucket_start_ms_) >= bucket_ms_) {
+    bucket_start_ms_ += bucket_ms_;
+    if (++current_ == MINGHE_WINDOW_BUCKETS) {
+      current_ = 0;
+    }
+    buckets_[current_].count = 0;
+  }
+}
+
+void MingHeWindowStats::add(const uint32_t value) {
+  Bucket *bucket;
+  int32_t offset;
+
+  advance();
+  bucket = &buckets_[current_];
+  if (!bucket->count) {
+    bucket->first = bucket->min = bucket->max = value;
+    bucket->sum = 0;
+    bucket->squares = 0;
+  } else if (bucket->count == 0xFFFF) {
+    // Full.  Not likely at the rates a converter can be read at.
+    return;
+  }
+
+  offset = (int32_t)(value - bucket->first);
+  bucket->count++;
+  bucket->sum += offset;
+  bucket->squares += (uint64_t)((int64_t)offset * offset);
+  if (value < bucket->min) {
+    bucket->min = value;
+  }
+  if (value > bucket->max) {
+    bucket->max = value;
+  }
+}
+
+// Largest whole number whose square is no more than value.
+static uint32_t squareRoot(uint64_t value) {
+  uint64_t root = 0, bit = 1ULL << 62;
+
+  while (bit > value) {
+    bit >>= 2;
+  }
+  while (bit) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)root;
+}
+
+// a * b, or as near as 64 bits gets.
+static uint64_t saturatingMultiply(const uint64_t a, const uint64_t b) {
+  if (a && (b > UINT64_MAX / a)) {
+    return UINT64_MAX;
+  }
+  return a * b;
+}
+
+static uint64_t saturatingAdd(const uint64_t a, const uint64_t b) {
+  return (a > UINT64_MAX - b) ? UINT64_MAX : a + b;
+}
+
+/*
+ * Each bucket's spread about its own mean, then the spread of the bucket
+ * means about the overall mean, added up - so nothing is squared at full size
+ * unless the readings really are that far apart.
+ */
+bool MingHeWindowStats::getSummary(MingHeWindowSummary *summary) {
+  int64_t means[MINGHE_WINDOW_BUCKETS];
+  int64_t total = 0, mean, quotient, remainder;
+  uint64_t spread = 0, within;
+  uint32_t count = 0, oldest_ms = 0;
+  uint8_t i, age;
+
+  advance();
+  for (age = 0; age < MINGHE_WINDOW_BUCKETS; age++) {
+    i = (current_ + MINGHE_WINDOW_BUCKETS - age) % MINGHE_WINDOW_BUCKETS;
+    const Bucket &bucket = buckets_[i];
+    if (!bucket.count) {
+      continue;
+    }
+    if (!count || (bucket.min < summary->min)) {
+      summary->min = bucket.min;
+    }
+    if (!count || (bucket.max > summary->max)) {
+      summary->max = bucket.max;
+    }
+    count += bucket.count;
+    oldest_ms = bucket_start_ms_ - age * bucket_ms_;
+
+    means[i] = (int64_t)bucket.first * MINGHE_WINDOW_FRACTION +
+            bucket.sum * MINGHE_WINDOW_FRACTION / bucket.count;
+    total += (int64_t)bucket.first * MINGHE_WINDOW_FRACTION * bucket.count +
+            bucket.sum * MINGHE_WINDOW_FRACTION;
+
+    // squares - sum^2 / count, without squaring the sum:
+    // sum^2 / count = quotient * sum + quotient * remainder + remainder^2 /
+    // count, for sum = quotient * count + remainder.
+    quotient = bucket.sum / bucket.count;
+    remainder = bucket.sum % bucket.count;
+    within = bucket.squares - quotient * bucket.sum - quotient * remainder;
+    within = saturatingMultiply(within, SQUARE_FRACTION) -
+            (uint64_t)(remainder * remainder * SQUARE_FRACTION) / bucket.count;
+    spread = saturatingAdd(spread, within);
+  }
+  if (!count) {
+    return false;
+  }
+
+  mean = total / count;
+  for (i = 0; i < MINGHE_WINDOW_BUCKETS; i++) {
+    if (buckets_[i].count) {
+      uint64_t apart = (means[i] > mean) ? means[i] - mean : mean - means[i];
+      spread = saturatingAdd(spread, saturatingMultiply(
+              saturatingMultiply(apart, apart), buckets_[i].count));
+    }
+  }
+
+  summary->count = count;
+  summary->span_ms = millis() - oldest_ms;
+  summary->mean = (mean < 0) ? 0 : (uint32_t)mean;
+  summary->stddev = squareRoot(spread / count);
+  return true;
+}
@@ -0,0 +1,94 @@
+/*
+ * Rolling statistics over a time window - the minimum, maximum, mean and
+ * standard deviation of a reading over the last minute, say - without keeping
+ * the readings.
+ *
+ * The window is split into MINGHE_WINDOW_BUCKETS buckets, each holding the
+ * count, sum, sum of squares, minimum and maximum of the samples that came in
+ * while it was current, so the memory doesn't depend on the window length or
+ * the sample rate: about 130 bytes a window.  The window moves a bucket at a
+ * time, so a summary covers between three quarters of the window and all of
+ * it - the summary says how much.
+ *
+ * Sums are kept from the first sample in each bucket, so a steady reading far
+ * from zero doesn't swamp the spread.  Means and standard deviations come out
+ * in 1/16ths of a count.  Working out a summary takes 64 bit divides, which
+ * are slow on an AVR - a millisecond or two - so pull summaries when they're
+ * wanted rather than after every sample.
+ *
+ * Feed a window samples with add, or hang it on a MingHeTelemetry channel
+ * (addStats) and it's fed every reading.  For exact sliding windows of any
+ * length, log the readings and use extras/window_stats.py on the host.
+ *
+ * Written by Russell Graves (https://syonyk.blogspot.com), with no warrantee,
+ * of any sort.
+ *
+ * This is released as full open source, no license.  Do what you want with it.
+ *
+ * However, if you find it useful, tossing a few bucks in the tip jar on my blog
+ * would be appreciated.
+ */
+
+#ifndef __MING_HE_WINDOW_STATS_H__
+#define __MING_HE_WINDOW_STATS_H__
+
+#include <Arduino.h>
+
+#define MINGHE_WINDOW_BUCKETS 4
+// Means and standard deviations are in 1/16ths of a count.
+#define MINGHE_WINDOW_FRACTION 16
+
+struct MingHeWindowSummary {
+  // Samples in the window, and how far back they go, in ms.
+  uint32_t count;
+  uint32_t span_ms;
+  uint32_t min;
+  uint32_t max;
+  // In 1/16ths.
+  uint32_t mean;
+  uint32_t stddev;
+};
+
+class MingHeWindowStats {
+public:
+  MingHeWindowStats(const uint32_t window_ms);
+
+  // Change the window length.  Clears the window.
+  void setWindow(const uint32_t window_ms);
+  uint32_t getWindow(void) const {
+    return bucket_ms_ * MINGHE_WINDOW_BUCKETS;
+  }
+
+  void add(const uint32_t value);
+  void reset(void);
+
+  // Summarize the window up to now.  False, with nothing filled in, if there
+  // are no samples in it.
+  bool getSummary(MingHeWindowSummary *summary);
+
+  // For MingHeTelemetry, which keeps a list of windows per channel.
+  MingHeWindowStats *getNext(void) const { return next_; }
+  void setNext(MingHeWindowStats *next) { next_ = next; }
+
+private:
+  struct Bucket {
+    uint16_t count;
+    uint32_t first;
+    // Of each sample less first.
+    int64_t sum;
+    uint64_t squares;
+    uint32_t min;
+    uint32_t max;
+  };
+
+  // Move the current bucket on to now, emptying the ones passed over.
+  void advance(void);
+
+  Bucket buckets_[MINGHE_WINDOW_BUCKETS];
+  uint8_t current_;
+  uint32_t bucket_ms_;
+  uint32_t bucket_start_ms_;
+  MingHeWindowStats *next_;
+};
+
+#endif // __MING_HE_WINDOW_STATS_H__